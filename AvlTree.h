@@ -2,39 +2,157 @@
 #define AVL_TREE_H
 
 #include "dsexceptions.h"
+#include "NodePool.h"
+#include "BatchSearch.h"
+#include "FrozenTree.h"
+#include "SortAndMerge.h"
+#include "TreeStats.h"
 #include <algorithm>
 #include <iostream> 
+#include <iterator>
+#include <limits>
+#include <thread>
+#include <utility>
+#include <vector>
 using namespace std;
 
 // AvlTree class
 //
-// CONSTRUCTION: zero parameter
+// CONSTRUCTION: zero parameter, or a range of items to bulk-load;
+//               Stats is a TreeStats policy, NoStats by default
 //
 // ******************PUBLIC OPERATIONS*********************
 // void insert( x )       --> Insert x
-// void remove( x )       --> Remove x (unimplemented)
+// void bulkLoad( items ) --> Insert a batch of items in linear time
+// void remove( x )       --> Remove x
 // bool contains( x )     --> Return true if x is present
 // Comparable findMin( )  --> Return smallest item
 // Comparable findMax( )  --> Return largest item
 // boolean isEmpty( )     --> Return true if empty; else false
 // void makeEmpty( )      --> Remove all items
 // void printTree( )      --> Print tree in sorted order
+// FrozenTree freeze( )   --> Return a read-only array-backed copy
+// void forEach( visit )  --> Call visit on each item in sorted order
+// size_t rank( x )       --> Return the number of items less than x
+// Comparable select( k ) --> Return the item of rank k
+// size_t count_range( lo, hi ) --> Return the number of items in ( lo, hi )
+// void find_batch( queries, found ) --> Look up sorted queries in one pass
+// const_iterator begin( ), end( )             --> Sorted bidirectional iteration
+// const_iterator lower_bound( x ), upper_bound( x )
+// void range( lo, hi )   --> Print items strictly between lo and hi
+// size_t for_each_in_range( lo, hi, visit, limit ) --> Visit items in ( lo, hi )
+// pair find_count( x )   --> find, plus number of links followed
+// bool remove_count( x ) --> remove; get_remove_calls( ) returns its links
+// Stats & stats( )       --> Return the statistics policy
+// void join( greater )   --> Append a tree of larger items, emptying it
+// void split( x, greater ) --> Move the items larger than x into greater
+// void unionWith( rhs, threads )        --> Add rhs's items, merging equal ones
+// void intersectionWith( rhs, threads ) --> Keep items also in rhs, merged
+// void differenceWith( rhs, threads )   --> Remove rhs's items
 // ******************ERRORS********************************
 // Throws UnderflowException as warranted
+// Throws ArrayIndexOutOfBoundsException if select( k ) has no item of rank k
+// Throws IllegalArgumentException if join( greater ) has an item out of order
+//
+// Each node stores the size of its subtree, so size, rank, select
+// and count_range cost O( 1 ) or O( log N ) rather than a full walk.
+// Each node also links to its parent, so iterators step to the next
+// item in amortized O( 1 ) without a stack or any allocation.
+//
+// The set operations are built on join and split of subtrees, after
+// Blelloch, Ferizovic and Sun, "Just Join for Parallel Ordered Sets".
+// Combining trees of m and n items, m <= n, takes O( m log( n / m + 1 ) )
+// work besides destroying the items that drop out, and the two halves
+// of each step run on separate threads until threads are used up. rhs
+// is taken by value: pass std::move( tree ) to hand its nodes over, or
+// a tree to copy it first. The set operations are not counted in stats.
 
-template <typename Comparable>
+template <typename Comparable, typename Stats = NoStats>
 class AvlTree
 {
+  private:
+    struct AvlNode;
+
   public:
+    class const_iterator
+    {
+      public:
+        typedef bidirectional_iterator_tag iterator_category;
+        typedef Comparable value_type;
+        typedef ptrdiff_t difference_type;
+        typedef const Comparable * pointer;
+        typedef const Comparable & reference;
+
+        const_iterator( ) : tree_{ nullptr }, current_{ nullptr }
+          { }
+
+        const Comparable & operator* ( ) const
+          { return current_->element_; }
+
+        const Comparable * operator-> ( ) const
+          { return &current_->element_; }
+
+        const_iterator & operator++ ( )
+        {
+            current_ = successor( current_ );
+            return *this;
+        }
+
+        const_iterator operator++ ( int )
+        {
+            const_iterator old = *this;
+            ++( *this );
+            return old;
+        }
+
+        /**
+         * Step back; end( ) steps back to the largest item.
+         */
+        const_iterator & operator-- ( )
+        {
+            current_ = current_ == nullptr ? tree_->findMax( tree_->root_ )
+                                           : predecessor( current_ );
+            return *this;
+        }
+
+        const_iterator operator-- ( int )
+        {
+            const_iterator old = *this;
+            --( *this );
+            return old;
+        }
+
+        bool operator== ( const const_iterator & rhs ) const
+          { return current_ == rhs.current_; }
+
+        bool operator!= ( const const_iterator & rhs ) const
+          { return !( *this == rhs ); }
+
+      private:
+        const AvlTree *tree_;
+        AvlNode *current_;
+
+        const_iterator( const AvlTree & tree, AvlNode *p ) : tree_{ &tree }, current_{ p }
+          { }
+
+        friend class AvlTree;
+    };
+
     AvlTree( ) : root_{ nullptr }
       { }
     
+    template <typename Iterator>
+    AvlTree( Iterator first, Iterator last ) : root_{ nullptr }
+    {
+        bulkLoad( first, last );
+    }
+
     AvlTree( const AvlTree & rhs ) : root_{ nullptr }
     {
         root_ = clone( rhs.root_ );
     }
 
-    AvlTree( AvlTree && rhs ) : root_{ rhs.root_ }
+    AvlTree( AvlTree && rhs ) : root_{ rhs.root_ }, pool_{ std::move( rhs.pool_ ) }
     {
         rhs.root_ = nullptr;
     }
@@ -60,6 +178,7 @@ class AvlTree
     AvlTree & operator=( AvlTree && rhs )
     {
         std::swap( root_, rhs.root_ );
+        std::swap( pool_, rhs.pool_ );
         
         return *this;
     }
@@ -91,7 +210,7 @@ class AvlTree
      */
     bool contains( const Comparable & x ) const
     {
-        return contains( x, root_ );
+        return find( x ) != nullptr;
     }
 
     /**
@@ -120,31 +239,156 @@ class AvlTree
      */
     void makeEmpty( )
     {
-        makeEmpty( root_ );
+        if( !is_trivially_destructible<AvlNode>::value )
+            makeEmpty( root_ );
+        root_ = nullptr;
+        pool_.release( );
     }
 
     /**
-     * Insert x into the tree; duplicates are ignored.
+     * Insert x into the tree, copying or moving it as passed;
+     * duplicates are merged into the item already present.
      */
-    void insert( const Comparable & x )
+    template <typename Item>
+    void insert( Item && x )
     {
-        insert( x, root_ );
+        typename Stats::Probe probe( stats_, Stats::INSERT );
+        insert( std::forward<Item>( x ), root_, probe );
     }
      
     /**
-     * Insert x into the tree; duplicates are ignored.
+     * Add a batch of items. The batch and the current contents are
+     * sorted and merged, and the tree is rebuilt perfectly balanced
+     * in linear time.
      */
-    void insert( Comparable && x )
+    void bulkLoad( vector<Comparable> items )
     {
-        insert( std::move( x ), root_ );
+        if( !isEmpty( ) )
+        {
+            vector<Comparable> current;
+            current.reserve( size( ) + items.size( ) );
+            inOrder( root_, [&current]( const Comparable & x ) { current.push_back( x ); } );
+            current.insert( current.end( ), make_move_iterator( items.begin( ) ),
+                            make_move_iterator( items.end( ) ) );
+            items.swap( current );
+            makeEmpty( );
+        }
+        sortAndMerge( items );
+        root_ = buildBalanced( items, 0, items.size( ) );
     }
-     
+
+    /**
+     * Add the items in [ first, last ) as one batch.
+     */
+    template <typename Iterator>
+    void bulkLoad( Iterator first, Iterator last )
+    {
+        bulkLoad( vector<Comparable>( first, last ) );
+    }
+
     /**
      * Remove x from the tree. Nothing is done if x is not found.
      */
     void remove( const Comparable & x )
     {
-        remove( x, root_ );
+        typename Stats::Probe probe( stats_, Stats::REMOVE );
+        remove( x, root_, probe );
+    }
+
+    /**
+     * Return the statistics policy, to read or reset its counts.
+     */
+    const Stats & stats( ) const
+    {
+        return stats_;
+    }
+
+    Stats & stats( )
+    {
+        return stats_;
+    }
+
+    /**
+     * Append greater, every item of which must be larger than every
+     * item here, and leave greater empty. O( log N ) besides taking
+     * over greater's pool.
+     * Throw IllegalArgumentException if the items are out of order.
+     */
+    void join( AvlTree && greater )
+    {
+        if( greater.isEmpty( ) )
+            return;
+        if( isEmpty( ) )
+        {
+            std::swap( root_, greater.root_ );
+            std::swap( pool_, greater.pool_ );
+            return;
+        }
+        if( !( findMax( root_ )->element_ < findMin( greater.root_ )->element_ ) )
+            throw IllegalArgumentException{ };
+        pool_.adopt( greater.pool_ );
+        AvlNode *last;
+        AvlNode *rest = splitLast( root_, last );
+        root_ = join( rest, last, greater.root_ );
+        root_->parent_ = nullptr;
+        greater.root_ = nullptr;
+    }
+
+    /**
+     * Move the items larger than x into greater, replacing what it
+     * held. The split takes O( log N ), but the smaller side is copied
+     * into a pool of its own, since each tree owns its nodes.
+     */
+    void split( const Comparable & x, AvlTree & greater )
+    {
+        greater.makeEmpty( );
+        AvlNode *less, *more;
+        AvlNode *match = split( root_, x, less, more );
+        if( match != nullptr )
+            less = join( less, match, nullptr );
+        root_ = nullptr;
+        if( sizeOfNode( more ) <= sizeOfNode( less ) )
+        {
+            greater.root_ = greater.clone( more );
+            deallocateSubtree( more );
+            root_ = less;
+        }
+        else
+        {
+            std::swap( pool_, greater.pool_ );
+            greater.root_ = more;
+            root_ = clone( less );
+            greater.deallocateSubtree( less );
+        }
+        if( root_ != nullptr )
+            root_->parent_ = nullptr;
+        if( greater.root_ != nullptr )
+            greater.root_->parent_ = nullptr;
+    }
+
+    /**
+     * Add the items of rhs; an item in both trees is merged with
+     * rhs's copy.
+     */
+    void unionWith( AvlTree rhs, size_t threads = 1 )
+    {
+        combineWith( rhs, UNION, threads );
+    }
+
+    /**
+     * Keep only the items also in rhs, each merged with rhs's copy.
+     */
+    void intersectionWith( AvlTree rhs, size_t threads = 1 )
+    {
+        combineWith( rhs, INTERSECTION, threads );
+    }
+
+    /**
+     * Remove the items that are in rhs.
+     */
+    void differenceWith( AvlTree rhs, size_t threads = 1 )
+    {
+        combineWith( rhs, DIFFERENCE, threads );
     }
 
     int heightOfTree() const {
@@ -154,36 +398,128 @@ class AvlTree
     // ===== USER DEFINED FUNCTIONS =====
 
     Comparable* find(const Comparable &x) {
-        int calls = 0;
-        return find(x, root_, calls);
+        typename Stats::Probe probe(stats_, Stats::FIND);
+        return find(x, root_, probe);
     }
 
     pair<Comparable*, int> find_count(const Comparable &x) {
-        int calls = 0;
-        return pair<Comparable*, int>(find(x, root_, calls), calls);
+        typename Stats::LinkProbe probe(stats_, Stats::FIND);
+        Comparable *found = find(x, root_, probe);
+        return pair<Comparable*, int>(found, probe.links());
+    }
+
+    // Read-only lookups; any number of threads may run them at once
+    // as long as no thread modifies the tree. Their probes open on the
+    // const policy, so they count but leave the policy alone
+    const Comparable* find(const Comparable &x) const {
+        typename Stats::Probe probe(stats_, Stats::FIND);
+        return find(x, root_, probe);
+    }
+
+    pair<const Comparable*, int> find_count(const Comparable &x) const {
+        typename Stats::LinkProbe probe(stats_, Stats::FIND);
+        const Comparable *found = find(x, root_, probe);
+        return pair<const Comparable*, int>(found, probe.links());
+    }
+
+    // Look up queries sorted in increasing order in one traversal
+    void find_batch(const vector<Comparable> &queries, vector<const Comparable *> &found) const {
+        findBatch(root_, queries, found);
     }
 
     bool remove_count(const Comparable &x) {
-        remove_calls = 0;
-        return remove_count(x, root_);
+        typename Stats::LinkProbe probe(stats_, Stats::REMOVE);
+        return remove(x, root_, probe);
+    }
+
+    size_t size() const {
+        return sizeOfNode(root_);
+    }
+
+    size_t depth() const {
+        return depthSumOfNode(root_);
+    }
+
+    size_t rank(const Comparable &x) const {
+        return count_below(x, false);
+    }
+
+    const Comparable &select(size_t k) const {
+        if (k >= size()) throw ArrayIndexOutOfBoundsException{};
+        AvlNode *t = root_;
+        while (true) {
+            size_t left = sizeOfNode(t->left_);
+            if (k < left) {
+                t = t->left_;
+            } else if (k == left) {
+                return t->element_;
+            } else {
+                k -= left + 1;
+                t = t->right_;
+            }
+        }
+    }
+
+    // Number of items strictly between lo and hi, matching range()
+    size_t count_range(const Comparable &lo, const Comparable &hi) const {
+        if (!(lo < hi)) return 0;
+        return count_below(hi, false) - count_below(lo, true);
+    }
+
+    int get_remove_calls() const {
+        return stats_.lastLinks(Stats::REMOVE);
+    }
+
+    const_iterator begin() const {
+        return const_iterator(*this, findMin(root_));
     }
 
-    size_t size() {
-        if (isEmpty()) return 0;
-        return size(root_) + 1;
+    const_iterator end() const {
+        return const_iterator(*this, nullptr);
     }
 
-    int depth() {
-        if (isEmpty()) return 0;
-        return depth(root_, 1);
+    // First item not less than x
+    const_iterator lower_bound(const Comparable &x) const {
+        return const_iterator(*this, bound(x, false));
     }
 
-    int get_remove_calls() {
-        return remove_calls;
+    // First item greater than x
+    const_iterator upper_bound(const Comparable &x) const {
+        return const_iterator(*this, bound(x, true));
     }
 
-    void range(Comparable left, Comparable right) {
-        range(root_, left, right);
+    void range(const Comparable &left, const Comparable &right, ostream &out = cout) const {
+        for_each_in_range(left, right, [&out](const Comparable &x) {
+            out << x << '\n';
+            return true;
+        });
+    }
+
+    // Visit the items strictly between left and right in order, stopping
+    // after limit items or once visit returns false. Return the number
+    // visited. To page through a range, pass the last item visited as
+    // the next left bound.
+    template <typename Visitor>
+    size_t for_each_in_range(const Comparable &left, const Comparable &right, Visitor visit,
+                             size_t limit = numeric_limits<size_t>::max()) const {
+        size_t visited = 0;
+        if (!(left < right)) return visited;
+        for (const_iterator it = upper_bound(left); it != end() && visited < limit && *it < right; ++it) {
+            visited++;
+            if (!visit(*it)) break;
+        }
+        return visited;
+    }
+
+    template <typename Visitor>
+    void forEach(Visitor visit) const {
+        inOrder(root_, visit);
+    }
+
+    FrozenTree<Comparable> freeze() const {
+        vector<Comparable> sorted;
+        collect(root_, sorted);
+        return FrozenTree<Comparable>(sorted);
     }
 
     // ===== USER DEFINED FUNCTIONS END =====
@@ -193,183 +529,482 @@ class AvlTree
         Comparable element_;
         AvlNode   *left_;
         AvlNode   *right_;
+        AvlNode   *parent_;
         int       height_;
+        size_t    size_;        // Items in this subtree
+        size_t    depthSum_;    // depth( ) of this subtree
 
         AvlNode( const Comparable & ele, AvlNode *lt, AvlNode *rt, int h = 0 )
-          : element_{ ele }, left_{ lt }, right_{ rt }, height_{ h } { }
+          : element_{ ele }, left_{ lt }, right_{ rt }, parent_{ nullptr }, height_{ h },
+            size_{ 1 }, depthSum_{ 2 } { }
         
         AvlNode( Comparable && ele, AvlNode *lt, AvlNode *rt, int h = 0 )
-          : element_{ std::move( ele ) }, left_{ lt }, right_{ rt }, height_{ h } { }
+          : element_{ std::move( ele ) }, left_{ lt }, right_{ rt }, parent_{ nullptr },
+            height_{ h }, size_{ 1 }, depthSum_{ 2 } { }
     };
 
     AvlNode *root_;
+    NodePool<AvlNode> pool_;
 
-    // USER VARS
-    int remove_calls;
+    Stats stats_;
 
     // ===== USER DEFINED FUNCTIONS =====
 
-    Comparable* find(const Comparable &x, AvlNode *t, int &calls) {
-        if (t == nullptr) {
-            return nullptr;
-        } else if (x < t->element_) {
-            calls++;
-            return find(x, t->left_, calls);
-        } else if (t->element_ < x) {
-            calls++;
-            return find(x, t->right_, calls);
-        } else {
-            return &(t->element_);
+    template <typename Probe>
+    Comparable* find(const Comparable &x, AvlNode *t, Probe &probe) const {
+        while (t != nullptr) {
+            if (probe.less(x, t->element_)) {
+                t = t->left_;
+            } else if (probe.less(t->element_, x)) {
+                t = t->right_;
+            } else {
+                return &(t->element_);
+            }
+            probe.follow();
+        }
+        return nullptr;
+    }
+
+    // Number of items less than x, or not greater than x if inclusive
+    size_t count_below(const Comparable &x, bool inclusive) const {
+        size_t below = 0;
+        AvlNode *t = root_;
+        while (t != nullptr) {
+            if (t->element_ < x || (inclusive && !(x < t->element_))) {
+                below += sizeOfNode(t->left_) + 1;
+                t = t->right_;
+            } else {
+                t = t->left_;
+            }
         }
+        return below;
     }
 
-    bool remove_count( const Comparable & x, AvlNode * & t )
+    // First node not less than x, or greater than x if strict
+    AvlNode *bound(const Comparable &x, bool strict) const {
+        AvlNode *t = root_;
+        AvlNode *found = nullptr;
+        while (t != nullptr) {
+            if (x < t->element_ || (!strict && !(t->element_ < x))) {
+                found = t;
+                t = t->left_;
+            } else {
+                t = t->right_;
+            }
+        }
+        return found;
+    }
+
+    void collect(AvlNode *t, vector<Comparable> &sorted) const {
+        inOrder(t, [&sorted](const Comparable &x) { sorted.push_back(x); });
+    }
+
+    // ===== USER DEFINED FUNCTIONS END =====
+
+    // An AVL tree of height h holds at least Fib(h + 3) - 1 nodes,
+    // so no tree that fits in memory is this tall
+    static const int MAX_HEIGHT = 128;
+
+    /**
+     * Internal method to insert into a subtree.
+     * x is the item to insert, copied or moved as passed.
+     * t is the node that roots the subtree.
+     * Set the new root of the subtree.
+     */
+    template <typename Item>
+    void insert( Item && x, AvlNode * & t, typename Stats::Probe & probe )
     {
-        if( t == nullptr )
+        AvlNode **path[ MAX_HEIGHT ];
+        int height = 0;
+        AvlNode **link = &t;
+        while( *link != nullptr )
+        {
+            path[ height++ ] = link;
+            if( probe.less( x, ( *link )->element_ ) )
+                link = &( *link )->left_;
+            else if( probe.less( ( *link )->element_, x ) )
+                link = &( *link )->right_;
+            else
+            {
+                ( *link )->element_.merge( x );
+                return;
+            }
+            probe.follow( );
+        }
+        *link = pool_.allocate( std::forward<Item>( x ), nullptr, nullptr );
+        probe.allocate( );
+        ( *link )->parent_ = height > 0 ? *path[ height - 1 ] : nullptr;
+        rebalancePath( path, height, probe );
+    }
+
+    /**
+     * Internal method to remove from a subtree.
+     * x is the item to remove.
+     * t is the node that roots the subtree.
+     * probe counts the links followed, including those to the
+     * successor that replaces a node with two children.
+     * Set the new root of the subtree; return true if x was removed.
+     */
+    template <typename Probe>
+    bool remove( const Comparable & x, AvlNode * & t, Probe & probe )
+    {
+        AvlNode **path[ MAX_HEIGHT ];
+        int height = 0;
+        AvlNode **link = &t;
+        while( *link != nullptr )
+        {
+            if( probe.less( x, ( *link )->element_ ) )
+            {
+                path[ height++ ] = link;
+                link = &( *link )->left_;
+            }
+            else if( probe.less( ( *link )->element_, x ) )
+            {
+                path[ height++ ] = link;
+                link = &( *link )->right_;
+            }
+            else
+                break;
+            probe.follow( );
+        }
+        if( *link == nullptr )
             return false;   // Item not found; do nothing
-        
-        if( x < t->element_ ) {
-            remove_calls++;
-            remove_count( x, t->left_ );
+
+        AvlNode *oldNode = *link;
+        if( oldNode->left_ != nullptr && oldNode->right_ != nullptr ) // Two children
+        {
+            // Move the successor's item up and unlink the successor instead
+            path[ height++ ] = link;
+            link = &oldNode->right_;
+            probe.follow( );
+            while( ( *link )->left_ != nullptr )
+            {
+                path[ height++ ] = link;
+                link = &( *link )->left_;
+                probe.follow( );
+            }
+            AvlNode *successor = *link;
+            oldNode->element_ = std::move( successor->element_ );
+            oldNode = successor;
         }
-        else if( t->element_ < x ) {
-            remove_calls++;
-            remove_count( x, t->right_ );
+        *link = ( oldNode->left_ != nullptr ) ? oldNode->left_ : oldNode->right_;
+        if( *link != nullptr )
+            ( *link )->parent_ = oldNode->parent_;
+        pool_.deallocate( oldNode );
+
+        rebalancePath( path, height, probe );
+        return true;
+    }
+
+    enum SetOperation { UNION, INTERSECTION, DIFFERENCE };
+
+    // Below this many items, the two halves of a set operation run on
+    // the same thread
+    static const size_t PARALLEL_GRAIN = 4096;
+
+    /**
+     * Combine rhs into this tree with op, taking over rhs's nodes.
+     */
+    void combineWith( AvlTree & rhs, SetOperation op, size_t threads )
+    {
+        int forks = 0;
+        while( forks < 16 && ( size_t( 1 ) << forks ) < threads )
+            ++forks;
+        pool_.adopt( rhs.pool_ );
+        vector<AvlNode *> dropped;
+        root_ = combine( root_, rhs.root_, op, forks, dropped );
+        rhs.root_ = nullptr;
+        if( root_ != nullptr )
+            root_->parent_ = nullptr;
+        for( size_t i = 0; i < dropped.size( ); ++i )
+            deallocateSubtree( dropped[ i ] );
+    }
+
+    /**
+     * Internal method to combine subtrees t1 and t2 with op, returning
+     * the root of the result. t1's items are kept, merged with t2's
+     * where op keeps both. Subtrees that drop out are added to dropped
+     * for the caller to free, since the pool is not thread-safe. While
+     * forks is positive the two halves run on separate threads.
+     */
+    AvlNode * combine( AvlNode *t1, AvlNode *t2, SetOperation op, int forks,
+                       vector<AvlNode *> & dropped )
+    {
+        if( t1 == nullptr || t2 == nullptr )
+        {
+            if( op == UNION )
+                return t1 != nullptr ? t1 : t2;
+            AvlNode *gone = op == INTERSECTION && t1 != nullptr ? t1 : t2;
+            if( gone != nullptr )
+                dropped.push_back( gone );
+            return op == DIFFERENCE ? t1 : nullptr;
         }
-        else if( t->left_ != nullptr && t->right_ != nullptr ) // Two children
+
+        bool parallel = forks > 0 && t1->size_ + t2->size_ >= PARALLEL_GRAIN;
+        NoStats quiet;
+        NoStats::Probe probe( quiet, NoStats::INSERT );
+        AvlNode *less, *more;
+        AvlNode *match = split( t2, t1->element_, less, more, probe );
+        AvlNode *left1 = t1->left_;
+        AvlNode *right1 = t1->right_;
+        AvlNode *left, *right;
+        if( parallel )
         {
-            t->element_ = findMin( t->right_ )->element_;
-            remove_calls++;
-            remove_count( t->element_, t->right_ );
+            vector<AvlNode *> leftDropped;
+            thread worker( [&]( ) { left = combine( left1, less, op, forks - 1, leftDropped ); } );
+            right = combine( right1, more, op, forks - 1, dropped );
+            worker.join( );
+            dropped.insert( dropped.end( ), leftDropped.begin( ), leftDropped.end( ) );
         }
         else
         {
-            AvlNode *oldNode = t;
-            t = ( t->left_ != nullptr ) ? t->left_ : t->right_;
-            delete oldNode;
+            left = combine( left1, less, op, 0, dropped );
+            right = combine( right1, more, op, 0, dropped );
         }
-        
-        balance( t );
-        return true;
+
+        if( match != nullptr )
+        {
+            if( op != DIFFERENCE )
+                t1->element_.merge( match->element_ );
+            dropped.push_back( match );
+        }
+        if( op == UNION || ( op == INTERSECTION ) == ( match != nullptr ) )
+            return join( left, t1, right, probe );
+        t1->left_ = t1->right_ = nullptr;
+        dropped.push_back( t1 );
+        return join2( left, right, probe );
     }
 
-    size_t size(AvlNode *t) {
-        if (t == nullptr) return 0;
-        size_t left = 0, right = 0;
-        if (t->left_ != nullptr)
-            left = size(t->left_) + 1;
-        if (t->right_ != nullptr)
-            right = size(t->right_) + 1;
-        return left + right;
+    AvlNode * join( AvlNode *l, AvlNode *k, AvlNode *r )
+    {
+        NoStats quiet;
+        NoStats::Probe probe( quiet, NoStats::INSERT );
+        return join( l, k, r, probe );
     }
 
-    int depth(AvlNode *t, int d) {
-        if (t == nullptr) return 0;
-        if (t->left_ == nullptr && t->right_ == nullptr) {
-            return d + 1;
+    /**
+     * Internal method to join subtrees l and r, every item of l less
+     * than k's and every item of r greater, under node k. The shorter
+     * subtree is hung at the matching height on the taller one's
+     * inner spine, and the spine rebalanced on the way back up.
+     * O( difference in heights ). Return the new root, whose parent
+     * link is left for the caller to set.
+     */
+    template <typename Probe>
+    AvlNode * join( AvlNode *l, AvlNode *k, AvlNode *r, Probe & probe )
+    {
+        if( heightOfNode( l ) > heightOfNode( r ) + ALLOWED_IMBALANCE )
+        {
+            AvlNode *spine = join( l->right_, k, r, probe );
+            l->right_ = spine;
+            spine->parent_ = l;
+            balance( l, probe );
+            return l;
         }
-        return d + depth(t->left_, d + 1) + depth(t->right_, d + 1);
+        if( heightOfNode( r ) > heightOfNode( l ) + ALLOWED_IMBALANCE )
+        {
+            AvlNode *spine = join( l, k, r->left_, probe );
+            r->left_ = spine;
+            spine->parent_ = r;
+            balance( r, probe );
+            return r;
+        }
+        k->left_ = l;
+        k->right_ = r;
+        if( l != nullptr )
+            l->parent_ = k;
+        if( r != nullptr )
+            r->parent_ = k;
+        k->height_ = max( heightOfNode( l ), heightOfNode( r ) ) + 1;
+        updateCounts( k );
+        return k;
     }
 
-    void range(AvlNode *t, Comparable left, Comparable right) {
-        if (t == nullptr) return;
-        if (left < t->element_) range(t->left_, left, right);
-        if (left < t->element_ && t->element_ < right) cout << t->element_ << endl;
-        if (t->element_ < right) range(t->right_, left, right);
+    /**
+     * Internal method to join subtrees l and r, every item of l less
+     * than every item of r, with no node between them.
+     */
+    template <typename Probe>
+    AvlNode * join2( AvlNode *l, AvlNode *r, Probe & probe )
+    {
+        if( l == nullptr )
+            return r;
+        AvlNode *last;
+        AvlNode *rest = splitLast( l, last, probe );
+        return join( rest, last, r, probe );
     }
 
-    // ===== USER DEFINED FUNCTIONS END =====
+    AvlNode * splitLast( AvlNode *t, AvlNode * & last )
+    {
+        NoStats quiet;
+        NoStats::Probe probe( quiet, NoStats::INSERT );
+        return splitLast( t, last, probe );
+    }
 
     /**
-     * Internal method to insert into a subtree.
-     * x is the item to insert.
-     * t is the node that roots the subtree.
-     * Set the new root of the subtree.
+     * Internal method to detach the largest node of nonempty subtree t
+     * into last; return the root of the rest.
      */
-    void insert( const Comparable & x, AvlNode * & t )
+    template <typename Probe>
+    AvlNode * splitLast( AvlNode *t, AvlNode * & last, Probe & probe )
     {
-        if( t == nullptr )
-            t = new AvlNode{ x, nullptr, nullptr };
-        else if( x < t->element_ )
-            insert( x, t->left_ );
-        else if( t->element_ < x )
-            insert( x, t->right_ );
-        else
-            t->element_.merge(x);
-        
-        balance( t );
+        if( t->right_ == nullptr )
+        {
+            last = t;
+            AvlNode *rest = t->left_;
+            t->left_ = nullptr;
+            return rest;
+        }
+        AvlNode *rest = splitLast( t->right_, last, probe );
+        return join( t->left_, t, rest, probe );
+    }
+
+    AvlNode * split( AvlNode *t, const Comparable & x, AvlNode * & less, AvlNode * & more )
+    {
+        NoStats quiet;
+        NoStats::Probe probe( quiet, NoStats::INSERT );
+        return split( t, x, less, more, probe );
     }
 
     /**
-     * Internal method to insert into a subtree.
-     * x is the item to insert.
-     * t is the node that roots the subtree.
-     * Set the new root of the subtree.
+     * Internal method to split subtree t around x: less receives the
+     * items less than x and more those greater. Return the node equal
+     * to x, detached, or nullptr. O( height ).
      */
-    void insert( Comparable && x, AvlNode * & t )
+    template <typename Probe>
+    AvlNode * split( AvlNode *t, const Comparable & x, AvlNode * & less, AvlNode * & more,
+                     Probe & probe )
     {
         if( t == nullptr )
-            t = new AvlNode{ std::move( x ), nullptr, nullptr };
-        else if( x < t->element_ )
-            insert( std::move( x ), t->left_ );
+        {
+            less = more = nullptr;
+            return nullptr;
+        }
+        AvlNode *left = t->left_;
+        AvlNode *right = t->right_;
+        AvlNode *match;
+        if( x < t->element_ )
+        {
+            AvlNode *between;
+            match = split( left, x, less, between, probe );
+            more = join( between, t, right, probe );
+        }
         else if( t->element_ < x )
-            insert( std::move( x ), t->right_ );
+        {
+            AvlNode *between;
+            match = split( right, x, between, more, probe );
+            less = join( left, t, between, probe );
+        }
         else
-            t->element_.merge(x);
-        
-        balance( t );
+        {
+            less = left;
+            more = right;
+            t->left_ = t->right_ = nullptr;
+            match = t;
+        }
+        return match;
     }
-     
+
     /**
-     * Internal method to remove from a subtree.
-     * x is the item to remove.
-     * t is the node that roots the subtree.
-     * Set the new root of the subtree.
+     * Internal method to destroy the nodes of subtree t and recycle
+     * their slots, flattening it as makeEmpty does.
      */
-    void remove( const Comparable & x, AvlNode * & t )
+    void deallocateSubtree( AvlNode *t )
     {
-        if( t == nullptr )
-            return;   // Item not found; do nothing
-        
-        if( x < t->element_ )
-            remove( x, t->left_ );
-        else if( t->element_ < x )
-            remove( x, t->right_ );
-        else if( t->left_ != nullptr && t->right_ != nullptr ) // Two children
+        while( t != nullptr )
         {
-            t->element_ = findMin( t->right_ )->element_;
-            remove( t->element_, t->right_ );
+            if( t->left_ != nullptr )
+            {
+                AvlNode *lt = t->left_;
+                t->left_ = lt->right_;
+                lt->right_ = t;
+                t = lt;
+            }
+            else
+            {
+                AvlNode *rt = t->right_;
+                pool_.deallocate( t );
+                t = rt;
+            }
         }
-        else
+    }
+
+    /**
+     * Internal method to build a perfectly balanced subtree from the
+     * sorted items[ lo, hi ), moving each item into its node.
+     * The recursion is only log2( hi - lo ) deep.
+     */
+    AvlNode * buildBalanced( vector<Comparable> & items, size_t lo, size_t hi )
+    {
+        if( lo == hi )
+            return nullptr;
+        size_t mid = lo + ( hi - lo ) / 2;
+        AvlNode *lt = buildBalanced( items, lo, mid );
+        AvlNode *rt = buildBalanced( items, mid + 1, hi );
+        AvlNode *t = pool_.allocate( std::move( items[ mid ] ), lt, rt,
+                                     max( heightOfNode( lt ), heightOfNode( rt ) ) + 1 );
+        if( lt != nullptr )
+            lt->parent_ = t;
+        if( rt != nullptr )
+            rt->parent_ = t;
+        updateCounts( t );
+        return t;
+    }
+
+    /**
+     * Rebalance the subtrees rooted at *path[ height - 1 ] up to
+     * *path[ 0 ], bottom-up. Once a subtree's height comes out
+     * unchanged no rotation can happen above it, so the remaining
+     * ancestors only have their counts refreshed. probe records the
+     * number of subtrees balanced.
+     */
+    template <typename Probe>
+    void rebalancePath( AvlNode ***path, int height, Probe & probe )
+    {
+        bool heightChanged = true;
+        int levels = 0;
+        while( height > 0 )
         {
-            AvlNode *oldNode = t;
-            t = ( t->left_ != nullptr ) ? t->left_ : t->right_;
-            delete oldNode;
+            AvlNode * & t = *path[ --height ];
+            if( !heightChanged )
+            {
+                updateCounts( t );
+                continue;
+            }
+            int oldHeight = t->height_;
+            balance( t, probe );
+            heightChanged = t->height_ != oldHeight;
+            ++levels;
         }
-        
-        balance( t );
+        probe.rebalance( levels );
     }
     
     static const int ALLOWED_IMBALANCE = 1;
 
     // Assume t is balanced or within one of being balanced
-    void balance( AvlNode * & t )
+    template <typename Probe>
+    void balance( AvlNode * & t, Probe & probe )
     {
         if( t == nullptr )
             return;
         
         if( heightOfNode( t->left_ ) - heightOfNode( t->right_ ) > ALLOWED_IMBALANCE ) {
-            if( heightOfNode( t->left_->left_ ) >= heightOfNode( t->left_->right_ ) )
+            bool single = heightOfNode( t->left_->left_ ) >= heightOfNode( t->left_->right_ );
+            if( single )
                 rotateWithLeftChild( t );
             else
                 doubleWithLeftChild( t );
+            probe.rotate( !single );
         } else if( heightOfNode( t->right_ ) - heightOfNode( t->left_ ) > ALLOWED_IMBALANCE ) {
-            if( heightOfNode( t->right_->right_ ) >= heightOfNode( t->right_->left_ ) )
+            bool single = heightOfNode( t->right_->right_ ) >= heightOfNode( t->right_->left_ );
+            if( single )
                 rotateWithRightChild( t );
             else
                 doubleWithRightChild( t );
+            probe.rotate( !single );
 	}
         t->height_ = max( heightOfNode( t->left_ ), heightOfNode( t->right_ ) ) + 1;
+        updateCounts( t );
     }
     
     /**
@@ -378,11 +1013,10 @@ class AvlTree
      */
     AvlNode * findMin( AvlNode *t ) const
     {
-        if( t == nullptr )
-            return nullptr;
-        if( t->left_ == nullptr )
-            return t;
-        return findMin( t->left_ );
+        if( t != nullptr )
+            while( t->left_ != nullptr )
+                t = t->left_;
+        return t;
     }
 
     /**
@@ -399,72 +1033,123 @@ class AvlTree
 
 
     /**
-     * Internal method to test if an item is in a subtree.
-     * x is item to search for.
-     * t is the node that roots the tree.
+     * Internal method to find the node after t in sorted order,
+     * or nullptr if t holds the largest item.
      */
-    bool contains( const Comparable & x, AvlNode *t ) const
+    static AvlNode * successor( AvlNode *t )
     {
-        if( t == nullptr )
-            return false;
-        else if( x < t->element_ )
-            return contains( x, t->left_ );
-        else if( t->element_ < x )
-            return contains( x, t->right_ );
-        else
-            return true;    // Match
+        if( t->right_ != nullptr )
+        {
+            t = t->right_;
+            while( t->left_ != nullptr )
+                t = t->left_;
+            return t;
+        }
+        while( t->parent_ != nullptr && t == t->parent_->right_ )
+            t = t->parent_;
+        return t->parent_;
     }
-/****** NONRECURSIVE VERSION*************************
-    bool contains( const Comparable & x, AvlNode *t ) const
+
+    /**
+     * Internal method to find the node before t in sorted order,
+     * or nullptr if t holds the smallest item.
+     */
+    static AvlNode * predecessor( AvlNode *t )
     {
-        while( t != nullptr )
-            if( x < t->element_ )
-                t = t->left_;
-            else if( t->element_ < x )
+        if( t->left_ != nullptr )
+        {
+            t = t->left_;
+            while( t->right_ != nullptr )
                 t = t->right_;
-            else
-                return true;    // Match
-
-        return false;   // No match
+            return t;
+        }
+        while( t->parent_ != nullptr && t == t->parent_->left_ )
+            t = t->parent_;
+        return t->parent_;
     }
-*****************************************************/
 
     /**
      * Internal method to make subtree empty.
+     * Rotating each left child up flattens the tree into a right
+     * spine that is then destroyed front to back, without a stack.
      */
     void makeEmpty( AvlNode * & t )
     {
-        if( t != nullptr )
+        while( t != nullptr )
         {
-            makeEmpty( t->left_ );
-            makeEmpty( t->right_ );
-            delete t;
+            if( t->left_ != nullptr )
+            {
+                AvlNode *lt = t->left_;
+                t->left_ = lt->right_;
+                lt->right_ = t;
+                t = lt;
+            }
+            else
+            {
+                AvlNode *rt = t->right_;
+                pool_.destroy( t );
+                t = rt;
+            }
         }
-        t = nullptr;
     }
 
     /**
-     * Internal method to print a subtree rooted at t in sorted order.
+     * Internal method to visit the items of subtree t in sorted order.
      */
-    void printTree( AvlNode *t ) const
+    template <typename Visitor>
+    void inOrder( AvlNode *t, Visitor visit ) const
     {
-        if( t != nullptr )
+        AvlNode *pending[ MAX_HEIGHT ];
+        int top = 0;
+        while( t != nullptr || top > 0 )
         {
-            printTree( t->left_ );
-            cout << t->element_ << " ";
-            printTree( t->right_ );
+            while( t != nullptr )
+            {
+                pending[ top++ ] = t;
+                t = t->left_;
+            }
+            t = pending[ --top ];
+            visit( t->element_ );
+            t = t->right_;
         }
     }
 
+    /**
+     * Internal method to print a subtree rooted at t in sorted order.
+     */
+    void printTree( AvlNode *t ) const
+    {
+        inOrder( t, []( const Comparable & x ) { cout << x << " "; } );
+    }
+
     /**
      * Internal method to clone subtree.
      */
-    AvlNode * clone( AvlNode *t ) const
+    AvlNode * clone( AvlNode *t )
     {
-        if( t == nullptr )
-            return nullptr;
-        else
-            return new AvlNode{ t->element_, clone( t->left_ ), clone( t->right_ ), t->height_ };
+        struct Step
+        {
+            AvlNode *from;
+            AvlNode **link;
+            AvlNode *parent;
+        };
+        AvlNode *copy = nullptr;
+        vector<Step> pending( 1, Step{ t, &copy, nullptr } );
+        while( !pending.empty( ) )
+        {
+            Step step = pending.back( );
+            pending.pop_back( );
+            if( step.from == nullptr )
+                continue;
+            AvlNode *n = pool_.allocate( step.from->element_, nullptr, nullptr, step.from->height_ );
+            n->parent_ = step.parent;
+            n->size_ = step.from->size_;
+            n->depthSum_ = step.from->depthSum_;
+            *step.link = n;
+            pending.push_back( Step{ step.from->left_, &n->left_, n } );
+            pending.push_back( Step{ step.from->right_, &n->right_, n } );
+        }
+        return copy;
     }
         // Avl manipulations
     /**
@@ -475,6 +1160,34 @@ class AvlTree
         return t == nullptr ? -1 : t->height_;
     }
 
+    /**
+     * Return the number of items in subtree t.
+     */
+    size_t sizeOfNode( AvlNode *t ) const
+    {
+        return t == nullptr ? 0 : t->size_;
+    }
+
+    /**
+     * Return depth( ) of subtree t: the sum of its node depths, with
+     * t at depth 1 and each leaf counted once more.
+     */
+    size_t depthSumOfNode( AvlNode *t ) const
+    {
+        return t == nullptr ? 0 : t->depthSum_;
+    }
+
+    /**
+     * Recompute the counts of t from those of its children.
+     * Every node below t is one level deeper in t than in its child.
+     */
+    void updateCounts( AvlNode *t )
+    {
+        t->size_ = sizeOfNode( t->left_ ) + sizeOfNode( t->right_ ) + 1;
+        t->depthSum_ = depthSumOfNode( t->left_ ) + depthSumOfNode( t->right_ ) + t->size_
+                       + ( t->size_ == 1 ? 1 : 0 );
+    }
+
     int max( int lhs, int rhs ) const
     {
         return lhs > rhs ? lhs : rhs;
@@ -483,30 +1196,42 @@ class AvlTree
     /**
      * Rotate binary tree node with left_ child.
      * For AVL trees, this is a single rotation for case 1.
-     * Update heights, then set new root.
+     * Update heights, counts and parents, then set new root.
      */
     void rotateWithLeftChild( AvlNode * & k2 )
     {
         AvlNode *k1 = k2->left_;
         k2->left_ = k1->right_;
+        if( k2->left_ != nullptr )
+            k2->left_->parent_ = k2;
         k1->right_ = k2;
+        k1->parent_ = k2->parent_;
+        k2->parent_ = k1;
         k2->height_ = max( heightOfNode( k2->left_ ), heightOfNode( k2->right_ ) ) + 1;
         k1->height_ = max( heightOfNode( k1->left_ ), k2->height_ ) + 1;
+        updateCounts( k2 );
+        updateCounts( k1 );
         k2 = k1;
     }
 
     /**
      * Rotate binary tree node with right_ child.
      * For AVL trees, this is a single rotation for case 4.
-     * Update heights, then set new root.
+     * Update heights, counts and parents, then set new root.
      */
     void rotateWithRightChild( AvlNode * & k1 )
     {
         AvlNode *k2 = k1->right_;
         k1->right_ = k2->left_;
+        if( k1->right_ != nullptr )
+            k1->right_->parent_ = k1;
         k2->left_ = k1;
+        k2->parent_ = k1->parent_;
+        k1->parent_ = k2;
         k1->height_ = max( heightOfNode( k1->left_ ), heightOfNode( k1->right_ ) ) + 1;
         k2->height_ = max( heightOfNode( k2->right_ ), k1->height_ ) + 1;
+        updateCounts( k1 );
+        updateCounts( k2 );
         k1 = k2;
     }
 
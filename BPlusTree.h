@@ -0,0 +1,1044 @@
+#ifndef B_PLUS_TREE_H
+#define B_PLUS_TREE_H
+
+#include "dsexceptions.h"
+#include "NodePool.h"
+#include "SortAndMerge.h"
+#include <algorithm>
+#include <cstddef>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+using namespace std;
+
+// BPlusTree class
+//
+// CONSTRUCTION: zero parameter, or a range of items to bulk-load
+//
+// Items live only in the leaves, which are chained in sorted order.
+// Internal nodes hold copies of separator items. Each node holds as
+// many items as fit in NODE_BYTES (a few cache lines), so a lookup
+// touches one node per level instead of one node per comparison.
+//
+// ******************PUBLIC OPERATIONS*********************
+// void insert( x )       --> Insert x; merge into an equal item
+// void bulkLoad( items ) --> Insert a batch of items in linear time
+// void remove( x )       --> Remove x
+// bool contains( x )     --> Return true if x is present
+// Comparable findMin( )  --> Return smallest item
+// Comparable findMax( )  --> Return largest item
+// boolean isEmpty( )     --> Return true if empty; else false
+// void makeEmpty( )      --> Remove all items
+// void printTree( )      --> Print tree in sorted order
+// Comparable * find( x ) --> Return matching item or nullptr
+// pair find_count( x )   --> find, plus number of nodes visited
+// void find_batch( queries, found ) --> Look up sorted queries in one pass
+// bool remove_count( x ) --> remove, counting nodes visited
+// void range( lo, hi )   --> Print items strictly between lo and hi
+// size_t for_each_in_range( lo, hi, visit, limit ) --> Visit items in ( lo, hi )
+// const_iterator begin( ), end( )             --> Sorted bidirectional iteration
+// const_iterator lower_bound( x ), upper_bound( x )
+// size_t size( )         --> Return number of items
+// size_t depth( )        --> Return summed depth of all items
+// ******************ERRORS********************************
+// Throws UnderflowException as warranted
+
+template <typename Comparable>
+class BPlusTree
+{
+  private:
+    struct LeafNode;
+
+  public:
+    // Position of one item: a leaf and a slot in it. end( ) has no leaf.
+    class const_iterator
+    {
+      public:
+        typedef bidirectional_iterator_tag iterator_category;
+        typedef Comparable value_type;
+        typedef ptrdiff_t difference_type;
+        typedef const Comparable * pointer;
+        typedef const Comparable & reference;
+
+        const_iterator( ) : tree_{ nullptr }, leaf_{ nullptr }, index_{ 0 }
+          { }
+
+        const Comparable & operator* ( ) const
+          { return item( leaf_, index_ ); }
+
+        const Comparable * operator-> ( ) const
+          { return &item( leaf_, index_ ); }
+
+        const_iterator & operator++ ( )
+        {
+            if( ++index_ == leaf_->count_ )
+            {
+                leaf_ = leaf_->next_;
+                index_ = 0;
+            }
+            return *this;
+        }
+
+        const_iterator operator++ ( int )
+        {
+            const_iterator old = *this;
+            ++( *this );
+            return old;
+        }
+
+        /**
+         * Step back; end( ) steps back to the largest item.
+         */
+        const_iterator & operator-- ( )
+        {
+            if( leaf_ == nullptr )
+                leaf_ = tree_->rightmostLeaf( );
+            else if( index_ == 0 )
+                leaf_ = leaf_->prev_;
+            else
+            {
+                --index_;
+                return *this;
+            }
+            index_ = leaf_->count_ - 1;
+            return *this;
+        }
+
+        const_iterator operator-- ( int )
+        {
+            const_iterator old = *this;
+            --( *this );
+            return old;
+        }
+
+        bool operator== ( const const_iterator & rhs ) const
+          { return leaf_ == rhs.leaf_ && index_ == rhs.index_; }
+
+        bool operator!= ( const const_iterator & rhs ) const
+          { return !( *this == rhs ); }
+
+      private:
+        const BPlusTree *tree_;
+        LeafNode *leaf_;
+        int index_;
+
+        const_iterator( const BPlusTree & tree, LeafNode *leaf, int index )
+          : tree_{ &tree }, leaf_{ leaf }, index_{ index }
+        {
+            if( leaf_ != nullptr && index_ == leaf_->count_ )
+            {
+                leaf_ = leaf_->next_;
+                index_ = 0;
+            }
+        }
+
+        friend class BPlusTree<Comparable>;
+    };
+
+    BPlusTree( ) : root_{ nullptr }, size_{ 0 }, remove_calls{ 0 }
+      { }
+
+    template <typename Iterator>
+    BPlusTree( Iterator first, Iterator last ) : root_{ nullptr }, size_{ 0 }, remove_calls{ 0 }
+    {
+        bulkLoad( first, last );
+    }
+
+    BPlusTree( const BPlusTree & rhs ) : root_{ nullptr }, size_{ 0 }, remove_calls{ 0 }
+    {
+        LeafNode *last = nullptr;
+        root_ = clone( rhs.root_, last );
+        size_ = rhs.size_;
+    }
+
+    BPlusTree( BPlusTree && rhs )
+      : root_{ rhs.root_ }, size_{ rhs.size_ }, remove_calls{ 0 },
+        leafPool_{ std::move( rhs.leafPool_ ) }, internalPool_{ std::move( rhs.internalPool_ ) }
+    {
+        rhs.root_ = nullptr;
+        rhs.size_ = 0;
+    }
+
+    ~BPlusTree( )
+    {
+        makeEmpty( );
+    }
+
+    /**
+     * Deep copy.
+     */
+    BPlusTree & operator=( const BPlusTree & rhs )
+    {
+        BPlusTree copy = rhs;
+        std::swap( *this, copy );
+        return *this;
+    }
+
+    /**
+     * Move.
+     */
+    BPlusTree & operator=( BPlusTree && rhs )
+    {
+        std::swap( root_, rhs.root_ );
+        std::swap( size_, rhs.size_ );
+        std::swap( leafPool_, rhs.leafPool_ );
+        std::swap( internalPool_, rhs.internalPool_ );
+        return *this;
+    }
+
+    /**
+     * Find the smallest item in the tree.
+     * Throw UnderflowException if empty.
+     */
+    const Comparable & findMin( ) const
+    {
+        if( isEmpty( ) )
+            throw UnderflowException{ };
+        return item( leftmostLeaf( ), 0 );
+    }
+
+    /**
+     * Find the largest item in the tree.
+     * Throw UnderflowException if empty.
+     */
+    const Comparable & findMax( ) const
+    {
+        if( isEmpty( ) )
+            throw UnderflowException{ };
+        LeafNode *leaf = rightmostLeaf( );
+        return item( leaf, leaf->count_ - 1 );
+    }
+
+    /**
+     * Returns true if x is found in the tree.
+     */
+    bool contains( const Comparable & x ) const
+    {
+        int calls = 0;
+        return findItem( x, calls ) != nullptr;
+    }
+
+    /**
+     * Test if the tree is logically empty.
+     * Return true if empty, false otherwise.
+     */
+    bool isEmpty( ) const
+    {
+        return root_ == nullptr;
+    }
+
+    /**
+     * Print the tree contents in sorted order.
+     */
+    void printTree( ostream & out = cout ) const
+    {
+        if( isEmpty( ) )
+            out << "Empty tree" << endl;
+        else
+            for( LeafNode *leaf = leftmostLeaf( ); leaf != nullptr; leaf = leaf->next_ )
+                for( int i = 0; i < leaf->count_; ++i )
+                    out << item( leaf, i ) << " ";
+        out << endl;
+    }
+
+    /**
+     * Make the tree logically empty.
+     */
+    void makeEmpty( )
+    {
+        if( !is_trivially_destructible<Comparable>::value && root_ != nullptr )
+        {
+            vector<Node *> pending( 1, root_ );
+            while( !pending.empty( ) )
+            {
+                Node *t = pending.back( );
+                pending.pop_back( );
+                if( t->isLeaf_ )
+                    for( int i = 0; i < t->count_; ++i )
+                        item( asLeaf( t ), i ).~Comparable( );
+                else
+                {
+                    InternalNode *in = asInternal( t );
+                    for( int i = 0; i < in->count_; ++i )
+                        key( in, i ).~Comparable( );
+                    for( int i = 0; i <= in->count_; ++i )
+                        pending.push_back( in->children_[ i ] );
+                }
+            }
+        }
+        root_ = nullptr;
+        size_ = 0;
+        leafPool_.release( );
+        internalPool_.release( );
+    }
+
+    /**
+     * Insert x into the tree; an equal item absorbs x through merge.
+     */
+    void insert( const Comparable & x )
+    {
+        insertItem( x );
+    }
+
+    /**
+     * Insert x into the tree; an equal item absorbs x through merge.
+     */
+    void insert( Comparable && x )
+    {
+        insertItem( std::move( x ) );
+    }
+
+    /**
+     * Add a batch of items. The batch and the current contents are
+     * sorted and merged, and the tree is rebuilt bottom-up in linear
+     * time with every node filled as evenly as possible.
+     */
+    void bulkLoad( vector<Comparable> items )
+    {
+        if( !isEmpty( ) )
+        {
+            vector<Comparable> current;
+            current.reserve( size_ + items.size( ) );
+            for( LeafNode *leaf = leftmostLeaf( ); leaf != nullptr; leaf = leaf->next_ )
+                for( int i = 0; i < leaf->count_; ++i )
+                    current.push_back( std::move( item( leaf, i ) ) );
+            current.insert( current.end( ), make_move_iterator( items.begin( ) ),
+                            make_move_iterator( items.end( ) ) );
+            items.swap( current );
+            makeEmpty( );
+        }
+        sortAndMerge( items );
+        if( items.empty( ) )
+            return;
+
+        // Spreading n entries evenly over ceil( n / capacity ) nodes
+        // leaves none of them underfull
+        vector<Node *> level;
+        vector<const Comparable *> mins;
+        size_t count = ( items.size( ) + CAPACITY - 1 ) / CAPACITY;
+        size_t next = 0;
+        LeafNode *prev = nullptr;
+        for( size_t j = 0; j < count; ++j )
+        {
+            LeafNode *leaf = leafPool_.allocate( );
+            for( size_t end = items.size( ) * ( j + 1 ) / count; next < end; ++next )
+                new ( &leaf->items_[ leaf->count_++ ] ) Comparable( std::move( items[ next ] ) );
+            leaf->prev_ = prev;
+            if( prev != nullptr )
+                prev->next_ = leaf;
+            prev = leaf;
+            level.push_back( leaf );
+            mins.push_back( &item( leaf, 0 ) );
+        }
+
+        while( level.size( ) > 1 )
+        {
+            vector<Node *> parents;
+            vector<const Comparable *> parentMins;
+            count = ( level.size( ) + CAPACITY ) / ( CAPACITY + 1 );
+            next = 0;
+            for( size_t j = 0; j < count; ++j )
+            {
+                InternalNode *node = internalPool_.allocate( );
+                node->children_[ 0 ] = level[ next ];
+                parentMins.push_back( mins[ next ] );
+                for( size_t end = level.size( ) * ( j + 1 ) / count; ++next < end; )
+                {
+                    new ( &node->keys_[ node->count_ ] ) Comparable( *mins[ next ] );
+                    node->children_[ ++node->count_ ] = level[ next ];
+                }
+                parents.push_back( node );
+            }
+            level.swap( parents );
+            mins.swap( parentMins );
+        }
+        root_ = level[ 0 ];
+        size_ = items.size( );
+    }
+
+    /**
+     * Add the items in [ first, last ) as one batch.
+     */
+    template <typename Iterator>
+    void bulkLoad( Iterator first, Iterator last )
+    {
+        bulkLoad( vector<Comparable>( first, last ) );
+    }
+
+    /**
+     * Remove x from the tree. Nothing is done if x is not found.
+     */
+    void remove( const Comparable & x )
+    {
+        int calls = 0;
+        removeItem( x, calls );
+    }
+
+    Comparable * find( const Comparable & x )
+    {
+        int calls = 0;
+        return findItem( x, calls );
+    }
+
+    pair<Comparable *, int> find_count( const Comparable & x )
+    {
+        int calls = 0;
+        Comparable *result = findItem( x, calls );
+        return pair<Comparable *, int>( result, calls );
+    }
+
+    /**
+     * Read-only lookups; any number of threads may run them at once
+     * as long as no thread modifies the tree.
+     */
+    const Comparable * find( const Comparable & x ) const
+    {
+        int calls = 0;
+        return findItem( x, calls );
+    }
+
+    pair<const Comparable *, int> find_count( const Comparable & x ) const
+    {
+        int calls = 0;
+        const Comparable *result = findItem( x, calls );
+        return pair<const Comparable *, int>( result, calls );
+    }
+
+    /**
+     * Look up queries sorted in increasing order in one traversal.
+     * Each node is visited at most once for the whole batch: an
+     * internal node splits its queries among its children by the
+     * separator keys, and a leaf is merged with its queries.
+     * found[ i ] is set to the match for queries[ i ], or nullptr.
+     */
+    void find_batch( const vector<Comparable> & queries, vector<const Comparable *> & found ) const
+    {
+        struct Task
+        {
+            Node *node;
+            size_t lo;
+            size_t hi;
+        };
+
+        found.assign( queries.size( ), nullptr );
+        if( isEmpty( ) )
+            return;
+        vector<Task> pending( 1, Task{ root_, 0, queries.size( ) } );
+        while( !pending.empty( ) )
+        {
+            Task task = pending.back( );
+            pending.pop_back( );
+            if( task.lo == task.hi )
+                continue;
+            if( task.node->isLeaf_ )
+            {
+                LeafNode *leaf = asLeaf( task.node );
+                int i = 0;
+                for( size_t q = task.lo; q < task.hi; ++q )
+                {
+                    while( i < leaf->count_ && item( leaf, i ) < queries[ q ] )
+                        ++i;
+                    if( i < leaf->count_ && !( queries[ q ] < item( leaf, i ) ) )
+                        found[ q ] = &item( leaf, i );
+                }
+                continue;
+            }
+            // Child i takes the queries below key( i ); push right to left
+            // so the children are visited in order
+            InternalNode *in = asInternal( task.node );
+            size_t hi = task.hi;
+            for( int i = in->count_; i > 0; --i )
+            {
+                size_t split = std::lower_bound( queries.begin( ) + task.lo, queries.begin( ) + hi,
+                                                 key( in, i - 1 ) ) - queries.begin( );
+                pending.push_back( Task{ in->children_[ i ], split, hi } );
+                hi = split;
+            }
+            pending.push_back( Task{ in->children_[ 0 ], task.lo, hi } );
+        }
+    }
+
+    bool remove_count( const Comparable & x )
+    {
+        remove_calls = 0;
+        return removeItem( x, remove_calls );
+    }
+
+    int get_remove_calls( ) const
+    {
+        return remove_calls;
+    }
+
+    size_t size( ) const
+    {
+        return size_;
+    }
+
+    /**
+     * Every item sits in a leaf, and all leaves share one level.
+     */
+    size_t depth( ) const
+    {
+        size_t levels = 0;
+        for( Node *t = root_; t != nullptr; t = t->isLeaf_ ? nullptr : asInternal( t )->children_[ 0 ] )
+            ++levels;
+        return levels * size_;
+    }
+
+    const_iterator begin( ) const
+    {
+        return const_iterator( *this, isEmpty( ) ? nullptr : leftmostLeaf( ), 0 );
+    }
+
+    const_iterator end( ) const
+    {
+        return const_iterator( *this, nullptr, 0 );
+    }
+
+    /**
+     * Return an iterator to the first item not less than x.
+     */
+    const_iterator lower_bound( const Comparable & x ) const
+    {
+        if( isEmpty( ) )
+            return end( );
+        LeafNode *leaf = leafFor( x );
+        return const_iterator( *this, leaf, lowerBound( leaf, x ) );
+    }
+
+    /**
+     * Return an iterator to the first item greater than x.
+     */
+    const_iterator upper_bound( const Comparable & x ) const
+    {
+        if( isEmpty( ) )
+            return end( );
+        LeafNode *leaf = leafFor( x );
+        return const_iterator( *this, leaf, upperBound( leaf, x ) );
+    }
+
+    /**
+     * Print every item strictly between left and right.
+     */
+    void range( const Comparable & left, const Comparable & right, ostream & out = cout ) const
+    {
+        for_each_in_range( left, right, [&out]( const Comparable & x ) {
+            out << x << '\n';
+            return true;
+        } );
+    }
+
+    /**
+     * Visit the items strictly between left and right in order along
+     * the leaf chain, stopping after limit items or once visit returns
+     * false. Return the number visited. To page through a range, pass
+     * the last item visited as the next left bound.
+     */
+    template <typename Visitor>
+    size_t for_each_in_range( const Comparable & left, const Comparable & right, Visitor visit,
+                              size_t limit = numeric_limits<size_t>::max( ) ) const
+    {
+        size_t visited = 0;
+        if( !( left < right ) )
+            return visited;
+        for( const_iterator it = upper_bound( left );
+             it != end( ) && visited < limit && *it < right; ++it )
+        {
+            ++visited;
+            if( !visit( *it ) )
+                break;
+        }
+        return visited;
+    }
+
+  private:
+    typedef typename aligned_storage<sizeof( Comparable ), alignof( Comparable )>::type Slot;
+
+    static const size_t CACHE_LINE = 64;
+    static const size_t NODE_BYTES = 8 * CACHE_LINE;
+    static const int CAPACITY =
+        NODE_BYTES / sizeof( Comparable ) > 4 ? NODE_BYTES / sizeof( Comparable ) : 4;
+    static const int MIN_COUNT = CAPACITY / 2;
+    static const int MAX_HEIGHT = 64;
+
+    struct Node
+    {
+        bool isLeaf_;
+        int  count_;    // Items in a leaf; separator keys in an internal node
+
+        explicit Node( bool leaf ) : isLeaf_{ leaf }, count_{ 0 } { }
+    };
+
+    // One spare slot lets a node overflow by one before it is split
+    struct LeafNode : Node
+    {
+        LeafNode *prev_;
+        LeafNode *next_;
+        Slot      items_[ CAPACITY + 1 ];
+
+        LeafNode( ) : Node{ true }, prev_{ nullptr }, next_{ nullptr } { }
+    };
+
+    // Child i holds the items x with key( i - 1 ) <= x < key( i )
+    struct InternalNode : Node
+    {
+        Slot  keys_[ CAPACITY + 1 ];
+        Node *children_[ CAPACITY + 2 ];
+
+        InternalNode( ) : Node{ false } { }
+    };
+
+    Node *root_;
+    size_t size_;
+    int remove_calls;
+    NodePool<LeafNode> leafPool_;
+    NodePool<InternalNode> internalPool_;
+
+    static LeafNode * asLeaf( Node *t )
+    {
+        return static_cast<LeafNode *>( t );
+    }
+
+    static InternalNode * asInternal( Node *t )
+    {
+        return static_cast<InternalNode *>( t );
+    }
+
+    static Comparable & item( LeafNode *t, int i )
+    {
+        return *reinterpret_cast<Comparable *>( &t->items_[ i ] );
+    }
+
+    static Comparable & key( InternalNode *t, int i )
+    {
+        return *reinterpret_cast<Comparable *>( &t->keys_[ i ] );
+    }
+
+    /**
+     * Move the item in src into the empty slot dst, leaving src empty.
+     */
+    static void relocate( Slot & dst, Slot & src )
+    {
+        Comparable & from = *reinterpret_cast<Comparable *>( &src );
+        new ( &dst ) Comparable( std::move( from ) );
+        from.~Comparable( );
+    }
+
+    /**
+     * Open an empty slot at pos by moving slots [pos, count) up by one.
+     */
+    static void openSlot( Slot *slots, int pos, int count )
+    {
+        for( int j = count; j > pos; --j )
+            relocate( slots[ j ], slots[ j - 1 ] );
+    }
+
+    /**
+     * Close the empty slot at pos by moving slots (pos, count) down by one.
+     */
+    static void closeSlot( Slot *slots, int pos, int count )
+    {
+        for( int j = pos; j < count - 1; ++j )
+            relocate( slots[ j ], slots[ j + 1 ] );
+    }
+
+    /**
+     * Return the child of t whose subtree would hold x.
+     */
+    static int childIndex( InternalNode *t, const Comparable & x )
+    {
+        int i = 0;
+        while( i < t->count_ && !( x < key( t, i ) ) )
+            ++i;
+        return i;
+    }
+
+    /**
+     * Return the first position in leaf t whose item is not less than x.
+     */
+    static int lowerBound( LeafNode *t, const Comparable & x )
+    {
+        int i = 0;
+        while( i < t->count_ && item( t, i ) < x )
+            ++i;
+        return i;
+    }
+
+    /**
+     * Return the first position in leaf t whose item is greater than x.
+     */
+    static int upperBound( LeafNode *t, const Comparable & x )
+    {
+        int i = 0;
+        while( i < t->count_ && !( x < item( t, i ) ) )
+            ++i;
+        return i;
+    }
+
+    LeafNode * leftmostLeaf( ) const
+    {
+        Node *t = root_;
+        while( !t->isLeaf_ )
+            t = asInternal( t )->children_[ 0 ];
+        return asLeaf( t );
+    }
+
+    LeafNode * rightmostLeaf( ) const
+    {
+        Node *t = root_;
+        while( !t->isLeaf_ )
+            t = asInternal( t )->children_[ t->count_ ];
+        return asLeaf( t );
+    }
+
+    /**
+     * Return the leaf whose key range holds x. The items after x that
+     * are not in it start the next leaf.
+     */
+    LeafNode * leafFor( const Comparable & x ) const
+    {
+        Node *t = root_;
+        while( !t->isLeaf_ )
+            t = asInternal( t )->children_[ childIndex( asInternal( t ), x ) ];
+        return asLeaf( t );
+    }
+
+    /**
+     * Internal method to find x; calls counts the nodes visited.
+     */
+    Comparable * findItem( const Comparable & x, int & calls ) const
+    {
+        if( root_ == nullptr )
+            return nullptr;
+        Node *t = root_;
+        while( !t->isLeaf_ )
+        {
+            calls++;
+            t = asInternal( t )->children_[ childIndex( asInternal( t ), x ) ];
+        }
+        calls++;
+        LeafNode *leaf = asLeaf( t );
+        int pos = lowerBound( leaf, x );
+        if( pos < leaf->count_ && !( x < item( leaf, pos ) ) )
+            return &item( leaf, pos );
+        return nullptr;
+    }
+
+    /**
+     * Internal method to insert x. Full nodes along the path are split
+     * bottom-up, and a split of the root grows the tree by one level.
+     */
+    template <typename Item>
+    void insertItem( Item && x )
+    {
+        if( root_ == nullptr )
+        {
+            LeafNode *leaf = leafPool_.allocate( );
+            new ( &leaf->items_[ 0 ] ) Comparable( std::forward<Item>( x ) );
+            leaf->count_ = 1;
+            root_ = leaf;
+            size_ = 1;
+            return;
+        }
+
+        InternalNode *path[ MAX_HEIGHT ];
+        int slots[ MAX_HEIGHT ];
+        int height = 0;
+        Node *t = root_;
+        while( !t->isLeaf_ )
+        {
+            path[ height ] = asInternal( t );
+            slots[ height ] = childIndex( asInternal( t ), x );
+            t = asInternal( t )->children_[ slots[ height ] ];
+            ++height;
+        }
+
+        LeafNode *leaf = asLeaf( t );
+        int pos = lowerBound( leaf, x );
+        if( pos < leaf->count_ && !( x < item( leaf, pos ) ) )
+        {
+            item( leaf, pos ).merge( x );
+            return;
+        }
+        openSlot( leaf->items_, pos, leaf->count_ );
+        new ( &leaf->items_[ pos ] ) Comparable( std::forward<Item>( x ) );
+        ++leaf->count_;
+        ++size_;
+        if( leaf->count_ <= CAPACITY )
+            return;
+
+        // Split the overfull leaf; its upper half moves to a new right sibling
+        LeafNode *right = leafPool_.allocate( );
+        int keep = leaf->count_ / 2;
+        for( int i = keep; i < leaf->count_; ++i )
+            relocate( right->items_[ i - keep ], leaf->items_[ i ] );
+        right->count_ = leaf->count_ - keep;
+        leaf->count_ = keep;
+        right->next_ = leaf->next_;
+        right->prev_ = leaf;
+        if( leaf->next_ != nullptr )
+            leaf->next_->prev_ = right;
+        leaf->next_ = right;
+
+        Comparable separator = item( right, 0 );
+        Node *newChild = right;
+        while( height > 0 )
+        {
+            --height;
+            InternalNode *parent = path[ height ];
+            int i = slots[ height ];
+            openSlot( parent->keys_, i, parent->count_ );
+            new ( &parent->keys_[ i ] ) Comparable( std::move( separator ) );
+            for( int j = parent->count_ + 1; j > i + 1; --j )
+                parent->children_[ j ] = parent->children_[ j - 1 ];
+            parent->children_[ i + 1 ] = newChild;
+            ++parent->count_;
+            if( parent->count_ <= CAPACITY )
+                return;
+
+            // Split the overfull internal node around its middle key
+            InternalNode *sibling = internalPool_.allocate( );
+            int mid = parent->count_ / 2;
+            separator = std::move( key( parent, mid ) );
+            key( parent, mid ).~Comparable( );
+            for( int j = mid + 1; j < parent->count_; ++j )
+                relocate( sibling->keys_[ j - mid - 1 ], parent->keys_[ j ] );
+            for( int j = mid + 1; j <= parent->count_; ++j )
+                sibling->children_[ j - mid - 1 ] = parent->children_[ j ];
+            sibling->count_ = parent->count_ - mid - 1;
+            parent->count_ = mid;
+            newChild = sibling;
+        }
+
+        InternalNode *newRoot = internalPool_.allocate( );
+        new ( &newRoot->keys_[ 0 ] ) Comparable( std::move( separator ) );
+        newRoot->children_[ 0 ] = root_;
+        newRoot->children_[ 1 ] = newChild;
+        newRoot->count_ = 1;
+        root_ = newRoot;
+    }
+
+    /**
+     * Internal method to remove x; calls counts the nodes visited.
+     * Underfull nodes borrow from a sibling or merge with it,
+     * bottom-up along the search path.
+     */
+    bool removeItem( const Comparable & x, int & calls )
+    {
+        if( root_ == nullptr )
+            return false;
+
+        InternalNode *path[ MAX_HEIGHT ];
+        int slots[ MAX_HEIGHT ];
+        int height = 0;
+        Node *t = root_;
+        while( !t->isLeaf_ )
+        {
+            calls++;
+            path[ height ] = asInternal( t );
+            slots[ height ] = childIndex( asInternal( t ), x );
+            t = asInternal( t )->children_[ slots[ height ] ];
+            ++height;
+        }
+        calls++;
+
+        LeafNode *leaf = asLeaf( t );
+        int pos = lowerBound( leaf, x );
+        if( pos == leaf->count_ || x < item( leaf, pos ) )
+            return false;   // Item not found; do nothing
+        item( leaf, pos ).~Comparable( );
+        closeSlot( leaf->items_, pos, leaf->count_ );
+        --leaf->count_;
+        --size_;
+
+        while( height > 0 && t->count_ < MIN_COUNT )
+        {
+            --height;
+            rebalanceChild( path[ height ], slots[ height ] );
+            t = path[ height ];
+        }
+
+        if( root_->isLeaf_ && root_->count_ == 0 )
+        {
+            leafPool_.deallocate( asLeaf( root_ ) );
+            root_ = nullptr;
+        }
+        else if( !root_->isLeaf_ && root_->count_ == 0 )
+        {
+            InternalNode *oldRoot = asInternal( root_ );
+            root_ = oldRoot->children_[ 0 ];
+            internalPool_.deallocate( oldRoot );
+        }
+        return true;
+    }
+
+    /**
+     * Child i of parent has one entry too few. Borrow an entry from an
+     * adjacent sibling if it can spare one, otherwise merge with it.
+     */
+    void rebalanceChild( InternalNode *parent, int i )
+    {
+        Node *child = parent->children_[ i ];
+        Node *left = i > 0 ? parent->children_[ i - 1 ] : nullptr;
+        Node *right = i < parent->count_ ? parent->children_[ i + 1 ] : nullptr;
+
+        if( left != nullptr && left->count_ > MIN_COUNT )
+        {
+            if( child->isLeaf_ )
+                borrowFromLeftLeaf( parent, i );
+            else
+                borrowFromLeftInternal( parent, i );
+        }
+        else if( right != nullptr && right->count_ > MIN_COUNT )
+        {
+            if( child->isLeaf_ )
+                borrowFromRightLeaf( parent, i );
+            else
+                borrowFromRightInternal( parent, i );
+        }
+        else
+        {
+            int j = left != nullptr ? i - 1 : i;
+            if( child->isLeaf_ )
+                mergeLeaves( parent, j );
+            else
+                mergeInternals( parent, j );
+        }
+    }
+
+    void borrowFromLeftLeaf( InternalNode *parent, int i )
+    {
+        LeafNode *leaf = asLeaf( parent->children_[ i ] );
+        LeafNode *left = asLeaf( parent->children_[ i - 1 ] );
+        openSlot( leaf->items_, 0, leaf->count_ );
+        relocate( leaf->items_[ 0 ], left->items_[ left->count_ - 1 ] );
+        --left->count_;
+        ++leaf->count_;
+        key( parent, i - 1 ) = item( leaf, 0 );
+    }
+
+    void borrowFromRightLeaf( InternalNode *parent, int i )
+    {
+        LeafNode *leaf = asLeaf( parent->children_[ i ] );
+        LeafNode *right = asLeaf( parent->children_[ i + 1 ] );
+        relocate( leaf->items_[ leaf->count_ ], right->items_[ 0 ] );
+        closeSlot( right->items_, 0, right->count_ );
+        --right->count_;
+        ++leaf->count_;
+        key( parent, i ) = item( right, 0 );
+    }
+
+    void borrowFromLeftInternal( InternalNode *parent, int i )
+    {
+        InternalNode *node = asInternal( parent->children_[ i ] );
+        InternalNode *left = asInternal( parent->children_[ i - 1 ] );
+        openSlot( node->keys_, 0, node->count_ );
+        for( int j = node->count_ + 1; j > 0; --j )
+            node->children_[ j ] = node->children_[ j - 1 ];
+        new ( &node->keys_[ 0 ] ) Comparable( std::move( key( parent, i - 1 ) ) );
+        node->children_[ 0 ] = left->children_[ left->count_ ];
+        key( parent, i - 1 ) = std::move( key( left, left->count_ - 1 ) );
+        key( left, left->count_ - 1 ).~Comparable( );
+        --left->count_;
+        ++node->count_;
+    }
+
+    void borrowFromRightInternal( InternalNode *parent, int i )
+    {
+        InternalNode *node = asInternal( parent->children_[ i ] );
+        InternalNode *right = asInternal( parent->children_[ i + 1 ] );
+        new ( &node->keys_[ node->count_ ] ) Comparable( std::move( key( parent, i ) ) );
+        node->children_[ node->count_ + 1 ] = right->children_[ 0 ];
+        ++node->count_;
+        key( parent, i ) = std::move( key( right, 0 ) );
+        key( right, 0 ).~Comparable( );
+        closeSlot( right->keys_, 0, right->count_ );
+        for( int j = 0; j < right->count_; ++j )
+            right->children_[ j ] = right->children_[ j + 1 ];
+        --right->count_;
+    }
+
+    /**
+     * Drop separator j and child j + 1 from parent.
+     */
+    void removeSeparator( InternalNode *parent, int j )
+    {
+        key( parent, j ).~Comparable( );
+        closeSlot( parent->keys_, j, parent->count_ );
+        for( int c = j + 1; c < parent->count_; ++c )
+            parent->children_[ c ] = parent->children_[ c + 1 ];
+        --parent->count_;
+    }
+
+    /**
+     * Fold leaf j + 1 of parent into leaf j.
+     */
+    void mergeLeaves( InternalNode *parent, int j )
+    {
+        LeafNode *left = asLeaf( parent->children_[ j ] );
+        LeafNode *right = asLeaf( parent->children_[ j + 1 ] );
+        for( int i = 0; i < right->count_; ++i )
+            relocate( left->items_[ left->count_ + i ], right->items_[ i ] );
+        left->count_ += right->count_;
+        left->next_ = right->next_;
+        if( right->next_ != nullptr )
+            right->next_->prev_ = left;
+        leafPool_.deallocate( right );
+        removeSeparator( parent, j );
+    }
+
+    /**
+     * Fold internal node j + 1 of parent, and the separator between
+     * the two, into internal node j.
+     */
+    void mergeInternals( InternalNode *parent, int j )
+    {
+        InternalNode *left = asInternal( parent->children_[ j ] );
+        InternalNode *right = asInternal( parent->children_[ j + 1 ] );
+        new ( &left->keys_[ left->count_ ] ) Comparable( std::move( key( parent, j ) ) );
+        for( int i = 0; i < right->count_; ++i )
+            relocate( left->keys_[ left->count_ + 1 + i ], right->keys_[ i ] );
+        for( int i = 0; i <= right->count_; ++i )
+            left->children_[ left->count_ + 1 + i ] = right->children_[ i ];
+        left->count_ += 1 + right->count_;
+        internalPool_.deallocate( right );
+        removeSeparator( parent, j );
+    }
+
+    /**
+     * Internal method to clone a subtree. last is the most recently
+     * cloned leaf, so the new leaves can be chained in order.
+     */
+    Node * clone( Node *t, LeafNode * & last )
+    {
+        if( t == nullptr )
+            return nullptr;
+        if( t->isLeaf_ )
+        {
+            LeafNode *from = asLeaf( t );
+            LeafNode *leaf = leafPool_.allocate( );
+            for( int i = 0; i < from->count_; ++i )
+                new ( &leaf->items_[ i ] ) Comparable( item( from, i ) );
+            leaf->count_ = from->count_;
+            leaf->prev_ = last;
+            if( last != nullptr )
+                last->next_ = leaf;
+            last = leaf;
+            return leaf;
+        }
+        InternalNode *from = asInternal( t );
+        InternalNode *node = internalPool_.allocate( );
+        for( int i = 0; i < from->count_; ++i )
+            new ( &node->keys_[ i ] ) Comparable( key( from, i ) );
+        for( int i = 0; i <= from->count_; ++i )
+            node->children_[ i ] = clone( from->children_[ i ], last );
+        node->count_ = from->count_;
+        return node;
+    }
+};
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef BATCH_SEARCH_H
+#define BATCH_SEARCH_H
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+using namespace std;
+
+/**
+ * Look up a batch of queries, sorted in increasing order, in the binary
+ * search tree rooted at root in one merged traversal. Each node is
+ * visited at most once for the whole batch: the queries equal to its
+ * item are answered there, and the rest are split between its subtrees,
+ * so the shared part of their root-to-leaf paths is walked only once.
+ * found[ i ] is set to the match for queries[ i ], or nullptr.
+ *
+ * Node needs element_, left_ and right_ members.
+ */
+template <typename Node, typename Comparable>
+void findBatch( Node *root, const vector<Comparable> & queries,
+                vector<const Comparable *> & found )
+{
+    struct Task
+    {
+        Node *node;
+        size_t lo;
+        size_t hi;
+    };
+
+    found.assign( queries.size( ), nullptr );
+    vector<Task> pending;
+    Task task = { root, 0, queries.size( ) };
+    while( true )
+    {
+        if( task.node == nullptr || task.lo == task.hi )
+        {
+            if( pending.empty( ) )
+                return;
+            task = pending.back( );
+            pending.pop_back( );
+            continue;
+        }
+        const Comparable & item = task.node->element_;
+        size_t less = lower_bound( queries.begin( ) + task.lo, queries.begin( ) + task.hi, item )
+                      - queries.begin( );
+        size_t equal = less;
+        while( equal < task.hi && !( item < queries[ equal ] ) )
+            found[ equal++ ] = &item;
+
+        Task right = { task.node->right_, equal, task.hi };
+        pending.push_back( right );
+        task.node = task.node->left_;
+        task.hi = less;
+    }
+}
+
+#endif
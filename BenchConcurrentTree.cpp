@@ -0,0 +1,139 @@
+#include "AvlTree.h"
+#include "CowAvlTree.h"
+#include "ConcurrentAvlTree.h"
+#include "SequenceMap.cpp"
+#include "RebaseParser.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <cstdlib>
+using namespace std;
+
+// Throughput against thread count for mixes of insert, find and remove
+// on the sequences of a REBASE file. Each mix runs on three trees: the
+// ConcurrentAvlTree, the CowAvlTree, whose writers take turns on one
+// mutex, and an AvlTree behind one global mutex. Each run starts from
+// a tree holding every other sequence.
+
+// Percentages of each operation; the rest are removes
+struct Mix {
+    const char *name;
+    int find_percent;
+    int insert_percent;
+};
+
+// The three operations the benchmark needs from a tree under test
+struct ConcurrentTarget {
+    ConcurrentAvlTree<SequenceMap> tree;
+
+    bool find(const SequenceMap &x) const { return tree.contains(x); }
+    void insert(const SequenceMap &x) { tree.insert(x); }
+    void remove(const SequenceMap &x) { tree.remove(x); }
+};
+
+struct CowTarget {
+    CowAvlTree<SequenceMap> tree;
+
+    bool find(const SequenceMap &x) const { return tree.contains(x); }
+    void insert(const SequenceMap &x) { tree.insert(x); }
+    void remove(const SequenceMap &x) { tree.remove(x); }
+};
+
+struct LockedTarget {
+    AvlTree<SequenceMap> tree;
+    mutable mutex lock;
+
+    bool find(const SequenceMap &x) const {
+        lock_guard<mutex> guard(lock);
+        return tree.find(x) != nullptr;
+    }
+    void insert(const SequenceMap &x) {
+        lock_guard<mutex> guard(lock);
+        tree.insert(x);
+    }
+    void remove(const SequenceMap &x) {
+        lock_guard<mutex> guard(lock);
+        tree.remove(x);
+    }
+};
+
+// Run the mix on a fresh tree with the given number of threads for the
+// given time; return operations per second
+template <typename Target>
+double RunMix(const vector<SequenceMap> &sequence_maps, const Mix &mix, int threads,
+              int milliseconds) {
+    Target target;
+    for (size_t i = 0; i < sequence_maps.size(); i += 2) target.insert(sequence_maps[i]);
+
+    atomic<bool> stop(false);
+    atomic<long> operations(0), found(0);
+    vector<thread> workers;
+    for (int t = 0; t < threads; t++) {
+        workers.push_back(thread([&, t]() {
+            mt19937 random(t + 1);
+            long n = 0, hits = 0;
+            while (!stop.load(memory_order_relaxed)) {
+                const SequenceMap &x = sequence_maps[random() % sequence_maps.size()];
+                int op = random() % 100;
+                if (op < mix.find_percent) {
+                    if (target.find(x)) hits++;
+                } else if (op < mix.find_percent + mix.insert_percent) {
+                    target.insert(x);
+                } else {
+                    target.remove(x);
+                }
+                n++;
+            }
+            operations += n;
+            found += hits;
+        }));
+    }
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    this_thread::sleep_for(chrono::milliseconds(milliseconds));
+    stop = true;
+    for (int t = 0; t < threads; t++) workers[t].join();
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    return operations / seconds;
+}
+
+int
+main(int argc, char **argv) {
+    if (argc < 2 || argc > 4) {
+        cout << "Usage: " << argv[0] << " <databasefilename> [max threads] [milliseconds]" << endl;
+        return 0;
+    }
+    vector<SequenceMap> sequence_maps;
+    if (!ReadRebaseFile(argv[1], sequence_maps)) {
+        cout << "Cannot read " << argv[1] << endl;
+        return 1;
+    }
+    int max_threads = argc >= 3 ? atoi(argv[2]) : 4;
+    int milliseconds = argc == 4 ? atoi(argv[3]) : 300;
+    if (sequence_maps.empty() || max_threads < 1) {
+        cout << "Need at least one sequence and one thread" << endl;
+        return 1;
+    }
+    cout << sequence_maps.size() << " sequences, " << milliseconds << " ms per run, "
+         << thread::hardware_concurrency() << " hardware threads" << endl;
+
+    const Mix mixes[] = { { "90% find, 5% insert, 5% remove", 90, 5 },
+                          { "50% find, 25% insert, 25% remove", 50, 25 },
+                          { "50% insert, 50% remove", 0, 50 } };
+    for (size_t m = 0; m < sizeof(mixes) / sizeof(mixes[0]); m++) {
+        cout << mixes[m].name << " (operations/sec)" << endl;
+        for (int threads = 1; threads <= max_threads; threads *= 2) {
+            cout << "  " << threads << " threads: concurrent "
+                 << RunMix<ConcurrentTarget>(sequence_maps, mixes[m], threads, milliseconds)
+                 << ", snapshot " << RunMix<CowTarget>(sequence_maps, mixes[m], threads, milliseconds)
+                 << ", locked " << RunMix<LockedTarget>(sequence_maps, mixes[m], threads, milliseconds)
+                 << endl;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,84 @@
+#include "PackedSequence.h"
+#include "RebaseParser.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <cstdlib>
+using namespace std;
+
+// Cost of comparing recognition sequences as std::strings and as
+// PackedSequences. The keys are the sequences of a REBASE file, scaled
+// as in BenchMemory: copy c gets a distinct 4-symbol prefix, which also
+// pushes the longest sequences past the inline limit. Each key type is
+// timed on random pairs and on a full sort.
+
+vector<string> ReadScaledSequences(const string &db_filename, int scale) {
+    vector<string> original;
+    ParseRebaseFile(db_filename, [&original](const char *enzyme, size_t enzyme_length,
+                                             const char *sequence, size_t sequence_length) {
+        original.emplace_back(sequence, sequence_length);
+    });
+    vector<string> sequences;
+    for (int c = 0; c < scale; c++) {
+        string prefix;
+        for (int digit = c; prefix.size() < 4; digit /= 4) prefix += "ACGT"[digit % 4];
+        for (size_t i = 0; i < original.size(); i++) sequences.push_back(prefix + original[i]);
+    }
+    return sequences;
+}
+
+// Nanoseconds per comparison over the given pairs, and over a sort
+template <typename Key>
+void TimeKey(const string &name, vector<Key> keys, const vector<pair<size_t, size_t> > &pairs) {
+    const int rounds = 10;
+    long less = 0;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (int r = 0; r < rounds; r++)
+        for (size_t i = 0; i < pairs.size(); i++)
+            if (keys[pairs[i].first] < keys[pairs[i].second]) less++;
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout << name << ": " << seconds * 1e9 / (rounds * pairs.size()) << " ns per random compare";
+
+    long compares = 0;
+    start = chrono::steady_clock::now();
+    sort(keys.begin(), keys.end(), [&compares](const Key &a, const Key &b) {
+        compares++;
+        return a < b;
+    });
+    seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout << ", " << seconds * 1e9 / compares << " ns per sort compare (" << less << " less)" << endl;
+}
+
+int
+main(int argc, char **argv) {
+    if (argc != 2 && argc != 3) {
+        cout << "Usage: " << argv[0] << " <databasefilename> [scale]" << endl;
+        return 0;
+    }
+    int scale = argc == 3 ? atoi(argv[2]) : 100;
+    vector<string> strings = scale < 1 ? vector<string>() : ReadScaledSequences(argv[1], scale);
+    if (strings.empty()) {
+        cout << "Need at least one sequence" << endl;
+        return 1;
+    }
+    vector<PackedSequence> packed;
+    size_t inline_keys = 0;
+    for (size_t i = 0; i < strings.size(); i++) {
+        packed.emplace_back(strings[i]);
+        if (packed.back().isInline()) inline_keys++;
+    }
+    cout << strings.size() << " keys (" << scale << "x), " << inline_keys << " inline; sizeof(string) = "
+         << sizeof(string) << ", sizeof(PackedSequence) = " << sizeof(PackedSequence) << endl;
+
+    mt19937 random(1);
+    vector<pair<size_t, size_t> > pairs(1000000);
+    for (size_t i = 0; i < pairs.size(); i++)
+        pairs[i] = make_pair(random() % strings.size(), random() % strings.size());
+    TimeKey("string", strings, pairs);
+    TimeKey("packed", packed, pairs);
+    return 0;
+}
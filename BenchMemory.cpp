@@ -0,0 +1,114 @@
+#include "AvlTree.h"
+#include "SequenceMap.cpp"
+#include "RebaseParser.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdlib>
+#include <malloc.h>
+#include <new>
+using namespace std;
+
+// Memory footprint of an AvlTree<SequenceMap> loaded from a REBASE file
+// scaled up by a factor. Copy c of every entry gets a distinct prefix
+// on its sequence but keeps its enzyme name, so each copy adds as many
+// new keys as the original file has while the names repeat, as they do
+// in real data, where an enzyme recognizes many sequences and the
+// isoschizomers of one share a sequence. Heap use is tracked by
+// replacing the global operator new and delete.
+
+static size_t live_bytes = 0;
+static size_t live_blocks = 0;
+
+void *operator new(size_t size) {
+    void *p = malloc(size == 0 ? 1 : size);
+    if (p == nullptr) throw bad_alloc();
+    live_bytes += malloc_usable_size(p);
+    live_blocks++;
+    return p;
+}
+
+void operator delete(void *p) noexcept {
+    if (p == nullptr) return;
+    live_bytes -= malloc_usable_size(p);
+    live_blocks--;
+    free(p);
+}
+
+void *operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete[](void *p) noexcept {
+    operator delete(p);
+}
+
+struct Entry {
+    string enzyme;
+    string sequence;
+};
+
+vector<Entry> ReadScaledRebase(const string &db_filename, int scale) {
+    vector<Entry> original;
+    ParseRebaseFile(db_filename, [&original](const char *enzyme, size_t enzyme_length,
+                                             const char *sequence, size_t sequence_length) {
+        original.push_back(Entry{ string(enzyme, enzyme_length), string(sequence, sequence_length) });
+    });
+    vector<Entry> entries;
+    entries.reserve(original.size() * scale);
+    for (int c = 0; c < scale; c++) {
+        string prefix;
+        for (int digit = c; prefix.size() < 4; digit /= 4) prefix += "ACGT"[digit % 4];
+        for (size_t i = 0; i < original.size(); i++)
+            entries.push_back(Entry{ original[i].enzyme, prefix + original[i].sequence });
+    }
+    return entries;
+}
+
+void Report(const string &stage, const AvlTree<SequenceMap> &tree, size_t bytes, size_t blocks) {
+    cout << stage << ": " << tree.size() << " sequences, " << bytes / (1024.0 * 1024.0) << " MB in "
+         << blocks << " blocks, " << double(bytes) / tree.size() << " bytes and "
+         << double(blocks) / tree.size() << " blocks per sequence" << endl;
+}
+
+int
+main(int argc, char **argv) {
+    if (argc != 2 && argc != 3) {
+        cout << "Usage: " << argv[0] << " <databasefilename> [scale]" << endl;
+        return 0;
+    }
+    int scale = argc == 3 ? atoi(argv[2]) : 100;
+    vector<Entry> entries = ReadScaledRebase(argv[1], scale);
+    if (entries.empty() || scale < 1) {
+        cout << "Need at least one sequence" << endl;
+        return 1;
+    }
+    cout << entries.size() << " entries (" << scale << "x), sizeof(SequenceMap) = "
+         << sizeof(SequenceMap) << endl;
+
+    size_t base_bytes = live_bytes, base_blocks = live_blocks;
+    AvlTree<SequenceMap> tree;
+    for (size_t i = 0; i < entries.size(); i++)
+        tree.insert(SequenceMap(entries[i].sequence, entries[i].enzyme));
+    Report("Loaded  ", tree, live_bytes - base_bytes, live_blocks - base_blocks);
+
+    // Loading the same file again merges every entry into itself
+    for (size_t i = 0; i < entries.size(); i++)
+        tree.insert(SequenceMap(entries[i].sequence, entries[i].enzyme));
+    Report("Reloaded", tree, live_bytes - base_bytes, live_blocks - base_blocks);
+
+    vector<SequenceMap> queries;
+    for (size_t i = 0; i < entries.size(); i++) queries.push_back(SequenceMap(entries[i].sequence, ""));
+    const int rounds = 5;
+    size_t found = 0;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (int r = 0; r < rounds; r++)
+        for (size_t i = 0; i < queries.size(); i++)
+            if (tree.find(queries[i]) != nullptr) found++;
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout << "Lookups: " << found << " found, " << seconds * 1e9 / (rounds * queries.size())
+         << " ns per lookup" << endl;
+    return 0;
+}
@@ -0,0 +1,121 @@
+#include "RebaseParser.h"
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+using namespace std;
+
+// Throughput benchmark for the REBASE parser. Generates a synthetic
+// REBASE-format file of the requested size, then parses it with the
+// original getline/substr parser and with the memory-mapped parser.
+
+// Small xorshift generator so the synthetic file is reproducible
+uint64_t NextRandom(uint64_t &state) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+// Write a REBASE-format file of about megabytes MB
+void WriteSyntheticRebase(const string &filename, size_t megabytes) {
+    static const char iupac[] = "ACGTACGTACGTNRYSWKMBDHV";
+    FILE *out = fopen(filename.c_str(), "w");
+    if (out == nullptr) {
+        cout << "Cannot write " << filename << endl;
+        exit(1);
+    }
+    for (int i = 0; i < REBASE_HEADER_LINES; i++)
+        fputs(" \n", out);
+
+    uint64_t state = 88172645463325252ULL;
+    size_t target = megabytes * 1024 * 1024;
+    size_t written = 0;
+    string line;
+    for (size_t enzyme = 0; written < target; enzyme++) {
+        line = "Enz" + to_string(enzyme) + "I";
+        int sequences = 1 + NextRandom(state) % 3;
+        for (int s = 0; s < sequences; s++) {
+            line += '/';
+            int length = 4 + NextRandom(state) % 17;
+            int cut = NextRandom(state) % (length + 1);
+            for (int j = 0; j < length; j++) {
+                if (j == cut) line += '\'';
+                line += iupac[NextRandom(state) % (sizeof(iupac) - 1)];
+            }
+        }
+        line += "//\n";
+        fwrite(line.data(), 1, line.size(), out);
+        written += line.size();
+    }
+    fclose(out);
+}
+
+// The parser this benchmark replaces: one getline and one substr per token
+size_t ParseWithLineCopies(const string &db_filename, size_t &bytes) {
+    string db_line;
+    fstream fin(db_filename.c_str());
+    for (int i = 0; i < REBASE_HEADER_LINES; i++)
+        getline(fin, db_line);
+    size_t visited = 0;
+    while (getline(fin, db_line)) {
+        size_t loc = db_line.find("/");
+        string an_enz_acro = db_line.substr(0, loc);
+        db_line = db_line.substr(loc + 1);
+        while (true) {
+            loc = db_line.find("/");
+            if (loc == string::npos || loc == db_line.size() - 1) break;
+            string a_reco_seq = db_line.substr(0, loc);
+            db_line = db_line.substr(loc + 1);
+            bytes += a_reco_seq.size() + an_enz_acro.size();
+            visited++;
+        }
+    }
+    return visited;
+}
+
+size_t ParseWithMapping(const string &db_filename, size_t &bytes) {
+    size_t visited = 0;
+    ParseRebaseFile(db_filename, [&](const char *, size_t enzyme_length,
+                                     const char *, size_t sequence_length) {
+        bytes += sequence_length + enzyme_length;
+        visited++;
+    });
+    return visited;
+}
+
+template <typename Parser>
+void TimeParser(const string &name, Parser parse, const string &db_filename, size_t file_bytes) {
+    size_t bytes = 0;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    size_t visited = parse(db_filename, bytes);
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout << name << ": " << visited << " sequences in " << seconds << " s, "
+         << file_bytes / seconds / (1024 * 1024) << " MB/s" << endl;
+}
+
+int
+main(int argc, char **argv) {
+    if (argc != 2 && argc != 3) {
+        cout << "Usage: " << argv[0] << " <megabytes> [filename]" << endl;
+        return 0;
+    }
+    size_t megabytes = strtoul(argv[1], nullptr, 10);
+    string filename(argc == 3 ? argv[2] : "synthetic_rebase.txt");
+
+    MappedFile existing(filename);
+    if (!existing.isOpen() || existing.size() < megabytes * 1024 * 1024) {
+        cout << "Writing " << megabytes << " MB to " << filename << endl;
+        WriteSyntheticRebase(filename, megabytes);
+    }
+    size_t file_bytes = MappedFile(filename).size();
+
+    TimeParser("Line-copy parser", ParseWithLineCopies, filename, file_bytes);
+    TimeParser("Mapped parser", ParseWithMapping, filename, file_bytes);
+    return 0;
+}
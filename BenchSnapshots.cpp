@@ -0,0 +1,139 @@
+#include "AvlTree.h"
+#include "CowAvlTree.h"
+#include "SequenceMap.cpp"
+#include "RebaseParser.h"
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <cstdlib>
+using namespace std;
+
+// Mixed read/write benchmark for CowAvlTree. Reader threads look up the
+// query file in a loop, first alone and then while one writer thread
+// keeps inserting and removing entries. The same runs against an
+// AvlTree behind one global mutex show what the lock costs readers.
+
+vector<SequenceMap> ReadQueries(const string &query_filename) {
+    vector<SequenceMap> queries;
+    fstream fin(query_filename.c_str());
+    string line;
+    while (getline(fin, line))
+        if (!line.empty()) queries.push_back(SequenceMap(line, ""));
+    return queries;
+}
+
+// The only two operations the benchmark needs from a tree under test
+struct CowTarget {
+    CowAvlTree<SequenceMap> tree;
+
+    bool find(const SequenceMap &x) const {
+        return tree.snapshot().find(x) != nullptr;
+    }
+
+    void write(const SequenceMap &x, bool add) {
+        if (add) tree.insert(x);
+        else tree.remove(x);
+    }
+};
+
+struct LockedTarget {
+    AvlTree<SequenceMap> tree;
+    mutable mutex lock;
+
+    bool find(const SequenceMap &x) const {
+        lock_guard<mutex> guard(lock);
+        return tree.find(x) != nullptr;
+    }
+
+    void write(const SequenceMap &x, bool add) {
+        lock_guard<mutex> guard(lock);
+        if (add) tree.insert(x);
+        else tree.remove(x);
+    }
+};
+
+// Run readers (and a writer if with_writer) for the given time; return
+// reads per second and set writes_per_sec
+template <typename Target>
+double RunMix(Target &target, const vector<SequenceMap> &queries, int readers,
+              int milliseconds, bool with_writer, double &writes_per_sec) {
+    atomic<bool> stop(false);
+    atomic<long> reads(0), found(0), writes(0);
+    vector<thread> threads;
+    for (int r = 0; r < readers; r++) {
+        threads.push_back(thread([&, r]() {
+            long n = 0, hits = 0;
+            for (size_t i = r; !stop.load(memory_order_relaxed); i = (i + 1) % queries.size()) {
+                if (target.find(queries[i])) hits++;
+                n++;
+            }
+            reads += n;
+            found += hits;
+        }));
+    }
+    if (with_writer) {
+        threads.push_back(thread([&]() {
+            long n = 0;
+            for (size_t i = 0; !stop.load(memory_order_relaxed); i++) {
+                SequenceMap entry("WRITER" + to_string(i % 1000), "Wrt" + to_string(i));
+                target.write(entry, (i / 1000) % 2 == 0);
+                n++;
+            }
+            writes += n;
+        }));
+    }
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    this_thread::sleep_for(chrono::milliseconds(milliseconds));
+    stop = true;
+    for (size_t i = 0; i < threads.size(); i++) threads[i].join();
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    writes_per_sec = writes / seconds;
+    return reads / seconds;
+}
+
+template <typename Target>
+void BenchTarget(const string &name, Target &target, const vector<SequenceMap> &queries,
+                 int readers, int milliseconds) {
+    double writes_per_sec;
+    double alone = RunMix(target, queries, readers, milliseconds, false, writes_per_sec);
+    double mixed = RunMix(target, queries, readers, milliseconds, true, writes_per_sec);
+    cout << name << ": " << alone << " reads/sec alone, " << mixed << " reads/sec with writer ("
+         << mixed / alone * 100 << "%), " << writes_per_sec << " writes/sec" << endl;
+}
+
+int
+main(int argc, char **argv) {
+    if (argc < 3 || argc > 5) {
+        cout << "Usage: " << argv[0] << " <databasefilename> <queryfilename> [readers] [milliseconds]" << endl;
+        return 0;
+    }
+    vector<SequenceMap> sequence_maps;
+    if (!ReadRebaseFile(argv[1], sequence_maps)) {
+        cout << "Cannot read " << argv[1] << endl;
+        return 1;
+    }
+    vector<SequenceMap> queries = ReadQueries(argv[2]);
+    int readers = argc >= 4 ? atoi(argv[3]) : 2;
+    int milliseconds = argc == 5 ? atoi(argv[4]) : 1000;
+    if (queries.empty() || readers < 1) {
+        cout << "Need at least one query and one reader" << endl;
+        return 1;
+    }
+    cout << readers << " readers, " << milliseconds << " ms per run, "
+         << thread::hardware_concurrency() << " hardware threads" << endl;
+
+    CowTarget cow;
+    cow.tree.bulkLoad(sequence_maps);
+    BenchTarget("Snapshot tree", cow, queries, readers, milliseconds);
+
+    LockedTarget locked;
+    locked.tree.bulkLoad(sequence_maps);
+    BenchTarget("Locked tree  ", locked, queries, readers, milliseconds);
+    return 0;
+}
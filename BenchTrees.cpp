@@ -0,0 +1,560 @@
+#include "BinarySearchTree.h"
+#include "AvlTree.h"
+#include "BPlusTree.h"
+#include "RadixTrie.h"
+#include "SequenceHashMap.h"
+#include "SplayTree.h"
+#include "SequenceMap.cpp"
+#include "RebaseParser.h"
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <utility>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <thread>
+using namespace std;
+
+// Benchmark suite for the search trees. For each requested key order a
+// REBASE-format dataset of the requested number of distinct keys is
+// generated (or reused, if the file is already there) and parsed, and
+// each tree type runs the same phases on it:
+//
+//   insert    every key, one at a time, in dataset order
+//   find      every key, in random order
+//   zipf_find as many lookups again, drawn from a Zipf distribution:
+//             the key of popularity rank r is asked in proportion to
+//             1 / r^ZIPF_EXPONENT, the ranks scattered over the keys
+//   range     up to RANGE_QUERIES scans of RANGE_ITEMS keys from a random key
+//   remove    every key, in another random order
+//   bulk_load every key as one batch, into an empty tree
+//   reinsert  every SET_STRIDE-th key, one at a time, into the full tree
+//   union, intersect, difference
+//             the full tree combined with a tree of every SET_STRIDE-th
+//             key, as one call on all hardware threads; ops are the keys
+//             of the smaller tree, so they compare with reinsert
+//
+// A phase is skipped for a tree type without the operation. Each phase
+// reports ns/op, ops/s, latency percentiles from timing single
+// operations (0 for bulk_load, which is one call), and the peak
+// resident set size since the tree type started. Results go to stdout
+// as a table and, on request, to JSON or CSV files with one record per
+// tree type and phase, in a fixed order, so runs from two builds can be
+// diffed.
+//
+// With --zipf-queries, writes a query file for TestTrees and QueryTrees
+// instead: count lines drawn the same way from the recognition
+// sequences of a REBASE file.
+//
+// Key orders:
+//   random    keys scattered over the key space, in no order
+//   sorted    keys in increasing order
+//   reverse   keys in decreasing order
+//   clustered runs of CLUSTER_KEYS adjacent keys, the runs scattered
+
+enum {
+    KEY_SYMBOLS = 16,           // 2 bits each, so 2^32 possible keys
+    CLUSTER_KEYS = 1024,
+    RANGE_QUERIES = 100000,
+    RANGE_ITEMS = 100,
+    MAX_SAMPLES = 1 << 20,      // Phases longer than this time every k-th op
+    SET_STRIDE = 16,            // The smaller tree of a set operation
+    UNBALANCED_LIMIT = 1 << 15  // Largest sorted input given to an unbalanced tree
+};
+
+const char *ORDERS[] = { "random", "sorted", "reverse", "clustered" };
+
+// With exponent 1, the 100 most popular of 10^6 keys draw about a third
+// of the lookups
+const double ZIPF_EXPONENT = 1.0;
+
+// Draws popularity ranks in [0, n), rank r with probability
+// proportional to 1 / (r + 1)^exponent, by binary search of the
+// cumulative distribution
+class ZipfSampler {
+  public:
+    ZipfSampler(size_t n, double exponent) : cdf_(n) {
+        double sum = 0;
+        for (size_t r = 0; r < n; r++) cdf_[r] = sum += pow(r + 1.0, -exponent);
+        for (size_t r = 0; r < n; r++) cdf_[r] /= sum;
+    }
+
+    size_t operator()(mt19937_64 &random) const {
+        double u = uniform_real_distribution<double>(0.0, 1.0)(random);
+        return min(size_t(lower_bound(cdf_.begin(), cdf_.end(), u) - cdf_.begin()), cdf_.size() - 1);
+    }
+
+  private:
+    vector<double> cdf_;
+};
+
+// count draws from keys, where the popularity ranks are a random
+// permutation of keys, so that popular keys are not neighbours
+vector<SequenceMap> ZipfQueries(const vector<SequenceMap> &keys, size_t count, double exponent, mt19937_64 &random) {
+    vector<size_t> by_rank(keys.size());
+    for (size_t i = 0; i < by_rank.size(); i++) by_rank[i] = i;
+    shuffle(by_rank.begin(), by_rank.end(), random);
+    ZipfSampler sampler(keys.size(), exponent);
+    vector<SequenceMap> queries;
+    queries.reserve(count);
+    for (size_t i = 0; i < count; i++) queries.push_back(keys[by_rank[sampler(random)]]);
+    return queries;
+}
+
+// Write count Zipf-distributed queries, one recognition sequence per
+// line, drawn from the distinct sequences of db_filename
+int WriteZipfQueries(const string &db_filename, const string &query_filename, size_t count, double exponent) {
+    vector<SequenceMap> keys;
+    ParseRebaseFile(db_filename, [&keys](const char *, size_t, const char *sequence, size_t sequence_length) {
+        keys.push_back(SequenceMap(string(sequence, sequence_length), ""));
+    });
+    sort(keys.begin(), keys.end());
+    keys.erase(unique(keys.begin(), keys.end(), [](const SequenceMap &a, const SequenceMap &b) {
+        return !(a < b) && !(b < a);
+    }), keys.end());
+    if (keys.empty()) {
+        cout << "No sequences in " << db_filename << endl;
+        return 1;
+    }
+    FILE *out = fopen(query_filename.c_str(), "w");
+    if (out == nullptr) {
+        cout << "Cannot write " << query_filename << endl;
+        return 1;
+    }
+    mt19937_64 random(1);
+    vector<SequenceMap> queries = ZipfQueries(keys, count, exponent, random);
+    for (size_t i = 0; i < queries.size(); i++) fprintf(out, "%s\n", queries[i].getRecognitionSequence().c_str());
+    fclose(out);
+    cout << "Wrote " << count << " queries over " << keys.size() << " sequences to " << query_filename << endl;
+    return 0;
+}
+
+// A bijection on the low bits bits of x: multiplying by an odd number
+// and xoring in the high half are each invertible modulo 2^bits
+uint32_t Scramble(uint32_t x, int bits) {
+    uint32_t mask = bits == 32 ? 0xffffffffu : (1u << bits) - 1;
+    for (int round = 0; round < 3; round++) {
+        x = (x * 0x9e3779b1u) & mask;
+        x ^= x >> (bits / 2 + 1);
+    }
+    return x;
+}
+
+// The code of key i of count in the given order; distinct i give
+// distinct codes, and the key of code c sorts where c does
+uint32_t KeyCode(const string &order, size_t i, size_t count) {
+    uint32_t step = static_cast<uint32_t>((uint64_t(1) << 32) / count);
+    if (order == "sorted") return static_cast<uint32_t>(i) * step;
+    if (order == "reverse") return static_cast<uint32_t>(count - 1 - i) * step;
+    if (order == "clustered")
+        return Scramble(static_cast<uint32_t>(i / CLUSTER_KEYS), 22) << 10 | (i % CLUSTER_KEYS);
+    return Scramble(static_cast<uint32_t>(i), 32);
+}
+
+// Write a REBASE-format file with one enzyme and one sequence per key
+void WriteDataset(const string &filename, const string &order, size_t count) {
+    FILE *out = fopen(filename.c_str(), "w");
+    if (out == nullptr) {
+        cout << "Cannot write " << filename << endl;
+        exit(1);
+    }
+    for (int i = 0; i < REBASE_HEADER_LINES; i++)
+        fputs(" \n", out);
+    char sequence[KEY_SYMBOLS + 1];
+    sequence[KEY_SYMBOLS] = '\0';
+    for (size_t i = 0; i < count; i++) {
+        uint32_t code = KeyCode(order, i, count);
+        for (int j = KEY_SYMBOLS - 1; j >= 0; j--, code >>= 2)
+            sequence[j] = "ACGT"[code & 3];
+        fprintf(out, "Bench%zu/%s//\n", i, sequence);
+    }
+    fclose(out);
+}
+
+// The parsed dataset and the queries every tree type runs
+struct Dataset {
+    string order;
+    vector<SequenceMap> items;      // In file order
+    vector<SequenceMap> finds;      // Every key, shuffled
+    vector<SequenceMap> zipf_finds; // As many keys, Zipf-distributed
+    vector<SequenceMap> removes;    // Every key, shuffled again
+    vector<pair<SequenceMap, SequenceMap> > ranges;
+};
+
+void LoadDataset(const string &order, size_t count, Dataset &data) {
+    string filename = "bench_" + order + "_" + to_string(count) + ".txt";
+    MappedFile existing(filename);
+    if (!existing.isOpen()) {
+        cout << "Writing " << count << " " << order << " keys to " << filename << endl;
+        WriteDataset(filename, order, count);
+    }
+    data.order = order;
+    ReadRebaseFile(filename, data.items);
+
+    data.finds.clear();
+    for (size_t i = 0; i < data.items.size(); i++)
+        data.finds.push_back(SequenceMap(data.items[i].getRecognitionSequence(), ""));
+    mt19937_64 random(1);
+    data.removes = data.finds;
+    shuffle(data.finds.begin(), data.finds.end(), random);
+    shuffle(data.removes.begin(), data.removes.end(), random);
+    data.zipf_finds = ZipfQueries(data.finds, data.finds.size(), ZIPF_EXPONENT, random);
+
+    vector<SequenceMap> sorted = data.finds;
+    sort(sorted.begin(), sorted.end());
+    data.ranges.clear();
+    for (size_t q = 0; q < RANGE_QUERIES && sorted.size() > 1; q++) {
+        size_t j = random() % (sorted.size() - 1);
+        size_t last = min(j + RANGE_ITEMS + 1, sorted.size() - 1);
+        data.ranges.push_back(make_pair(sorted[j], sorted[last]));
+    }
+}
+
+// Resident set size figures from /proc/self/status, in kB
+long ReadStatusKb(const char *field) {
+    ifstream status("/proc/self/status");
+    string line;
+    size_t length = strlen(field);
+    while (getline(status, line))
+        if (line.compare(0, length, field) == 0) return atol(line.c_str() + length + 1);
+    return -1;
+}
+
+// Writing 5 to clear_refs resets the kernel's peak RSS to the current RSS
+void ResetPeakRss() {
+    ofstream clear_refs("/proc/self/clear_refs");
+    clear_refs << "5" << endl;
+}
+
+// One tree type's run of one phase
+struct PhaseResult {
+    string order;
+    string tree;
+    string phase;
+    size_t ops;
+    double seconds;
+    double percentiles[5];      // p50, p90, p99, p99.9 and max, in ns
+    long peak_rss_kb;
+};
+
+const char *PERCENTILE_NAMES[] = { "p50_ns", "p90_ns", "p99_ns", "p999_ns", "max_ns" };
+const double PERCENTILES[] = { 0.5, 0.9, 0.99, 0.999, 1.0 };
+
+// Cost of reading the clock, taken off every timed operation
+double ClockOverheadNs() {
+    vector<double> gaps;
+    for (int i = 0; i < 1000; i++) {
+        chrono::steady_clock::time_point a = chrono::steady_clock::now();
+        chrono::steady_clock::time_point b = chrono::steady_clock::now();
+        gaps.push_back(chrono::duration<double, nano>(b - a).count());
+    }
+    nth_element(gaps.begin(), gaps.begin() + gaps.size() / 2, gaps.end());
+    return gaps[gaps.size() / 2];
+}
+
+const double clock_overhead_ns = ClockOverheadNs();
+
+// Run op( i ) for i in [0, count), timing every stride-th call on its own
+template <typename Op>
+PhaseResult TimePhase(const string &phase, size_t count, Op op) {
+    PhaseResult result = PhaseResult();
+    result.phase = phase;
+    result.ops = count;
+    size_t stride = count / MAX_SAMPLES + 1;
+    vector<double> samples;
+    samples.reserve(count / stride + 1);
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (size_t i = 0; i < count; i++) {
+        if (i % stride != 0) {
+            op(i);
+            continue;
+        }
+        chrono::steady_clock::time_point before = chrono::steady_clock::now();
+        op(i);
+        double ns = chrono::duration<double, nano>(chrono::steady_clock::now() - before).count();
+        samples.push_back(max(0.0, ns - clock_overhead_ns));
+    }
+    double ns = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+    result.seconds = max(0.0, ns - samples.size() * clock_overhead_ns) / 1e9;
+
+    sort(samples.begin(), samples.end());
+    for (int p = 0; p < 5 && !samples.empty(); p++)
+        result.percentiles[p] = samples[min(samples.size() - 1, size_t(PERCENTILES[p] * samples.size()))];
+    result.peak_rss_kb = ReadStatusKb("VmHWM:");
+    return result;
+}
+
+// Phases that only some tree types support; the int overload is chosen
+// when the operation compiles, the long one otherwise
+template <typename Tree>
+auto InsertPhase(Tree &tree, const Dataset &data, vector<PhaseResult> &results, int)
+        -> decltype(tree.insert(data.items[0]), bool()) {
+    results.push_back(TimePhase("insert", data.items.size(), [&](size_t i) { tree.insert(data.items[i]); }));
+    return true;
+}
+
+template <typename Tree>
+bool InsertPhase(Tree &, const Dataset &, vector<PhaseResult> &, long) {
+    return false;
+}
+
+// Range scans visit every item; a lambda cannot appear in decltype
+struct VisitAll {
+    bool operator()(const SequenceMap &) const { return true; }
+};
+
+template <typename Tree>
+auto RangePhase(const Tree &tree, const Dataset &data, vector<PhaseResult> &results, int)
+        -> decltype(tree.for_each_in_range(data.items[0], data.items[0], VisitAll()), void()) {
+    results.push_back(TimePhase("range", data.ranges.size(), [&](size_t i) {
+        tree.for_each_in_range(data.ranges[i].first, data.ranges[i].second, VisitAll(), RANGE_ITEMS);
+    }));
+}
+
+template <typename Tree>
+void RangePhase(const Tree &, const Dataset &, vector<PhaseResult> &, long) {
+}
+
+template <typename Tree>
+auto RemovePhase(Tree &tree, const Dataset &data, vector<PhaseResult> &results, int)
+        -> decltype(tree.remove(data.removes[0]), void()) {
+    results.push_back(TimePhase("remove", data.removes.size(), [&](size_t i) { tree.remove(data.removes[i]); }));
+}
+
+template <typename Tree>
+void RemovePhase(Tree &, const Dataset &, vector<PhaseResult> &, long) {
+}
+
+template <typename Tree>
+void BulkLoad(Tree &tree, const vector<SequenceMap> &items) {
+    tree.bulkLoad(items);
+}
+
+// A frozen tree is built from a bulk-loaded AvlTree
+void BulkLoad(FrozenTree<SequenceMap> &tree, const vector<SequenceMap> &items) {
+    AvlTree<SequenceMap> a_tree;
+    a_tree.bulkLoad(items);
+    tree = a_tree.freeze();
+}
+
+// Not const: a splay tree restructures itself on every lookup
+template <typename Tree>
+void FindPhase(Tree &tree, const string &phase, const vector<SequenceMap> &finds, vector<PhaseResult> &results) {
+    size_t found = 0;
+    results.push_back(TimePhase(phase, finds.size(), [&](size_t i) {
+        if (tree.find(finds[i]) != nullptr) found++;
+    }));
+    if (found != finds.size())
+        cout << "Warning: " << finds.size() - found << " keys not found" << endl;
+}
+
+template <typename Tree>
+void FindPhases(Tree &tree, const Dataset &data, vector<PhaseResult> &results) {
+    FindPhase(tree, "find", data.finds, results);
+    FindPhase(tree, "zipf_find", data.zipf_finds, results);
+}
+
+// One timed call that stands for ops operations; there are no per-op latencies
+template <typename Op>
+void TimeBatch(const string &phase, size_t ops, Op op, vector<PhaseResult> &results) {
+    results.push_back(TimePhase(phase, 1, op));
+    results.back().ops = ops;
+    fill(results.back().percentiles, results.back().percentiles + 5, 0.0);
+}
+
+// Each phase combines a fresh copy of tree, made outside the timing
+template <typename Tree>
+auto SetPhases(const Tree &tree, const Dataset &data, vector<PhaseResult> &results, int)
+        -> decltype(Tree().unionWith(Tree(), 1), void()) {
+    vector<SequenceMap> subset;
+    for (size_t i = 0; i < data.items.size(); i += SET_STRIDE) subset.push_back(data.items[i]);
+    size_t threads = max(1u, thread::hardware_concurrency());
+    const char *phases[] = { "reinsert", "union", "intersect", "difference" };
+    for (int p = 0; p < 4; p++) {
+        Tree all = tree;
+        Tree some;
+        BulkLoad(some, subset);
+        TimeBatch(phases[p], subset.size(), [&](size_t) {
+            if (p == 0) {
+                for (size_t i = 0; i < subset.size(); i++) all.insert(subset[i]);
+            } else if (p == 1) {
+                all.unionWith(std::move(some), threads);
+            } else if (p == 2) {
+                all.intersectionWith(std::move(some), threads);
+            } else {
+                all.differenceWith(std::move(some), threads);
+            }
+        }, results);
+    }
+}
+
+template <typename Tree>
+void SetPhases(const Tree &, const Dataset &, vector<PhaseResult> &, long) {
+}
+
+template <typename Tree>
+void BenchTree(const Dataset &data, vector<PhaseResult> &results) {
+    Tree tree;
+    bool inserted = InsertPhase(tree, data, results, 0);
+    if (inserted) {
+        FindPhases(tree, data, results);
+        RangePhase(tree, data, results, 0);
+        RemovePhase(tree, data, results, 0);
+    }
+
+    Tree bulk_tree;
+    TimeBatch("bulk_load", data.items.size(), [&](size_t) { BulkLoad(bulk_tree, data.items); }, results);
+    if (!inserted) {
+        FindPhases(bulk_tree, data, results);
+        RangePhase(bulk_tree, data, results, 0);
+    }
+    SetPhases(bulk_tree, data, results, 0);
+}
+
+// A splay tree that only splays deep items, default-constructible for BenchTree
+struct SemiSplayTree : SplayTree<SequenceMap> {
+    SemiSplayTree() : SplayTree<SequenceMap>(SEMI_SPLAY) {}
+};
+
+// Every tree type the suite knows; a new type needs one line here.
+// An unbalanced tree fed sorted keys degenerates to a list, so it is
+// skipped for those orders past UNBALANCED_LIMIT keys.
+struct TreeType {
+    const char *name;
+    void (*run)(const Dataset &, vector<PhaseResult> &);
+    bool balanced;
+};
+
+const TreeType TREE_TYPES[] = {
+    { "BST", BenchTree<BinarySearchTree<SequenceMap> >, false },
+    { "AVL", BenchTree<AvlTree<SequenceMap> >, true },
+    { "BTREE", BenchTree<BPlusTree<SequenceMap> >, true },
+    { "FROZEN", BenchTree<FrozenTree<SequenceMap> >, true },
+    { "TRIE", BenchTree<RadixTrie<SequenceMap> >, true },
+    { "HASH", BenchTree<SequenceHashMap<SequenceMap> >, true },
+    { "SPLAY", BenchTree<SplayTree<SequenceMap> >, true },
+    { "SEMISPLAY", BenchTree<SemiSplayTree>, true },
+};
+
+// True if name is "all" or one of the comma-separated names in list
+bool Selected(const string &list, const string &name) {
+    if (list == "all") return true;
+    return (',' + list + ',').find(',' + name + ',') != string::npos;
+}
+
+void PrintTable(const vector<PhaseResult> &results) {
+    printf("%-9s %-9s %-10s %11s %10s %12s %9s %9s %9s %9s %11s %11s\n", "order", "tree", "phase", "ops",
+           "ns/op", "ops/s", "p50", "p90", "p99", "p99.9", "max", "peak RSS kB");
+    for (size_t i = 0; i < results.size(); i++) {
+        const PhaseResult &r = results[i];
+        printf("%-9s %-9s %-10s %11zu %10.1f %12.0f", r.order.c_str(), r.tree.c_str(), r.phase.c_str(), r.ops,
+               r.seconds * 1e9 / r.ops, r.ops / r.seconds);
+        for (int p = 0; p < 5; p++) printf(" %*.0f", p == 4 ? 11 : 9, r.percentiles[p]);
+        printf(" %11ld\n", r.peak_rss_kb);
+    }
+}
+
+void WriteJson(const string &filename, size_t keys, const vector<PhaseResult> &results) {
+    FILE *out = fopen(filename.c_str(), "w");
+    if (out == nullptr) {
+        cout << "Cannot write " << filename << endl;
+        return;
+    }
+    fprintf(out, "{\n  \"keys\": %zu,\n  \"results\": [\n", keys);
+    for (size_t i = 0; i < results.size(); i++) {
+        const PhaseResult &r = results[i];
+        fprintf(out, "    {\"order\": \"%s\", \"tree\": \"%s\", \"phase\": \"%s\", \"ops\": %zu, "
+                     "\"ns_per_op\": %.1f, \"ops_per_sec\": %.0f",
+                r.order.c_str(), r.tree.c_str(), r.phase.c_str(), r.ops, r.seconds * 1e9 / r.ops, r.ops / r.seconds);
+        for (int p = 0; p < 5; p++) fprintf(out, ", \"%s\": %.0f", PERCENTILE_NAMES[p], r.percentiles[p]);
+        fprintf(out, ", \"peak_rss_kb\": %ld}%s\n", r.peak_rss_kb, i + 1 < results.size() ? "," : "");
+    }
+    fprintf(out, "  ]\n}\n");
+    fclose(out);
+}
+
+void WriteCsv(const string &filename, size_t keys, const vector<PhaseResult> &results) {
+    FILE *out = fopen(filename.c_str(), "w");
+    if (out == nullptr) {
+        cout << "Cannot write " << filename << endl;
+        return;
+    }
+    fprintf(out, "keys,order,tree,phase,ops,ns_per_op,ops_per_sec");
+    for (int p = 0; p < 5; p++) fprintf(out, ",%s", PERCENTILE_NAMES[p]);
+    fprintf(out, ",peak_rss_kb\n");
+    for (size_t i = 0; i < results.size(); i++) {
+        const PhaseResult &r = results[i];
+        fprintf(out, "%zu,%s,%s,%s,%zu,%.1f,%.0f", keys, r.order.c_str(), r.tree.c_str(), r.phase.c_str(), r.ops,
+                r.seconds * 1e9 / r.ops, r.ops / r.seconds);
+        for (int p = 0; p < 5; p++) fprintf(out, ",%.0f", r.percentiles[p]);
+        fprintf(out, ",%ld\n", r.peak_rss_kb);
+    }
+    fclose(out);
+}
+
+int
+main(int argc, char **argv) {
+    if ((argc == 5 || argc == 6) && string(argv[1]) == "--zipf-queries")
+        return WriteZipfQueries(argv[2], argv[3], static_cast<size_t>(atof(argv[4])),
+                                argc == 6 ? atof(argv[5]) : ZIPF_EXPONENT);
+    if (argc < 3) {
+        cout << "Usage: " << argv[0] << " <keys> <random|sorted|reverse|clustered|all> [tree-types|all]"
+             << " [--json file] [--csv file]" << endl;
+        cout << "       " << argv[0] << " --zipf-queries <databasefilename> <queryfilename> <count> [exponent]" << endl;
+        cout << "       tree-types is a comma-separated list of BST, AVL, BTREE, FROZEN, TRIE, HASH, SPLAY"
+             << " and SEMISPLAY" << endl;
+        return 0;
+    }
+    // Accept 1e6 as well as 1000000
+    size_t keys = static_cast<size_t>(atof(argv[1]));
+    string orders(argv[2]);
+    string trees = argc > 3 && argv[3][0] != '-' ? argv[3] : "all";
+    string json_filename, csv_filename;
+    for (int i = 3; i + 1 < argc; i++) {
+        if (string(argv[i]) == "--json") json_filename = argv[++i];
+        else if (string(argv[i]) == "--csv") csv_filename = argv[++i];
+    }
+    if (keys < 2 || keys > (uint64_t(1) << 32) / CLUSTER_KEYS * CLUSTER_KEYS) {
+        cout << "Need between 2 and 2^32 keys" << endl;
+        return 1;
+    }
+
+    vector<PhaseResult> results;
+    for (size_t o = 0; o < sizeof(ORDERS) / sizeof(ORDERS[0]); o++) {
+        if (!Selected(orders, ORDERS[o])) continue;
+        Dataset data;
+        LoadDataset(ORDERS[o], keys, data);
+        for (size_t t = 0; t < sizeof(TREE_TYPES) / sizeof(TREE_TYPES[0]); t++) {
+            const TreeType &type = TREE_TYPES[t];
+            if (!Selected(trees, type.name)) continue;
+            if (!type.balanced && (data.order == "sorted" || data.order == "reverse") && keys > UNBALANCED_LIMIT) {
+                cout << type.name << " skipped for " << data.order << " keys: it would degenerate to a list" << endl;
+                continue;
+            }
+            ResetPeakRss();
+            size_t first = results.size();
+            type.run(data, results);
+            for (size_t i = first; i < results.size(); i++) {
+                results[i].order = data.order;
+                results[i].tree = type.name;
+            }
+        }
+    }
+    if (results.empty()) {
+        cout << "Nothing to run for " << orders << " and " << trees << endl;
+        return 1;
+    }
+    PrintTable(results);
+    if (!json_filename.empty()) WriteJson(json_filename, keys, results);
+    if (!csv_filename.empty()) WriteCsv(csv_filename, keys, results);
+    return 0;
+}
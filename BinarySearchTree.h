@@ -2,17 +2,25 @@
 #define BINARY_SEARCH_TREE_H
 
 #include "dsexceptions.h"
+#include "NodePool.h"
+#include "BatchSearch.h"
+#include "SortAndMerge.h"
+#include "TreeStats.h"
 #include <algorithm>
 #include <iostream>
+#include <iterator>
 #include <utility>
+#include <vector>
 using namespace std;       
 
 // BinarySearchTree class
 //
-// CONSTRUCTION: zero parameter
+// CONSTRUCTION: zero parameter, or a range of items to bulk-load;
+//               Stats is a TreeStats policy, NoStats by default
 //
 // ******************PUBLIC OPERATIONS*********************
 // void insert( x )       --> Insert x
+// void bulkLoad( items ) --> Insert a batch of items in linear time
 // void remove( x )       --> Remove x
 // bool contains( x )     --> Return true if x is present
 // Comparable findMin( )  --> Return smallest item
@@ -20,10 +28,21 @@ using namespace std;
 // boolean isEmpty( )     --> Return true if empty; else false
 // void makeEmpty( )      --> Remove all items
 // void printTree( )      --> Print tree in sorted order
+// size_t rank( x )       --> Return the number of items less than x
+// Comparable select( k ) --> Return the item of rank k
+// size_t count_range( lo, hi ) --> Return the number of items in ( lo, hi )
+// void find_batch( queries, found ) --> Look up sorted queries in one pass
+// pair find_count( x )   --> find, plus number of links followed
+// bool remove_count( x ) --> remove; get_remove_calls( ) returns its links
+// Stats & stats( )       --> Return the statistics policy
 // ******************ERRORS********************************
 // Throws UnderflowException as warranted
+// Throws ArrayIndexOutOfBoundsException if select( k ) has no item of rank k
+//
+// Each node stores the size of its subtree, so size, rank, select
+// and count_range cost O( 1 ) or O( height ) rather than a full walk.
 
-template <typename Comparable>
+template <typename Comparable, typename Stats = NoStats>
 class BinarySearchTree
 {
   public:
@@ -31,6 +50,15 @@ class BinarySearchTree
     {
     }
 
+    /**
+     * Bulk-load constructor
+     */
+    template <typename Iterator>
+    BinarySearchTree( Iterator first, Iterator last ) : root_{ nullptr }
+    {
+        bulkLoad( first, last );
+    }
+
     /**
      * Copy constructor
      */
@@ -42,7 +70,7 @@ class BinarySearchTree
     /**
      * Move constructor
      */
-    BinarySearchTree( BinarySearchTree && rhs ) : root_{ rhs.root_ }
+    BinarySearchTree( BinarySearchTree && rhs ) : root_{ rhs.root_ }, pool_{ std::move( rhs.pool_ ) }
     {
         rhs.root_ = nullptr;
     }
@@ -70,7 +98,8 @@ class BinarySearchTree
      */
     BinarySearchTree & operator=( BinarySearchTree && rhs )
     {
-        std::swap( root_, rhs.root_ );       
+        std::swap( root_, rhs.root_ );
+        std::swap( pool_, rhs.pool_ );       
         return *this;
     }
     
@@ -102,7 +131,7 @@ class BinarySearchTree
      */
     bool contains( const Comparable & x ) const
     {
-        return contains( x, root_ );
+        return find( x ) != nullptr;
     }
 
     /**
@@ -131,62 +160,148 @@ class BinarySearchTree
      */
     void makeEmpty( )
     {
-        makeEmpty( root_ );
+        if( !is_trivially_destructible<BinaryNode>::value )
+            makeEmpty( root_ );
+        root_ = nullptr;
+        pool_.release( );
     }
 
     /**
-     * Insert x into the tree; duplicates are ignored.
+     * Insert x into the tree, copying or moving it as passed;
+     * duplicates are merged into the item already present.
+     */
+    template <typename Item>
+    void insert( Item && x )
+    {
+        typename Stats::Probe probe( stats_, Stats::INSERT );
+        insert( std::forward<Item>( x ), root_, probe );
+    }
+    
+    /**
+     * Add a batch of items. The batch and the current contents are
+     * sorted and merged, and the tree is rebuilt perfectly balanced
+     * in linear time.
      */
-    void insert( const Comparable & x )
+    void bulkLoad( vector<Comparable> items )
     {
-        insert( x, root_ );
+        if( !isEmpty( ) )
+        {
+            vector<Comparable> current;
+            current.reserve( size( ) + items.size( ) );
+            inOrder( root_, [&current]( const Comparable & x ) { current.push_back( x ); } );
+            current.insert( current.end( ), make_move_iterator( items.begin( ) ),
+                            make_move_iterator( items.end( ) ) );
+            items.swap( current );
+            makeEmpty( );
+        }
+        sortAndMerge( items );
+        root_ = buildBalanced( items, 0, items.size( ) );
     }
-     
+
     /**
-     * Insert x into the tree; duplicates are ignored.
+     * Add the items in [ first, last ) as one batch.
      */
-    void insert( Comparable && x )
+    template <typename Iterator>
+    void bulkLoad( Iterator first, Iterator last )
     {
-        insert( std::move( x ), root_ );
+        bulkLoad( vector<Comparable>( first, last ) );
     }
-    
+
     /**
      * Remove x from the tree. Nothing is done if x is not found.
      */
     void remove( const Comparable & x )
     {
-        remove( x, root_ );
+        typename Stats::Probe probe( stats_, Stats::REMOVE );
+        remove( x, root_, probe );
+    }
+
+    /**
+     * Return the statistics policy, to read or reset its counts.
+     */
+    const Stats & stats( ) const
+    {
+        return stats_;
+    }
+
+    Stats & stats( )
+    {
+        return stats_;
     }
 
     // ===== USER DECLARED FUNCTIONS ======
 
     Comparable* find(const Comparable &x) {
-        int calls = 0;
-        return find(x, root_, calls);
+        typename Stats::Probe probe(stats_, Stats::FIND);
+        return find(x, root_, probe);
     }
 
     pair<Comparable*, int> find_count(const Comparable &x) {
-        int calls = 0;
-        return pair<Comparable*, int>(find(x, root_, calls), calls);
+        typename Stats::LinkProbe probe(stats_, Stats::FIND);
+        Comparable *found = find(x, root_, probe);
+        return pair<Comparable*, int>(found, probe.links());
+    }
+
+    // Read-only lookups; any number of threads may run them at once
+    // as long as no thread modifies the tree. Their probes open on the
+    // const policy, so they count but leave the policy alone
+    const Comparable* find(const Comparable &x) const {
+        typename Stats::Probe probe(stats_, Stats::FIND);
+        return find(x, root_, probe);
+    }
+
+    pair<const Comparable*, int> find_count(const Comparable &x) const {
+        typename Stats::LinkProbe probe(stats_, Stats::FIND);
+        const Comparable *found = find(x, root_, probe);
+        return pair<const Comparable*, int>(found, probe.links());
+    }
+
+    // Look up queries sorted in increasing order in one traversal
+    void find_batch(const vector<Comparable> &queries, vector<const Comparable *> &found) const {
+        findBatch(root_, queries, found);
     }
 
     bool remove_count(const Comparable &x) {
-        remove_calls = 0;
-        return remove_count(x, root_);
+        typename Stats::LinkProbe probe(stats_, Stats::REMOVE);
+        return remove(x, root_, probe);
     }
     
-    size_t size() {
-        if (isEmpty()) return 0;
-        return size(root_) + 1;
+    size_t size() const {
+        return sizeOfNode(root_);
+    }
+
+    size_t depth() const {
+        return depthSumOfNode(root_);
     }
 
-    int depth() {
-        if (isEmpty()) return 0;
-        return depth(root_, 1);
+    size_t rank(const Comparable &x) const {
+        return count_below(x, false);
     }
 
-    int get_remove_calls() {
-        return remove_calls;
+    const Comparable &select(size_t k) const {
+        if (k >= size()) throw ArrayIndexOutOfBoundsException{};
+        BinaryNode *t = root_;
+        while (true) {
+            size_t left = sizeOfNode(t->left_);
+            if (k < left) {
+                t = t->left_;
+            } else if (k == left) {
+                return t->element_;
+            } else {
+                k -= left + 1;
+                t = t->right_;
+            }
+        }
+    }
+
+    // Number of items strictly between lo and hi
+    size_t count_range(const Comparable &lo, const Comparable &hi) const {
+        if (!(lo < hi)) return 0;
+        return count_below(hi, false) - count_below(lo, true);
+    }
+
+    int get_remove_calls() const {
+        return stats_.lastLinks(Stats::REMOVE);
     }
 
     // ===== USER DECLARED FUNCTIONS END =====
@@ -197,78 +312,53 @@ class BinarySearchTree
         Comparable element_;
         BinaryNode *left_;
         BinaryNode *right_;
+        size_t size_;           // Items in this subtree
+        size_t depthSum_;       // depth( ) of this subtree
 
         BinaryNode( const Comparable & the_element, BinaryNode *lt, BinaryNode *rt )
-          : element_{ the_element }, left_{ lt }, right_{ rt } { }
+          : element_{ the_element }, left_{ lt }, right_{ rt }, size_{ 1 }, depthSum_{ 2 } { }
         
         BinaryNode( Comparable && the_element, BinaryNode *lt, BinaryNode *rt )
-          : element_{ std::move( the_element ) }, left_{ lt }, right_{ rt } { }
+          : element_{ std::move( the_element ) }, left_{ lt }, right_{ rt },
+            size_{ 1 }, depthSum_{ 2 } { }
     };
 
     BinaryNode *root_;
+    NodePool<BinaryNode> pool_;
+    vector<BinaryNode **> path_;    // Links walked by the last insert or remove
 
-    // USER VARS
-    int remove_calls;
+    Stats stats_;
 
     // ====== USER DECLARED FUNCTIONS =====
 
-    Comparable* find(const Comparable &x, BinaryNode *t, int &calls) {
-        if (t == nullptr) {
-            return nullptr;
-        } else if(x < t->element_) {
-            calls++;
-            return find(x, t->left_, calls);
-        } else if (t->element_ < x) {
-            calls++;
-            return find(x, t->right_, calls);
-        } else {
-            return &(t->element_);
-        }
-    }
-
-    bool remove_count( const Comparable & x, BinaryNode * & t )
-    {
-        if( t == nullptr )
-            return false;   // Item not found; do nothing
-        if( x < t->element_ ) {
-            remove_calls++;
-            remove_count( x, t->left_ );
-        }
-        else if( t->element_ < x ) {
-            remove_calls++;
-            remove_count( x, t->right_ );
-        }
-        else if( t->left_ != nullptr && t->right_ != nullptr ) // Two children
-        {
-            t->element_ = findMin( t->right_ )->element_;
-            remove_calls++;
-            remove( t->element_, t->right_ );
-        }
-        else
-        {
-            BinaryNode *oldNode = t;
-            t = ( t->left_ != nullptr ) ? t->left_ : t->right_;
-            delete oldNode;
+    template <typename Probe>
+    Comparable* find(const Comparable &x, BinaryNode *t, Probe &probe) const {
+        while (t != nullptr) {
+            if (probe.less(x, t->element_)) {
+                t = t->left_;
+            } else if (probe.less(t->element_, x)) {
+                t = t->right_;
+            } else {
+                return &(t->element_);
+            }
+            probe.follow();
         }
-        return false;
-    }
-
-    size_t size(BinaryNode *t) {
-        if (t == nullptr) return 0;
-        size_t left = 0, right = 0;
-        if (t->left_ != nullptr)
-            left = size(t->left_) + 1;
-        if (t->right_ != nullptr)
-            right = size(t->right_) + 1;
-        return left + right;
+        return nullptr;
     }
 
-    int depth(BinaryNode *t, int d) {
-        if (t == nullptr) return 0;
-        if (t->left_ == nullptr && t->right_ == nullptr) {
-            return d + 1;
+    // Number of items less than x, or not greater than x if inclusive
+    size_t count_below(const Comparable &x, bool inclusive) const {
+        size_t below = 0;
+        BinaryNode *t = root_;
+        while (t != nullptr) {
+            if (t->element_ < x || (inclusive && !(x < t->element_))) {
+                below += sizeOfNode(t->left_) + 1;
+                t = t->right_;
+            } else {
+                t = t->left_;
+            }
         }
-        return d + depth(t->left_, d + 1) + depth(t->right_, d + 1);
+        return below;
     }
 
     // ====== USER DECLARED FUNCTIONS END =====
@@ -276,65 +366,140 @@ class BinarySearchTree
 
     /**
      * Internal method to insert into a subtree.
-     * x is the item to insert.
-     * t is the node that root_s the subtree.
-     * Set the new root of the subtree.
-     */
-    void insert( const Comparable & x, BinaryNode * & t )
-    {
-        if( t == nullptr )
-            t = new BinaryNode{ x, nullptr, nullptr };
-        else if( x < t->element_ )
-            insert( x, t->left_ );
-        else if( t->element_ < x )
-            insert( x, t->right_ );
-        else
-            t->element_.merge(x);  // Duplicate; do nothing
-    }
-    
-    /**
-     * Internal method to insert into a subtree.
-     * x is the item to insert.
+     * x is the item to insert, copied or moved as passed.
      * t is the node that roots the subtree.
      * Set the new root of the subtree.
      */
-    void insert( Comparable && x, BinaryNode * & t )
-    {
-        if( t == nullptr )
-            t = new BinaryNode{ std::move( x ), nullptr, nullptr };
-        else if( x < t->element_ )
-            insert( std::move( x ), t->left_ );
-        else if( t->element_ < x )
-            insert( std::move( x ), t->right_ );
-        else
-            t->element_.merge(x);  // Duplicate; do nothing
+    template <typename Item>
+    void insert( Item && x, BinaryNode * & t, typename Stats::Probe & probe )
+    {
+        path_.clear( );
+        BinaryNode **link = &t;
+        while( *link != nullptr )
+        {
+            path_.push_back( link );
+            if( probe.less( x, ( *link )->element_ ) )
+                link = &( *link )->left_;
+            else if( probe.less( ( *link )->element_, x ) )
+                link = &( *link )->right_;
+            else
+            {
+                ( *link )->element_.merge( x );
+                return;
+            }
+            probe.follow( );
+        }
+        *link = pool_.allocate( std::forward<Item>( x ), nullptr, nullptr );
+        probe.allocate( );
+        updatePath( );
     }
 
     /**
      * Internal method to remove from a subtree.
      * x is the item to remove.
      * t is the node that roots the subtree.
-     * Set the new root of the subtree.
+     * probe counts the links followed to x, plus one for the step to
+     * the right subtree when x has two children.
+     * Set the new root of the subtree; return true if x was removed.
      */
-    void remove( const Comparable & x, BinaryNode * & t )
-    {
-        if( t == nullptr )
-            return;   // Item not found; do nothing
-        if( x < t->element_ )
-            remove( x, t->left_ );
-        else if( t->element_ < x )
-            remove( x, t->right_ );
-        else if( t->left_ != nullptr && t->right_ != nullptr ) // Two children
+    template <typename Probe>
+    bool remove( const Comparable & x, BinaryNode * & t, Probe & probe )
+    {
+        path_.clear( );
+        BinaryNode **link = &t;
+        while( *link != nullptr )
         {
-            t->element_ = findMin( t->right_ )->element_;
-            remove( t->element_, t->right_ );
+            if( probe.less( x, ( *link )->element_ ) )
+            {
+                path_.push_back( link );
+                link = &( *link )->left_;
+            }
+            else if( probe.less( ( *link )->element_, x ) )
+            {
+                path_.push_back( link );
+                link = &( *link )->right_;
+            }
+            else
+                break;
+            probe.follow( );
         }
-        else
+        if( *link == nullptr )
+            return false;   // Item not found; do nothing
+
+        BinaryNode *oldNode = *link;
+        if( oldNode->left_ != nullptr && oldNode->right_ != nullptr ) // Two children
         {
-            BinaryNode *oldNode = t;
-            t = ( t->left_ != nullptr ) ? t->left_ : t->right_;
-            delete oldNode;
+            // Move the successor's item up and unlink the successor instead
+            probe.follow( );
+            path_.push_back( link );
+            link = &oldNode->right_;
+            while( ( *link )->left_ != nullptr )
+            {
+                path_.push_back( link );
+                link = &( *link )->left_;
+            }
+            BinaryNode *successor = *link;
+            oldNode->element_ = std::move( successor->element_ );
+            oldNode = successor;
         }
+        *link = ( oldNode->left_ != nullptr ) ? oldNode->left_ : oldNode->right_;
+        pool_.deallocate( oldNode );
+        updatePath( );
+        return true;
+    }
+
+    /**
+     * Refresh the counts of the subtrees in path_, bottom-up.
+     */
+    void updatePath( )
+    {
+        for( size_t i = path_.size( ); i > 0; --i )
+            updateCounts( *path_[ i - 1 ] );
+    }
+
+    /**
+     * Return the number of items in subtree t.
+     */
+    size_t sizeOfNode( BinaryNode *t ) const
+    {
+        return t == nullptr ? 0 : t->size_;
+    }
+
+    /**
+     * Return depth( ) of subtree t: the sum of its node depths, with
+     * t at depth 1 and each leaf counted once more.
+     */
+    size_t depthSumOfNode( BinaryNode *t ) const
+    {
+        return t == nullptr ? 0 : t->depthSum_;
+    }
+
+    /**
+     * Recompute the counts of t from those of its children.
+     * Every node below t is one level deeper in t than in its child.
+     */
+    void updateCounts( BinaryNode *t )
+    {
+        t->size_ = sizeOfNode( t->left_ ) + sizeOfNode( t->right_ ) + 1;
+        t->depthSum_ = depthSumOfNode( t->left_ ) + depthSumOfNode( t->right_ ) + t->size_
+                       + ( t->size_ == 1 ? 1 : 0 );
+    }
+
+    /**
+     * Internal method to build a perfectly balanced subtree from the
+     * sorted items[ lo, hi ), moving each item into its node.
+     * The recursion is only log2( hi - lo ) deep.
+     */
+    BinaryNode * buildBalanced( vector<Comparable> & items, size_t lo, size_t hi )
+    {
+        if( lo == hi )
+            return nullptr;
+        size_t mid = lo + ( hi - lo ) / 2;
+        BinaryNode *lt = buildBalanced( items, lo, mid );
+        BinaryNode *rt = buildBalanced( items, mid + 1, hi );
+        BinaryNode *t = pool_.allocate( std::move( items[ mid ] ), lt, rt );
+        updateCounts( t );
+        return t;
     }
 
     /**
@@ -343,11 +508,10 @@ class BinarySearchTree
      */
     BinaryNode * findMin( BinaryNode *t ) const
     {
-        if( t == nullptr )
-            return nullptr;
-        if( t->left_ == nullptr )
-            return t;
-        return findMin( t->left_ );
+        if( t != nullptr )
+            while( t->left_ != nullptr )
+                t = t->left_;
+        return t;
     }
 
     /**
@@ -364,48 +528,50 @@ class BinarySearchTree
 
 
     /**
-     * Internal method to test if an item is in a subtree.
-     * x is item to search for.
-     * t is the node that roots the subtree.
+     * Internal method to make subtree empty.
+     * Rotating each left child up flattens the tree into a right
+     * spine that is then destroyed front to back, without a stack.
      */
-    bool contains( const Comparable & x, BinaryNode *t ) const
-    {
-        if( t == nullptr )
-            return false;
-        else if( x < t->element_ )
-            return contains( x, t->left_ );
-        else if( t->element_ < x )
-            return contains( x, t->right_ );
-        else
-            return true;    // Match
-    }
-/****** NONRECURSIVE VERSION*************************
-    bool contains( const Comparable & x, BinaryNode *t ) const
+    void makeEmpty( BinaryNode * & t )
     {
         while( t != nullptr )
-            if( x < t->element_ )
-                t = t->left_;
-            else if( t->element_ < x )
-                t = t->right_;
+        {
+            if( t->left_ != nullptr )
+            {
+                BinaryNode *lt = t->left_;
+                t->left_ = lt->right_;
+                lt->right_ = t;
+                t = lt;
+            }
             else
-                return true;    // Match
-
-        return false;   // No match
+            {
+                BinaryNode *rt = t->right_;
+                pool_.destroy( t );
+                t = rt;
+            }
+        }
     }
-*****************************************************/
 
     /**
-     * Internal method to make subtree empty.
+     * Internal method to visit the items of subtree t in sorted order.
+     * The explicit stack grows with the height, which is unbounded here.
      */
-    void makeEmpty( BinaryNode * & t )
+    template <typename Visitor>
+    void inOrder( BinaryNode *t, Visitor visit ) const
     {
-        if( t != nullptr )
+        vector<BinaryNode *> pending;
+        while( t != nullptr || !pending.empty( ) )
         {
-            makeEmpty( t->left_ );
-            makeEmpty( t->right_ );
-            delete t;
+            while( t != nullptr )
+            {
+                pending.push_back( t );
+                t = t->left_;
+            }
+            t = pending.back( );
+            pending.pop_back( );
+            visit( t->element_ );
+            t = t->right_;
         }
-        t = nullptr;
     }
 
     /**
@@ -413,23 +579,30 @@ class BinarySearchTree
      */
     void printTree( BinaryNode *t, ostream & out ) const
     {
-        if( t != nullptr )
-        {
-            printTree( t->left_, out );
-            out << t->element_ << " ";
-            printTree( t->right_, out );
-        }
+        inOrder( t, [&out]( const Comparable & x ) { out << x << " "; } );
     }
 
     /**
      * Internal method to clone subtree.
      */
-    BinaryNode * clone( BinaryNode *t ) const
+    BinaryNode * clone( BinaryNode *t )
     {
-        if( t == nullptr )
-            return nullptr;
-        else
-            return new BinaryNode{ t->element_, clone( t->left_ ), clone( t->right_ ) };
+        BinaryNode *copy = nullptr;
+        vector<pair<BinaryNode *, BinaryNode **> > pending( 1, make_pair( t, &copy ) );
+        while( !pending.empty( ) )
+        {
+            BinaryNode *from = pending.back( ).first;
+            BinaryNode **link = pending.back( ).second;
+            pending.pop_back( );
+            if( from == nullptr )
+                continue;
+            *link = pool_.allocate( from->element_, nullptr, nullptr );
+            ( *link )->size_ = from->size_;
+            ( *link )->depthSum_ = from->depthSum_;
+            pending.push_back( make_pair( from->left_, &( *link )->left_ ) );
+            pending.push_back( make_pair( from->right_, &( *link )->right_ ) );
+        }
+        return copy;
     }
 };
 
@@ -0,0 +1,827 @@
+#ifndef CONCURRENT_AVL_TREE_H
+#define CONCURRENT_AVL_TREE_H
+
+#include "EpochReclaimer.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+using namespace std;
+
+// ConcurrentAvlTree class
+//
+// CONSTRUCTION: zero parameter
+//
+// A relaxed-balance AVL tree that any number of threads may insert
+// into, remove from and search at the same time, after Bronson, Casper,
+// Chafi and Olukotun, "A Practical Concurrent Binary Search Tree".
+//
+// Every node has its own lock and a version number. Searches take no
+// locks: they move from a node to its child optimistically and then
+// check that the node's version has not changed, which it does only
+// when a rotation moves the node down (the node "shrinks") or unlinks
+// it. A failed check retries from the last node that is still valid,
+// not from the root. Writers lock only the nodes they change: an insert
+// locks the node it hangs the new leaf from, and a rotation locks the
+// rotated node, its parent and the child that moves up. Heights are
+// repaired bottom-up after each change, one locked node at a time, so
+// the tree is strictly balanced again once updates stop.
+//
+// A removed item whose node has two children is only marked absent and
+// the node stays as a routing node; routing nodes are unlinked as soon
+// as they have fewer than two children.
+//
+// Unlinked nodes and replaced items are freed through an
+// EpochReclaimer once no thread can still be reading them.
+//
+// ******************PUBLIC OPERATIONS*********************
+// void insert( x )         --> Insert x; merge into an equal item
+// bool remove( x )         --> Remove x; return true if it was present
+// bool contains( x )       --> Return true if x is present
+// bool find( x, visit )    --> Call visit on the item equal to x, if any
+// void forEach( visit )    --> Call visit on each item in sorted order
+// size_t size( )           --> Return number of items
+// bool isValid( )          --> Check links, order and balance; quiescent only
+
+template <typename Comparable>
+class ConcurrentAvlTree
+{
+  public:
+    ConcurrentAvlTree( ) : holder_{ new Node( nullptr, nullptr ) }, size_{ 0 },
+                           retiredSinceAdvance_{ 0 }
+      { }
+
+    ConcurrentAvlTree( const ConcurrentAvlTree & rhs ) = delete;
+    ConcurrentAvlTree & operator=( const ConcurrentAvlTree & rhs ) = delete;
+
+    /**
+     * Free every node. No other thread may be using the tree.
+     */
+    ~ConcurrentAvlTree( )
+    {
+        deque<Node *> pending( 1, holder_ );
+        while( !pending.empty( ) )
+        {
+            Node *t = pending.back( );
+            pending.pop_back( );
+            if( t == nullptr )
+                continue;
+            pending.push_back( t->child_[ LEFT ].load( ) );
+            pending.push_back( t->child_[ RIGHT ].load( ) );
+            const Comparable *value = t->value_.load( );
+            if( value != t->key_ )
+                delete value;
+            delete t;
+        }
+        for( size_t i = 0; i < limbo_.size( ); ++i )
+        {
+            delete limbo_[ i ].node;
+            delete limbo_[ i ].value;
+        }
+    }
+
+    size_t size( ) const
+    {
+        return size_.load( memory_order_relaxed );
+    }
+
+    bool isEmpty( ) const
+    {
+        return size( ) == 0;
+    }
+
+    bool contains( const Comparable & x ) const
+    {
+        return find( x, [ ]( const Comparable & ) { } );
+    }
+
+    /**
+     * Call visit on the item equal to x and return true, or return
+     * false if there is none. The item is immutable and stays valid
+     * for the duration of the call, whatever other threads do.
+     */
+    template <typename Visitor>
+    bool find( const Comparable & x, Visitor visit ) const
+    {
+        EpochReclaimer::Guard guard( reclaimer_ );
+        const Comparable *result;
+        while( !attemptFind( x, holder_, RIGHT, holder_->version_.load( ), result ) )
+            ;
+        if( result == nullptr )
+            return false;
+        visit( *result );
+        return true;
+    }
+
+    /**
+     * Insert x; an equal item absorbs x through merge.
+     */
+    void insert( const Comparable & x )
+    {
+        EpochReclaimer::Guard guard( reclaimer_ );
+        bool added = false;
+        while( !attemptInsert( x, holder_, RIGHT, holder_->version_.load( ), added ) )
+            ;
+        if( added )
+            size_.fetch_add( 1, memory_order_relaxed );
+    }
+
+    /**
+     * Remove x. Return false if x is not present.
+     */
+    bool remove( const Comparable & x )
+    {
+        EpochReclaimer::Guard guard( reclaimer_ );
+        bool removed = false;
+        while( !attemptRemove( x, holder_, RIGHT, holder_->version_.load( ), removed ) )
+            ;
+        if( removed )
+            size_.fetch_sub( 1, memory_order_relaxed );
+        return removed;
+    }
+
+    /**
+     * Call visit on each item in sorted order. Items inserted or
+     * removed during the walk may or may not be seen.
+     */
+    template <typename Visitor>
+    void forEach( Visitor visit ) const
+    {
+        EpochReclaimer::Guard guard( reclaimer_ );
+        inOrder( holder_->child_[ RIGHT ].load( ), visit );
+    }
+
+    /**
+     * Check parent links, key order, stored heights, AVL balance, that
+     * no routing node has fewer than two children, and that size( )
+     * matches the items present. Only meaningful with no update in
+     * progress.
+     */
+    bool isValid( ) const
+    {
+        size_t items = 0;
+        const Comparable *last = nullptr;
+        Node *root = holder_->child_[ RIGHT ].load( );
+        return ( root == nullptr || root->parent_.load( ) == holder_ ) &&
+               checkSubtree( root, last, items ) >= 0 && items == size( );
+    }
+
+  private:
+    enum { LEFT = 0, RIGHT = 1, EQUAL = 2 };
+
+    // Version bits. Only a shrink, a rotation that moves the node down
+    // and so narrows the key range below it, invalidates a search that
+    // passed through the node; a node that moves up keeps its version.
+    static const uint64_t UNLINKED = 1;
+    static const uint64_t SHRINKING = 2;
+    static const uint64_t SHRINK_COUNT_INCR = 4;
+
+    // nodeCondition results other than a new height
+    static const int UNLINK_REQUIRED = -1;
+    static const int REBALANCE_REQUIRED = -2;
+    static const int NOTHING_REQUIRED = -3;
+
+    // Version reads to spin through before blocking on a rotating node
+    static const int SPIN_COUNT = 100;
+
+    // Retirements between epoch advances
+    static const size_t RECLAIM_INTERVAL = 64;
+
+    struct Node
+    {
+        const Comparable *key_;                 // Immutable; orders the node
+        atomic<const Comparable *> value_;      // Current item, or nullptr if absent
+        atomic<int> height_;
+        atomic<uint64_t> version_;
+        atomic<Node *> parent_;
+        atomic<Node *> child_[ 2 ];
+        mutex lock_;
+
+        // A new leaf whose item is key
+        Node( const Comparable *key, Node *parent )
+          : key_{ key }, value_{ key }, height_{ 1 }, version_{ 0 }, parent_{ parent }
+        {
+            child_[ LEFT ].store( nullptr );
+            child_[ RIGHT ].store( nullptr );
+        }
+
+        ~Node( )
+        {
+            delete key_;
+        }
+    };
+
+    // A node or a replaced item, and the epoch in which it was unlinked
+    struct Retired
+    {
+        uint64_t epoch;
+        Node *node;
+        const Comparable *value;
+    };
+
+    Node *holder_;              // Sentinel; the root is its right child
+    atomic<size_t> size_;
+    EpochReclaimer reclaimer_;
+
+    mutex limboLock_;           // Guards the fields below
+    deque<Retired> limbo_;      // Unlinked, possibly still read
+    size_t retiredSinceAdvance_;
+
+    static bool isShrinking( uint64_t version )
+    {
+        return ( version & SHRINKING ) != 0;
+    }
+
+    static bool isUnlinked( uint64_t version )
+    {
+        return version == UNLINKED;
+    }
+
+    static bool isShrinkingOrUnlinked( uint64_t version )
+    {
+        return ( version & ( SHRINKING | UNLINKED ) ) != 0;
+    }
+
+    static int height( const Node *t )
+    {
+        return t == nullptr ? 0 : t->height_.load( );
+    }
+
+    static int max( int lhs, int rhs )
+    {
+        return lhs > rhs ? lhs : rhs;
+    }
+
+    /**
+     * Return the side of t on which x belongs, or EQUAL if x matches t.
+     */
+    static int sideOf( const Comparable & x, const Node *t )
+    {
+        if( x < *t->key_ )
+            return LEFT;
+        return *t->key_ < x ? RIGHT : EQUAL;
+    }
+
+    /**
+     * Wait for the rotation that is shrinking t to finish. The rotation
+     * holds t's lock, so after a short spin block on the lock.
+     */
+    static void waitUntilShrinkCompleted( Node *t, uint64_t version )
+    {
+        if( !isShrinking( version ) )
+            return;
+        for( int i = 0; i < SPIN_COUNT; ++i )
+            if( t->version_.load( ) != version )
+                return;
+        lock_guard<mutex> guard( t->lock_ );
+    }
+
+    /**
+     * Search below node, which was reached with version nodeVersion,
+     * starting with its child on side. Return false if node has shrunk
+     * since, so the caller must retry from its own node; otherwise set
+     * result to the item equal to x, or nullptr, and return true.
+     */
+    bool attemptFind( const Comparable & x, Node *node, int side, uint64_t nodeVersion,
+                      const Comparable * & result ) const
+    {
+        while( true )
+        {
+            Node *child = node->child_[ side ].load( );
+            if( node->version_.load( ) != nodeVersion )
+                return false;
+            if( child == nullptr )
+            {
+                result = nullptr;
+                return true;
+            }
+            int childSide = sideOf( x, child );
+            if( childSide == EQUAL )
+            {
+                // Unlinking clears the item first, so a node found after
+                // it was unlinked reports x as absent
+                result = child->value_.load( );
+                return true;
+            }
+            uint64_t childVersion = child->version_.load( );
+            if( isShrinkingOrUnlinked( childVersion ) )
+                waitUntilShrinkCompleted( child, childVersion );
+            else if( child == node->child_[ side ].load( ) &&
+                     node->version_.load( ) == nodeVersion &&
+                     attemptFind( x, child, childSide, childVersion, result ) )
+                return true;
+            if( node->version_.load( ) != nodeVersion )
+                return false;
+        }
+    }
+
+    /**
+     * Insert x below node, as attemptFind searches. Set added if x
+     * became a new item rather than merging into an equal one.
+     */
+    bool attemptInsert( const Comparable & x, Node *node, int side, uint64_t nodeVersion,
+                        bool & added )
+    {
+        while( true )
+        {
+            Node *child = node->child_[ side ].load( );
+            if( node->version_.load( ) != nodeVersion )
+                return false;
+            if( child == nullptr )
+            {
+                Node *damaged;
+                {
+                    lock_guard<mutex> guard( node->lock_ );
+                    // Holding the lock, node cannot shrink any more
+                    if( node->version_.load( ) != nodeVersion )
+                        return false;
+                    if( node->child_[ side ].load( ) != nullptr )
+                        continue;       // Lost a race with another insert
+                    node->child_[ side ].store( new Node( new Comparable( x ), node ) );
+                    damaged = fixHeight( node );
+                }
+                added = true;
+                fixHeightAndRebalance( damaged );
+                return true;
+            }
+            int childSide = sideOf( x, child );
+            if( childSide == EQUAL )
+            {
+                if( insertInto( child, x, added ) )
+                    return true;
+                continue;
+            }
+            uint64_t childVersion = child->version_.load( );
+            if( isShrinkingOrUnlinked( childVersion ) )
+                waitUntilShrinkCompleted( child, childVersion );
+            else if( child == node->child_[ side ].load( ) &&
+                     node->version_.load( ) == nodeVersion &&
+                     attemptInsert( x, child, childSide, childVersion, added ) )
+                return true;
+            if( node->version_.load( ) != nodeVersion )
+                return false;
+        }
+    }
+
+    /**
+     * Store x in t, whose key equals x, merging it into the item there
+     * or reviving a routing node. Return false if t has been unlinked.
+     * Items are never changed in place, as searches may be copying
+     * them; the merged item replaces the old one, which is retired.
+     */
+    bool insertInto( Node *t, const Comparable & x, bool & added )
+    {
+        const Comparable *old;
+        {
+            lock_guard<mutex> guard( t->lock_ );
+            if( isUnlinked( t->version_.load( ) ) )
+                return false;
+            old = t->value_.load( );
+            if( old == nullptr )
+            {
+                t->value_.store( new Comparable( x ) );
+                added = true;
+                return true;
+            }
+            Comparable *merged = new Comparable( *old );
+            merged->merge( x );
+            t->value_.store( merged );
+        }
+        if( old != t->key_ )
+            retire( nullptr, old );
+        return true;
+    }
+
+    /**
+     * Remove x below node, as attemptFind searches. Set removed if x
+     * was present.
+     */
+    bool attemptRemove( const Comparable & x, Node *node, int side, uint64_t nodeVersion,
+                        bool & removed )
+    {
+        while( true )
+        {
+            Node *child = node->child_[ side ].load( );
+            if( node->version_.load( ) != nodeVersion )
+                return false;
+            if( child == nullptr )
+                return true;
+            int childSide = sideOf( x, child );
+            if( childSide == EQUAL )
+            {
+                if( removeFrom( node, child, removed ) )
+                    return true;
+                continue;
+            }
+            uint64_t childVersion = child->version_.load( );
+            if( isShrinkingOrUnlinked( childVersion ) )
+                waitUntilShrinkCompleted( child, childVersion );
+            else if( child == node->child_[ side ].load( ) &&
+                     node->version_.load( ) == nodeVersion &&
+                     attemptRemove( x, child, childSide, childVersion, removed ) )
+                return true;
+            if( node->version_.load( ) != nodeVersion )
+                return false;
+        }
+    }
+
+    /**
+     * Remove the item in t, a child of parent. A node with fewer than
+     * two children is unlinked; one with two stays as a routing node.
+     * Return false if t or parent changed underneath and the caller
+     * must search again.
+     */
+    bool removeFrom( Node *parent, Node *t, bool & removed )
+    {
+        if( t->value_.load( ) == nullptr )
+            return true;
+
+        const Comparable *old;
+        if( t->child_[ LEFT ].load( ) == nullptr || t->child_[ RIGHT ].load( ) == nullptr )
+        {
+            Node *damaged;
+            {
+                lock_guard<mutex> parentGuard( parent->lock_ );
+                if( isUnlinked( parent->version_.load( ) ) || t->parent_.load( ) != parent )
+                    return false;
+                lock_guard<mutex> guard( t->lock_ );
+                old = t->value_.load( );
+                if( old == nullptr )
+                    return true;
+                if( !attemptUnlink( parent, t ) )
+                    return false;
+                damaged = fixHeight( parent );
+            }
+            removed = true;
+            if( old != t->key_ )
+                retire( nullptr, old );
+            fixHeightAndRebalance( damaged );
+            return true;
+        }
+
+        {
+            lock_guard<mutex> guard( t->lock_ );
+            if( isUnlinked( t->version_.load( ) ) )
+                return false;
+            old = t->value_.load( );
+            if( old == nullptr )
+                return true;
+            // A child went away meanwhile; search again and unlink
+            if( t->child_[ LEFT ].load( ) == nullptr || t->child_[ RIGHT ].load( ) == nullptr )
+                return false;
+            t->value_.store( nullptr );
+        }
+        removed = true;
+        if( old != t->key_ )
+            retire( nullptr, old );
+        return true;
+    }
+
+    /**
+     * Splice t, which has at most one child, out from under parent.
+     * Both are locked. Clear t's item, but leave retiring it to the
+     * caller. Return false if t is no longer parent's child or has two
+     * children.
+     */
+    bool attemptUnlink( Node *parent, Node *t )
+    {
+        int side;
+        if( parent->child_[ LEFT ].load( ) == t )
+            side = LEFT;
+        else if( parent->child_[ RIGHT ].load( ) == t )
+            side = RIGHT;
+        else
+            return false;
+
+        Node *left = t->child_[ LEFT ].load( );
+        Node *right = t->child_[ RIGHT ].load( );
+        if( left != nullptr && right != nullptr )
+            return false;
+        Node *splice = left != nullptr ? left : right;
+
+        parent->child_[ side ].store( splice );
+        if( splice != nullptr )
+            splice->parent_.store( parent );
+        t->version_.store( UNLINKED );
+        t->value_.store( nullptr );
+        retire( t, nullptr );
+        return true;
+    }
+
+    /**
+     * Return what t needs: an unlink, a rotation, a new height, or
+     * nothing. Read without t's lock, so only a hint.
+     */
+    static int nodeCondition( Node *t )
+    {
+        Node *left = t->child_[ LEFT ].load( );
+        Node *right = t->child_[ RIGHT ].load( );
+        if( ( left == nullptr || right == nullptr ) && t->value_.load( ) == nullptr )
+            return UNLINK_REQUIRED;
+
+        int hLeft = height( left );
+        int hRight = height( right );
+        int hRepl = 1 + max( hLeft, hRight );
+        int balance = hLeft - hRight;
+        if( balance < -1 || balance > 1 )
+            return REBALANCE_REQUIRED;
+        return hRepl != t->height_.load( ) ? hRepl : NOTHING_REQUIRED;
+    }
+
+    /**
+     * Repair the height of t, which is locked. Return the next node
+     * this thread must repair: t itself if it needs more than a new
+     * height, its parent if its height changed, or nullptr.
+     */
+    static Node * fixHeight( Node *t )
+    {
+        int condition = nodeCondition( t );
+        switch( condition )
+        {
+          case UNLINK_REQUIRED:
+          case REBALANCE_REQUIRED:
+            return t;
+          case NOTHING_REQUIRED:
+            return nullptr;
+          default:
+            t->height_.store( condition );
+            return t->parent_.load( );
+        }
+    }
+
+    /**
+     * Repair t and then every node above it up to the holder, locking
+     * only the nodes each step touches. A rotation can hand back a
+     * damaged node below one whose height it also changed, so the walk
+     * does not stop at the first node that needs nothing; the nodes
+     * that are already fine cost only a few unlocked reads.
+     */
+    void fixHeightAndRebalance( Node *t )
+    {
+        while( t != nullptr && t->parent_.load( ) != nullptr )
+        {
+            int condition = nodeCondition( t );
+            Node *next = nullptr;
+            if( condition == NOTHING_REQUIRED || isUnlinked( t->version_.load( ) ) )
+                ;
+            else if( condition != UNLINK_REQUIRED && condition != REBALANCE_REQUIRED )
+            {
+                lock_guard<mutex> guard( t->lock_ );
+                next = fixHeight( t );
+            }
+            else
+            {
+                Node *parent = t->parent_.load( );
+                lock_guard<mutex> parentGuard( parent->lock_ );
+                if( !isUnlinked( parent->version_.load( ) ) && t->parent_.load( ) == parent )
+                {
+                    lock_guard<mutex> guard( t->lock_ );
+                    next = rebalance( parent, t );
+                }
+                else
+                    next = t;   // Moved meanwhile; look again
+            }
+            t = next != nullptr ? next : t->parent_.load( );
+        }
+    }
+
+    /**
+     * Unlink, rotate or fix the height of t; t and its parent are
+     * locked. Return the next node to repair, or nullptr.
+     */
+    Node * rebalance( Node *parent, Node *t )
+    {
+        Node *left = t->child_[ LEFT ].load( );
+        Node *right = t->child_[ RIGHT ].load( );
+        if( ( left == nullptr || right == nullptr ) && t->value_.load( ) == nullptr )
+            return attemptUnlink( parent, t ) ? fixHeight( parent ) : t;
+
+        int hLeft = height( left );
+        int hRight = height( right );
+        int hRepl = 1 + max( hLeft, hRight );
+        int balance = hLeft - hRight;
+        if( balance > 1 )
+            return rebalanceToward( parent, t, left, hRight, LEFT );
+        if( balance < -1 )
+            return rebalanceToward( parent, t, right, hLeft, RIGHT );
+        if( hRepl != t->height_.load( ) )
+        {
+            t->height_.store( hRepl );
+            return fixHeight( parent );
+        }
+        return nullptr;
+    }
+
+    /**
+     * t is too tall on side s, where its child is n1 and the other
+     * subtree has height hOther. Rotate n1 up, first rotating its inner
+     * grandchild up past it if that is the taller. Locks n1 and, for a
+     * double rotation, the grandchild.
+     */
+    Node * rebalanceToward( Node *parent, Node *t, Node *n1, int hOther, int s )
+    {
+        int o = 1 - s;
+        lock_guard<mutex> guard( n1->lock_ );
+        if( n1->height_.load( ) - hOther <= 1 )
+            return t;           // Changed meanwhile; look again
+
+        Node *n1Inner = n1->child_[ o ].load( );
+        int hOuter = height( n1->child_[ s ].load( ) );
+        int hInner0 = height( n1Inner );
+        if( hOuter >= hInner0 )
+            return rotate( parent, t, n1, hOther, hOuter, n1Inner, hInner0, s );
+
+        {
+            lock_guard<mutex> innerGuard( n1Inner->lock_ );
+            int hInner = n1Inner->height_.load( );
+            if( hOuter >= hInner )
+                return rotate( parent, t, n1, hOther, hOuter, n1Inner, hInner, s );
+            int hInnerOuter = height( n1Inner->child_[ s ].load( ) );
+            int balance = hOuter - hInnerOuter;
+            if( balance >= -1 && balance <= 1 )
+                return rotateTwice( parent, t, n1, hOther, hOuter, n1Inner, hInnerOuter, s );
+        }
+        // The double rotation would leave n1 unbalanced. Rotate at n1
+        // first, unless n1 is balanced and the fault is in n1Inner; its
+        // repair then comes back up through n1 and t.
+        if( n1Inner->height_.load( ) - hOuter <= 1 )
+            return n1Inner;
+        return rebalanceToward( t, n1, n1Inner, hOuter, o );
+    }
+
+    /**
+     * Single rotation moving n1, t's child on side s, up over t. All
+     * three of parent, t and n1 are locked. t shrinks, so it is marked
+     * for the duration and its version changes.
+     */
+    Node * rotate( Node *parent, Node *t, Node *n1, int hOther, int hOuter,
+                   Node *n1Inner, int hInner, int s )
+    {
+        int o = 1 - s;
+        uint64_t version = t->version_.load( );
+        int parentSide = parent->child_[ LEFT ].load( ) == t ? LEFT : RIGHT;
+
+        t->version_.store( version | SHRINKING );
+
+        t->child_[ s ].store( n1Inner );
+        if( n1Inner != nullptr )
+            n1Inner->parent_.store( t );
+        n1->child_[ o ].store( t );
+        t->parent_.store( n1 );
+        parent->child_[ parentSide ].store( n1 );
+        n1->parent_.store( parent );
+
+        int hT = 1 + max( hInner, hOther );
+        t->height_.store( hT );
+        n1->height_.store( 1 + max( hOuter, hT ) );
+
+        t->version_.store( version + SHRINK_COUNT_INCR );
+
+        // Fix whatever damage the locks held allow, deepest first
+        int balance = hInner - hOther;
+        if( balance < -1 || balance > 1 )
+            return t;
+        if( ( n1Inner == nullptr || hOther == 0 ) && t->value_.load( ) == nullptr )
+            return t;
+        balance = hOuter - hT;
+        if( balance < -1 || balance > 1 )
+            return n1;
+        if( hOuter == 0 && n1->value_.load( ) == nullptr )
+            return n1;
+        return fixHeight( parent );
+    }
+
+    /**
+     * Double rotation moving n2, the inner child of n1, up over both n1
+     * and t. parent, t, n1 and n2 are locked; t and n1 both shrink. If
+     * n1 is a routing node left with fewer than two children, it is
+     * spliced out from under n2 while the locks are still held.
+     */
+    Node * rotateTwice( Node *parent, Node *t, Node *n1, int hOther, int hOuter,
+                        Node *n2, int hInnerOuter, int s )
+    {
+        int o = 1 - s;
+        uint64_t version = t->version_.load( );
+        uint64_t n1Version = n1->version_.load( );
+        int parentSide = parent->child_[ LEFT ].load( ) == t ? LEFT : RIGHT;
+        Node *n2Outer = n2->child_[ s ].load( );
+        Node *n2Inner = n2->child_[ o ].load( );
+        int hInnerInner = height( n2Inner );
+
+        t->version_.store( version | SHRINKING );
+        n1->version_.store( n1Version | SHRINKING );
+
+        t->child_[ s ].store( n2Inner );
+        if( n2Inner != nullptr )
+            n2Inner->parent_.store( t );
+        n1->child_[ o ].store( n2Outer );
+        if( n2Outer != nullptr )
+            n2Outer->parent_.store( n1 );
+        n2->child_[ s ].store( n1 );
+        n1->parent_.store( n2 );
+        n2->child_[ o ].store( t );
+        t->parent_.store( n2 );
+        parent->child_[ parentSide ].store( n2 );
+        n2->parent_.store( parent );
+
+        int hT = 1 + max( hInnerInner, hOther );
+        t->height_.store( hT );
+        int hN1;
+        if( ( hOuter == 0 || hInnerOuter == 0 ) && n1->value_.load( ) == nullptr )
+        {
+            attemptUnlink( n2, n1 );
+            hN1 = max( hOuter, hInnerOuter );
+        }
+        else
+        {
+            hN1 = 1 + max( hOuter, hInnerOuter );
+            n1->height_.store( hN1 );
+            n1->version_.store( n1Version + SHRINK_COUNT_INCR );
+        }
+        n2->height_.store( 1 + max( hN1, hT ) );
+
+        t->version_.store( version + SHRINK_COUNT_INCR );
+
+        int balance = hInnerInner - hOther;
+        if( balance < -1 || balance > 1 )
+            return t;
+        if( ( n2Inner == nullptr || hOther == 0 ) && t->value_.load( ) == nullptr )
+            return t;
+        balance = hN1 - hT;
+        if( balance < -1 || balance > 1 )
+            return n2;
+        if( hN1 == 0 && n2->value_.load( ) == nullptr )
+            return n2;
+        return fixHeight( parent );
+    }
+
+    /**
+     * Queue a node or an item unlinked by this thread, and every
+     * RECLAIM_INTERVAL retirements start a new epoch and free whatever
+     * no pinned thread can still reach. The epoch is read after the
+     * unlink, and the queue stays in epoch order, as it is only
+     * appended to under limboLock_.
+     */
+    void retire( Node *node, const Comparable *value )
+    {
+        lock_guard<mutex> guard( limboLock_ );
+        limbo_.push_back( Retired{ reclaimer_.current( ), node, value } );
+        if( ++retiredSinceAdvance_ < RECLAIM_INTERVAL )
+            return;
+        retiredSinceAdvance_ = 0;
+        reclaimer_.advance( );
+
+        uint64_t safe = reclaimer_.safeBefore( );
+        while( !limbo_.empty( ) && limbo_.front( ).epoch < safe )
+        {
+            delete limbo_.front( ).node;
+            delete limbo_.front( ).value;
+            limbo_.pop_front( );
+        }
+    }
+
+    template <typename Visitor>
+    static void inOrder( Node *t, Visitor & visit )
+    {
+        if( t == nullptr )
+            return;
+        inOrder( t->child_[ LEFT ].load( ), visit );
+        const Comparable *value = t->value_.load( );
+        if( value != nullptr )
+            visit( *value );
+        inOrder( t->child_[ RIGHT ].load( ), visit );
+    }
+
+    /**
+     * Return the height of subtree t, or -1 if anything in it is wrong.
+     * last is the largest key seen so far in sorted order.
+     */
+    static int checkSubtree( Node *t, const Comparable * & last, size_t & items )
+    {
+        if( t == nullptr )
+            return 0;
+        Node *left = t->child_[ LEFT ].load( );
+        Node *right = t->child_[ RIGHT ].load( );
+        if( isShrinkingOrUnlinked( t->version_.load( ) ) ||
+            ( left != nullptr && left->parent_.load( ) != t ) ||
+            ( right != nullptr && right->parent_.load( ) != t ) )
+            return -1;
+        if( ( left == nullptr || right == nullptr ) && t->value_.load( ) == nullptr )
+            return -1;
+
+        int hLeft = checkSubtree( left, last, items );
+        if( hLeft < 0 || ( last != nullptr && !( *last < *t->key_ ) ) )
+            return -1;
+        last = t->key_;
+        if( t->value_.load( ) != nullptr )
+            ++items;
+        int hRight = checkSubtree( right, last, items );
+        if( hRight < 0 || hLeft - hRight > 1 || hRight - hLeft > 1 ||
+            t->height_.load( ) != 1 + max( hLeft, hRight ) )
+            return -1;
+        return 1 + max( hLeft, hRight );
+    }
+};
+
+#endif
@@ -0,0 +1,391 @@
+#ifndef COW_AVL_TREE_H
+#define COW_AVL_TREE_H
+
+#include "dsexceptions.h"
+#include "NodePool.h"
+#include "EpochReclaimer.h"
+#include "SortAndMerge.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+#include <vector>
+using namespace std;
+
+// CowAvlTree class
+//
+// CONSTRUCTION: zero parameter
+//
+// An AVL tree that serves lookups while it is being modified, without
+// readers ever taking a lock. Published nodes are never changed: a
+// writer copies the nodes on the path it modifies (and any it rotates),
+// builds the new version beside the old one, and publishes it with one
+// atomic store of the root. A reader takes a Snapshot, which pins an
+// epoch and loads the root once, and then sees that one version for as
+// long as it holds the snapshot. Replaced nodes are retired and handed
+// back to the pool once no pinned reader can still reach them.
+//
+// Writers are serialized by a mutex; they never wait for readers.
+//
+// ******************PUBLIC OPERATIONS*********************
+// void insert( x )         --> Insert x; merge into an equal item
+// bool remove( x )         --> Remove x; return true if it was present
+// void bulkLoad( items )   --> Merge in a batch of items in linear time
+// bool contains( x )       --> Return true if x is present
+// Snapshot snapshot( )     --> Pin a consistent read-only version
+// size_t size( )           --> Return number of items
+// void makeEmpty( )        --> Remove all items; no reader may be active
+// ******************SNAPSHOT OPERATIONS*******************
+// Comparable * find( x )   --> Return matching item or nullptr
+// pair find_count( x )     --> find, plus number of nodes visited
+
+template <typename Comparable>
+class CowAvlTree
+{
+  private:
+    struct AvlNode;
+
+  public:
+    /**
+     * A pinned version of the tree. Items found through it stay valid
+     * until the snapshot is destroyed, whatever writers do meanwhile.
+     */
+    class Snapshot
+    {
+      public:
+        const Comparable * find( const Comparable & x ) const
+        {
+            int calls = 0;
+            return findIn( root_, x, calls );
+        }
+
+        pair<const Comparable *, int> find_count( const Comparable & x ) const
+        {
+            int calls = 0;
+            const Comparable *result = findIn( root_, x, calls );
+            return pair<const Comparable *, int>( result, calls );
+        }
+
+      private:
+        EpochReclaimer::Guard guard_;
+        const AvlNode *root_;
+
+        // The pin comes first, so the root is loaded under it
+        explicit Snapshot( const CowAvlTree & tree )
+          : guard_{ tree.reclaimer_ }, root_{ tree.root_.load( ) }
+          { }
+
+        friend class CowAvlTree<Comparable>;
+    };
+
+    CowAvlTree( ) : root_{ nullptr }, size_{ 0 }
+      { }
+
+    CowAvlTree( const CowAvlTree & rhs ) = delete;
+    CowAvlTree & operator=( const CowAvlTree & rhs ) = delete;
+
+    ~CowAvlTree( )
+    {
+        makeEmpty( );
+    }
+
+    Snapshot snapshot( ) const
+    {
+        return Snapshot( *this );
+    }
+
+    bool contains( const Comparable & x ) const
+    {
+        return snapshot( ).find( x ) != nullptr;
+    }
+
+    size_t size( ) const
+    {
+        return size_.load( memory_order_relaxed );
+    }
+
+    bool isEmpty( ) const
+    {
+        return size( ) == 0;
+    }
+
+    /**
+     * Insert x; an equal item absorbs x through merge.
+     */
+    void insert( const Comparable & x )
+    {
+        lock_guard<mutex> guard( writeLock_ );
+        bool added = false;
+        publish( insert( root_.load( ), x, added ) );
+        if( added )
+            size_.fetch_add( 1, memory_order_relaxed );
+    }
+
+    /**
+     * Remove x. Return false, and publish nothing, if x is not present.
+     */
+    bool remove( const Comparable & x )
+    {
+        lock_guard<mutex> guard( writeLock_ );
+        bool removed = false;
+        const AvlNode *newRoot = remove( root_.load( ), x, removed );
+        if( !removed )
+            return false;
+        publish( newRoot );
+        size_.fetch_sub( 1, memory_order_relaxed );
+        return true;
+    }
+
+    /**
+     * Merge a batch of items with the current contents and publish a
+     * perfectly balanced tree built from the result. Every old node is
+     * retired.
+     */
+    void bulkLoad( vector<Comparable> items )
+    {
+        lock_guard<mutex> guard( writeLock_ );
+        const AvlNode *oldRoot = root_.load( );
+        vector<const AvlNode *> pending;
+        for( const AvlNode *t = oldRoot; t != nullptr || !pending.empty( ); t = t->right_ )
+        {
+            for( ; t != nullptr; t = t->left_ )
+                pending.push_back( t );
+            t = pending.back( );
+            pending.pop_back( );
+            items.push_back( t->element_ );
+            retired_.push_back( t );
+        }
+        sortAndMerge( items );
+        size_t count = items.size( );
+        publish( buildBalanced( items, 0, items.size( ) ) );
+        size_.store( count, memory_order_relaxed );
+    }
+
+    /**
+     * Free every node. Readers must not be active.
+     */
+    void makeEmpty( )
+    {
+        lock_guard<mutex> guard( writeLock_ );
+        if( !is_trivially_destructible<AvlNode>::value )
+        {
+            vector<const AvlNode *> pending( 1, root_.load( ) );
+            while( !pending.empty( ) )
+            {
+                const AvlNode *t = pending.back( );
+                pending.pop_back( );
+                if( t == nullptr )
+                    continue;
+                pending.push_back( t->left_ );
+                pending.push_back( t->right_ );
+                pool_.destroy( const_cast<AvlNode *>( t ) );
+            }
+            for( size_t i = 0; i < limbo_.size( ); ++i )
+                pool_.destroy( const_cast<AvlNode *>( limbo_[ i ].node ) );
+        }
+        root_.store( nullptr );
+        size_.store( 0, memory_order_relaxed );
+        limbo_.clear( );
+        pool_.release( );
+    }
+
+  private:
+    struct AvlNode
+    {
+        Comparable     element_;
+        const AvlNode *left_;
+        const AvlNode *right_;
+        int            height_;
+
+        AvlNode( const Comparable & ele, const AvlNode *lt, const AvlNode *rt )
+          : element_{ ele }, left_{ lt }, right_{ rt },
+            height_{ max( heightOfNode( lt ), heightOfNode( rt ) ) + 1 } { }
+
+        AvlNode( Comparable && ele, const AvlNode *lt, const AvlNode *rt )
+          : element_{ std::move( ele ) }, left_{ lt }, right_{ rt },
+            height_{ max( heightOfNode( lt ), heightOfNode( rt ) ) + 1 } { }
+    };
+
+    // A retired node and the epoch in which it was unlinked
+    struct Retired
+    {
+        uint64_t epoch;
+        const AvlNode *node;
+    };
+
+    atomic<const AvlNode *> root_;
+    atomic<size_t> size_;
+    EpochReclaimer reclaimer_;
+
+    // Writer state, guarded by writeLock_
+    mutex writeLock_;
+    NodePool<AvlNode> pool_;
+    vector<const AvlNode *> retired_;   // Replaced by the update in progress
+    deque<Retired> limbo_;              // Unlinked, possibly still read
+
+    static const int ALLOWED_IMBALANCE = 1;
+
+    static int heightOfNode( const AvlNode *t )
+    {
+        return t == nullptr ? -1 : t->height_;
+    }
+
+    static int max( int lhs, int rhs )
+    {
+        return lhs > rhs ? lhs : rhs;
+    }
+
+    static const Comparable * findIn( const AvlNode *t, const Comparable & x, int & calls )
+    {
+        while( t != nullptr )
+        {
+            if( x < t->element_ )
+                t = t->left_;
+            else if( t->element_ < x )
+                t = t->right_;
+            else
+                return &t->element_;
+            calls++;
+        }
+        return nullptr;
+    }
+
+    /**
+     * Make newRoot the current version. The nodes it replaced are
+     * stamped with the current epoch, the epoch advances, and every
+     * retired node older than all pinned readers returns to the pool.
+     */
+    void publish( const AvlNode *newRoot )
+    {
+        root_.store( newRoot );
+        uint64_t epoch = reclaimer_.current( );
+        for( size_t i = 0; i < retired_.size( ); ++i )
+            limbo_.push_back( Retired{ epoch, retired_[ i ] } );
+        retired_.clear( );
+        reclaimer_.advance( );
+
+        uint64_t safe = reclaimer_.safeBefore( );
+        while( !limbo_.empty( ) && limbo_.front( ).epoch < safe )
+        {
+            pool_.deallocate( const_cast<AvlNode *>( limbo_.front( ).node ) );
+            limbo_.pop_front( );
+        }
+    }
+
+    /**
+     * Return a new version of subtree t with x inserted. Nodes on the
+     * path are copied and the originals retired.
+     */
+    const AvlNode * insert( const AvlNode *t, const Comparable & x, bool & added )
+    {
+        if( t == nullptr )
+        {
+            added = true;
+            return pool_.allocate( x, nullptr, nullptr );
+        }
+        retired_.push_back( t );
+        if( x < t->element_ )
+            return balance( t->element_, insert( t->left_, x, added ), t->right_ );
+        if( t->element_ < x )
+            return balance( t->element_, t->left_, insert( t->right_, x, added ) );
+        Comparable merged = t->element_;
+        merged.merge( x );
+        return pool_.allocate( std::move( merged ), t->left_, t->right_ );
+    }
+
+    /**
+     * Return a new version of subtree t without x, or t itself, with
+     * nothing copied, if x is not present.
+     */
+    const AvlNode * remove( const AvlNode *t, const Comparable & x, bool & removed )
+    {
+        if( t == nullptr )
+            return nullptr;
+        if( x < t->element_ )
+        {
+            const AvlNode *lt = remove( t->left_, x, removed );
+            if( !removed )
+                return t;
+            retired_.push_back( t );
+            return balance( t->element_, lt, t->right_ );
+        }
+        if( t->element_ < x )
+        {
+            const AvlNode *rt = remove( t->right_, x, removed );
+            if( !removed )
+                return t;
+            retired_.push_back( t );
+            return balance( t->element_, t->left_, rt );
+        }
+
+        removed = true;
+        retired_.push_back( t );
+        if( t->left_ == nullptr )
+            return t->right_;
+        if( t->right_ == nullptr )
+            return t->left_;
+        const AvlNode *successor = t->right_;
+        while( successor->left_ != nullptr )
+            successor = successor->left_;
+        return balance( successor->element_, t->left_, removeMin( t->right_ ) );
+    }
+
+    /**
+     * Return a new version of subtree t without its smallest item.
+     */
+    const AvlNode * removeMin( const AvlNode *t )
+    {
+        retired_.push_back( t );
+        if( t->left_ == nullptr )
+            return t->right_;
+        return balance( t->element_, removeMin( t->left_ ), t->right_ );
+    }
+
+    /**
+     * Return a new node holding a copy of x over subtrees lt and rt,
+     * whose heights differ by at most two, rotating as needed. A child
+     * taken apart by a rotation is retired.
+     */
+    const AvlNode * balance( const Comparable & x, const AvlNode *lt, const AvlNode *rt )
+    {
+        if( heightOfNode( lt ) - heightOfNode( rt ) > ALLOWED_IMBALANCE )
+        {
+            retired_.push_back( lt );
+            if( heightOfNode( lt->left_ ) >= heightOfNode( lt->right_ ) )
+                return pool_.allocate( lt->element_, lt->left_,
+                                       pool_.allocate( x, lt->right_, rt ) );
+            const AvlNode *lr = lt->right_;
+            retired_.push_back( lr );
+            return pool_.allocate( lr->element_,
+                                   pool_.allocate( lt->element_, lt->left_, lr->left_ ),
+                                   pool_.allocate( x, lr->right_, rt ) );
+        }
+        if( heightOfNode( rt ) - heightOfNode( lt ) > ALLOWED_IMBALANCE )
+        {
+            retired_.push_back( rt );
+            if( heightOfNode( rt->right_ ) >= heightOfNode( rt->left_ ) )
+                return pool_.allocate( rt->element_, pool_.allocate( x, lt, rt->left_ ),
+                                       rt->right_ );
+            const AvlNode *rl = rt->left_;
+            retired_.push_back( rl );
+            return pool_.allocate( rl->element_, pool_.allocate( x, lt, rl->left_ ),
+                                   pool_.allocate( rt->element_, rl->right_, rt->right_ ) );
+        }
+        return pool_.allocate( x, lt, rt );
+    }
+
+    const AvlNode * buildBalanced( vector<Comparable> & items, size_t lo, size_t hi )
+    {
+        if( lo == hi )
+            return nullptr;
+        size_t mid = lo + ( hi - lo ) / 2;
+        const AvlNode *lt = buildBalanced( items, lo, mid );
+        const AvlNode *rt = buildBalanced( items, mid + 1, hi );
+        return pool_.allocate( std::move( items[ mid ] ), lt, rt );
+    }
+};
+
+#endif
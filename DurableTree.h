@@ -0,0 +1,506 @@
+#ifndef DURABLE_TREE_H
+#define DURABLE_TREE_H
+
+#include "dsexceptions.h"
+#include "AvlTree.h"
+#include "SequenceMap.h"
+#include "RebaseParser.h"
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+using namespace std;
+
+// DurableTree class
+//
+// CONSTRUCTION: with a state directory and optional DurabilityOptions
+//
+// An AvlTree<SequenceMap> whose mutations survive restarts. Every
+// insert and remove is appended to a write-ahead log (wal.bin) before
+// it is applied. A checkpoint writes the whole tree in sorted order to
+// snapshot.bin and empties the log. open restores the state by
+// bulk-loading the snapshot and replaying the log records that are
+// newer than it.
+//
+// Log records are buffered and written in groups (group commit), and
+// fdatasync runs once every syncEveryCommits groups, so a crash can lose
+// at most the unsynced tail of the log. A torn record at the end of the
+// log is detected by its checksum and dropped on open.
+//
+// ******************PUBLIC OPERATIONS*********************
+// bool open( )             --> Restore from snapshot + log, or reopen; false on failure
+// void insert( x )         --> Log, then insert x (merging as AvlTree does)
+// void remove( x )         --> Log, then remove x
+// void bulkLoad( items )   --> Insert items in one batch and checkpoint
+// SequenceMap * find( x )  --> Return matching item or nullptr
+// void commit( )           --> Write buffered log records
+// void sync( )             --> commit, then fdatasync the log
+// bool checkpoint( )       --> Write a snapshot and empty the log
+// ******************ERRORS********************************
+// Throws IOException if the log cannot be written
+
+struct DurabilityOptions
+{
+    size_t groupCommitRecords;      // Log records buffered per write
+    size_t syncEveryCommits;        // Writes per fdatasync; 0 leaves it to sync( )
+    size_t checkpointEveryRecords;  // Records logged between snapshots; 0 never
+
+    DurabilityOptions( )
+      : groupCommitRecords{ 64 }, syncEveryCommits{ 1 }, checkpointEveryRecords{ 1000000 }
+      { }
+};
+
+class DurableTree
+{
+  public:
+    explicit DurableTree( const string & directory,
+                          const DurabilityOptions & options = DurabilityOptions( ) )
+      : directory_{ directory }, options_( options ), logFd_{ -1 }, lsn_{ 0 },
+        pendingRecords_{ 0 }, commitsSinceSync_{ 0 }, recordsSinceCheckpoint_{ 0 },
+        replayedRecords_{ 0 }
+      { }
+
+    DurableTree( const DurableTree & rhs ) = delete;
+    DurableTree & operator=( const DurableTree & rhs ) = delete;
+
+    /**
+     * Make everything logged so far durable, then close the log.
+     */
+    ~DurableTree( )
+    {
+        if( logFd_ >= 0 )
+        {
+            try
+            {
+                sync( );
+            }
+            catch( const IOException & )
+            {
+            }
+            ::close( logFd_ );
+        }
+    }
+
+    /**
+     * Restore the tree from the snapshot and the log, then open the log
+     * for appending. Return false if the state cannot be read or the
+     * log cannot be opened. Reopening first writes out and closes the
+     * current log, so the restore sees every record applied so far.
+     */
+    bool open( )
+    {
+        if( logFd_ >= 0 )
+        {
+            bool flushed = true;
+            try
+            {
+                sync( );
+            }
+            catch( const IOException & )
+            {
+                flushed = false;
+            }
+            ::close( logFd_ );
+            logFd_ = -1;
+            logBuffer_.clear( );
+            pendingRecords_ = 0;
+            commitsSinceSync_ = 0;
+            if( !flushed )
+                return false;
+        }
+        tree_.makeEmpty( );
+        lsn_ = 0;
+        replayedRecords_ = 0;
+        if( !loadSnapshot( ) )
+            return false;
+
+        size_t validBytes = replayLog( );
+        logFd_ = ::open( logPath( ).c_str( ), O_WRONLY | O_CREAT | O_APPEND, 0644 );
+        if( logFd_ < 0 )
+            return false;
+        // Drop a torn record left by a crash in the middle of a write
+        return ftruncate( logFd_, validBytes ) == 0;
+    }
+
+    void insert( const SequenceMap & x )
+    {
+        appendRecord( INSERT_RECORD, x );
+        tree_.insert( x );
+        checkpointIfDue( );
+    }
+
+    void remove( const SequenceMap & x )
+    {
+        appendRecord( REMOVE_RECORD, x );
+        tree_.remove( x );
+        checkpointIfDue( );
+    }
+
+    /**
+     * Load a whole batch, then checkpoint instead of logging each item.
+     */
+    void bulkLoad( vector<SequenceMap> items )
+    {
+        tree_.bulkLoad( std::move( items ) );
+        if( !checkpoint( ) )
+            throw IOException{ };
+    }
+
+    SequenceMap * find( const SequenceMap & x )
+    {
+        return tree_.find( x );
+    }
+
+    size_t size( )
+    {
+        return tree_.size( );
+    }
+
+    const AvlTree<SequenceMap> & tree( ) const
+    {
+        return tree_;
+    }
+
+    /**
+     * Number of log records applied by the last open.
+     */
+    size_t replayedRecords( ) const
+    {
+        return replayedRecords_;
+    }
+
+    /**
+     * Write the buffered log records with one system call.
+     */
+    void commit( )
+    {
+        if( logBuffer_.empty( ) )
+            return;
+        writeAll( logFd_, logBuffer_ );
+        logBuffer_.clear( );
+        pendingRecords_ = 0;
+        if( options_.syncEveryCommits != 0 && ++commitsSinceSync_ >= options_.syncEveryCommits )
+            syncLog( );
+    }
+
+    void sync( )
+    {
+        commit( );
+        syncLog( );
+    }
+
+    /**
+     * Write the tree to a new snapshot, atomically replace the old one,
+     * and empty the log. Records already in the snapshot are skipped
+     * on replay, so a crash between the rename and the truncate is safe.
+     */
+    bool checkpoint( )
+    {
+        commit( );
+        string tmpPath = directory_ + "/snapshot.tmp";
+        int fd = ::open( tmpPath.c_str( ), O_WRONLY | O_CREAT | O_TRUNC, 0644 );
+        if( fd < 0 )
+            return false;
+
+        string buffer( snapshotMagic( ), MAGIC_BYTES );
+        putU64( buffer, lsn_ );
+        putU64( buffer, tree_.size( ) );
+        uint32_t checksum = FNV_OFFSET;
+        bool ok = true;
+        tree_.forEach( [&]( const SequenceMap & x ) {
+            size_t start = buffer.size( );
+            putSequenceMap( buffer, x );
+            checksum = fnv1a( checksum, buffer.data( ) + start, buffer.size( ) - start );
+            if( buffer.size( ) >= SNAPSHOT_CHUNK && ok )
+            {
+                ok = writeSome( fd, buffer );
+                buffer.clear( );
+            }
+        } );
+        putU32( buffer, checksum );
+        ok = ok && writeSome( fd, buffer ) && fdatasync( fd ) == 0;
+        ok = ( ::close( fd ) == 0 ) && ok;
+        if( !ok || rename( tmpPath.c_str( ), snapshotPath( ).c_str( ) ) != 0 )
+            return false;
+        syncDirectory( );
+
+        if( logFd_ >= 0 && ( ftruncate( logFd_, 0 ) != 0 || fdatasync( logFd_ ) != 0 ) )
+            return false;
+        recordsSinceCheckpoint_ = 0;
+        return true;
+    }
+
+  private:
+    static const size_t MAGIC_BYTES = 8;
+    static const uint8_t INSERT_RECORD = 1;
+    static const uint8_t REMOVE_RECORD = 2;
+    static const uint32_t FNV_OFFSET = 2166136261u;
+    static const size_t SNAPSHOT_CHUNK = 1 << 20;
+
+    string directory_;
+    DurabilityOptions options_;
+    AvlTree<SequenceMap> tree_;
+    int logFd_;
+    uint64_t lsn_;                  // Sequence number of the last logged record
+    string logBuffer_;
+    size_t pendingRecords_;
+    size_t commitsSinceSync_;
+    size_t recordsSinceCheckpoint_;
+    size_t replayedRecords_;
+
+    static const char * snapshotMagic( )
+    {
+        return "SEQSNAP1";
+    }
+
+    string snapshotPath( ) const
+    {
+        return directory_ + "/snapshot.bin";
+    }
+
+    string logPath( ) const
+    {
+        return directory_ + "/wal.bin";
+    }
+
+    /**
+     * Log record layout:
+     *   u32 body length, u32 checksum of body,
+     *   body = u64 lsn, u8 type, SequenceMap
+     * A SequenceMap is its sequence then its acronyms, each string
+     * stored as u32 length + bytes.
+     */
+    void appendRecord( uint8_t type, const SequenceMap & x )
+    {
+        size_t start = logBuffer_.size( );
+        putU32( logBuffer_, 0 );
+        putU32( logBuffer_, 0 );
+        putU64( logBuffer_, ++lsn_ );
+        logBuffer_.push_back( static_cast<char>( type ) );
+        if( type == INSERT_RECORD )
+            putSequenceMap( logBuffer_, x );
+        else
+        {
+            putString( logBuffer_, x.getRecognitionSequence( ) );
+            putU32( logBuffer_, 0 );
+        }
+        size_t bodyStart = start + 8;
+        uint32_t length = static_cast<uint32_t>( logBuffer_.size( ) - bodyStart );
+        uint32_t checksum = fnv1a( FNV_OFFSET, logBuffer_.data( ) + bodyStart, length );
+        memcpy( &logBuffer_[ start ], &length, 4 );
+        memcpy( &logBuffer_[ start + 4 ], &checksum, 4 );
+
+        if( ++pendingRecords_ >= options_.groupCommitRecords )
+            commit( );
+    }
+
+    /**
+     * Checkpoint once enough records have been logged. Called after the
+     * record's mutation reaches the tree, since the snapshot is stamped
+     * with the latest lsn and replaces the log.
+     */
+    void checkpointIfDue( )
+    {
+        if( options_.checkpointEveryRecords != 0 &&
+            ++recordsSinceCheckpoint_ >= options_.checkpointEveryRecords && !checkpoint( ) )
+            throw IOException{ };
+    }
+
+    bool loadSnapshot( )
+    {
+        MappedFile file( snapshotPath( ) );
+        if( !file.isOpen( ) )
+            return true;    // No snapshot yet
+        const char *p = file.data( );
+        const char *end = p + file.size( );
+        uint64_t count;
+        if( file.size( ) < MAGIC_BYTES || memcmp( p, snapshotMagic( ), MAGIC_BYTES ) != 0 )
+            return false;
+        p += MAGIC_BYTES;
+        if( !getU64( p, end, lsn_ ) || !getU64( p, end, count ) )
+            return false;
+
+        // Every item takes at least its two u32 lengths
+        if( count > static_cast<uint64_t>( end - p ) / 8 )
+            return false;
+        vector<SequenceMap> items;
+        items.reserve( count );
+        const char *body = p;
+        for( uint64_t i = 0; i < count; ++i )
+            if( !getSequenceMap( p, end, items ) )
+                return false;
+        uint32_t checksum;
+        if( !getU32( p, end, checksum ) ||
+            checksum != fnv1a( FNV_OFFSET, body, p - 4 - body ) )
+            return false;
+        tree_.bulkLoad( std::move( items ) );
+        return true;
+    }
+
+    /**
+     * Apply the log records newer than the snapshot. Return the length
+     * of the valid prefix of the log.
+     */
+    size_t replayLog( )
+    {
+        MappedFile file( logPath( ) );
+        if( !file.isOpen( ) )
+            return 0;
+        const char *begin = file.data( );
+        const char *end = begin + file.size( );
+        const char *p = begin;
+        uint64_t snapshotLsn = lsn_;
+        vector<SequenceMap> record;
+        while( true )
+        {
+            const char *recordStart = p;
+            uint32_t length, checksum;
+            uint64_t lsn;
+            if( !getU32( p, end, length ) || !getU32( p, end, checksum ) ||
+                static_cast<size_t>( end - p ) < length ||
+                checksum != fnv1a( FNV_OFFSET, p, length ) )
+                return recordStart - begin;
+            const char *bodyEnd = p + length;
+            record.clear( );
+            if( !getU64( p, bodyEnd, lsn ) || p == bodyEnd )
+                return recordStart - begin;
+            uint8_t type = static_cast<uint8_t>( *p++ );
+            if( !getSequenceMap( p, bodyEnd, record ) )
+                return recordStart - begin;
+            p = bodyEnd;
+
+            if( lsn <= snapshotLsn )
+                continue;   // Already part of the snapshot
+            if( type == INSERT_RECORD )
+                tree_.insert( std::move( record[ 0 ] ) );
+            else
+                tree_.remove( record[ 0 ] );
+            lsn_ = lsn;
+            replayedRecords_++;
+        }
+    }
+
+    void syncLog( )
+    {
+        if( fdatasync( logFd_ ) != 0 )
+            throw IOException{ };
+        commitsSinceSync_ = 0;
+    }
+
+    void syncDirectory( ) const
+    {
+        int fd = ::open( directory_.c_str( ), O_RDONLY );
+        if( fd >= 0 )
+        {
+            fsync( fd );
+            ::close( fd );
+        }
+    }
+
+    static bool writeSome( int fd, const string & bytes )
+    {
+        const char *p = bytes.data( );
+        size_t left = bytes.size( );
+        while( left > 0 )
+        {
+            ssize_t written = ::write( fd, p, left );
+            if( written < 0 )
+                return false;
+            p += written;
+            left -= written;
+        }
+        return true;
+    }
+
+    static void writeAll( int fd, const string & bytes )
+    {
+        if( fd < 0 || !writeSome( fd, bytes ) )
+            throw IOException{ };
+    }
+
+    static uint32_t fnv1a( uint32_t hash, const char *p, size_t n )
+    {
+        for( size_t i = 0; i < n; ++i )
+        {
+            hash ^= static_cast<unsigned char>( p[ i ] );
+            hash *= 16777619u;
+        }
+        return hash;
+    }
+
+    static void putU32( string & out, uint32_t v )
+    {
+        out.append( reinterpret_cast<const char *>( &v ), 4 );
+    }
+
+    static void putU64( string & out, uint64_t v )
+    {
+        out.append( reinterpret_cast<const char *>( &v ), 8 );
+    }
+
+    static void putString( string & out, const string & s )
+    {
+        putU32( out, static_cast<uint32_t>( s.size( ) ) );
+        out.append( s );
+    }
+
+    static void putSequenceMap( string & out, const SequenceMap & x )
+    {
+        putString( out, x.getRecognitionSequence( ) );
+        putU32( out, static_cast<uint32_t>( x.getEnzymeCount( ) ) );
+        for( size_t i = 0; i < x.getEnzymeCount( ); ++i )
+            putString( out, x.getEnzymeAcronym( i ) );
+    }
+
+    static bool getU32( const char * & p, const char *end, uint32_t & v )
+    {
+        if( end - p < 4 )
+            return false;
+        memcpy( &v, p, 4 );
+        p += 4;
+        return true;
+    }
+
+    static bool getU64( const char * & p, const char *end, uint64_t & v )
+    {
+        if( end - p < 8 )
+            return false;
+        memcpy( &v, p, 8 );
+        p += 8;
+        return true;
+    }
+
+    static bool getString( const char * & p, const char *end, string & s )
+    {
+        uint32_t length;
+        if( !getU32( p, end, length ) || static_cast<size_t>( end - p ) < length )
+            return false;
+        s.assign( p, length );
+        p += length;
+        return true;
+    }
+
+    /**
+     * Decode one SequenceMap from p and append it to out.
+     */
+    static bool getSequenceMap( const char * & p, const char *end, vector<SequenceMap> & out )
+    {
+        string sequence;
+        uint32_t count;
+        if( !getString( p, end, sequence ) || !getU32( p, end, count ) ||
+            count > static_cast<size_t>( end - p ) / 4 )
+            return false;
+        vector<string> acronyms( count );
+        for( uint32_t i = 0; i < count; ++i )
+            if( !getString( p, end, acronyms[ i ] ) )
+                return false;
+        out.emplace_back( sequence, acronyms );
+        return true;
+    }
+};
+
+#endif
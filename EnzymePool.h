@@ -0,0 +1,183 @@
+#ifndef ENZYME_POOL_H
+#define ENZYME_POOL_H
+
+#include "dsexceptions.h"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <vector>
+using namespace std;
+
+// EnzymePool class
+//
+// CONSTRUCTION: none; use EnzymePool::instance( )
+//
+// The process-wide table of enzyme acronyms. Each distinct acronym is
+// stored once, as a C string packed into large character blocks, and
+// named by a 32-bit id. An entry that refers to an acronym holds four
+// bytes instead of a string object of its own, and two acronyms are
+// equal exactly when their ids are. Acronyms are never removed, and end
+// at their first NUL character. The empty acronym always has id 0.
+//
+// intern may be called from any number of threads. name needs no lock:
+// an acronym is written before intern returns its id, and never moves.
+//
+// ******************PUBLIC OPERATIONS*********************
+// uint32_t intern( name, length ) --> Return the id of name, adding it if new
+// uint32_t intern( name )         --> Same, for a string
+// const char * name( id )         --> Return the acronym with this id
+// size_t size( )                  --> Return number of distinct acronyms
+// ******************ERRORS********************************
+// Throws ArrayIndexOutOfBoundsException if the table is full
+
+class EnzymePool
+{
+  public:
+    static EnzymePool & instance( )
+    {
+        static EnzymePool pool;
+        return pool;
+    }
+
+    EnzymePool( const EnzymePool & rhs ) = delete;
+    EnzymePool & operator=( const EnzymePool & rhs ) = delete;
+
+    ~EnzymePool( )
+    {
+        for( size_t c = 0; c < MAX_CHUNKS && names_[ c ] != nullptr; ++c )
+            delete [ ] names_[ c ];
+        for( size_t b = 0; b < blocks_.size( ); ++b )
+            delete [ ] blocks_[ b ];
+    }
+
+    uint32_t intern( const char *name, size_t length )
+    {
+        length = strnlen( name, length );
+        if( length == 0 )
+            return 0;
+        uint32_t hash = hashOf( name, length );
+        lock_guard<mutex> guard( lock_ );
+        size_t mask = slots_.size( ) - 1;
+        size_t s = hash & mask;
+        for( ; slots_[ s ] != EMPTY; s = ( s + 1 ) & mask )
+        {
+            const char *candidate = this->name( slots_[ s ] );
+            if( strncmp( candidate, name, length ) == 0 && candidate[ length ] == '\0' )
+                return slots_[ s ];
+        }
+
+        uint32_t id = add( name, length );
+        slots_[ s ] = id;
+        if( 2 * size_ > slots_.size( ) )
+            grow( );
+        return id;
+    }
+
+    uint32_t intern( const string & name )
+    {
+        return intern( name.data( ), name.size( ) );
+    }
+
+    const char * name( uint32_t id ) const
+    {
+        return names_[ id >> CHUNK_BITS ][ id & ( CHUNK_SIZE - 1 ) ];
+    }
+
+    size_t size( ) const
+    {
+        lock_guard<mutex> guard( lock_ );
+        return size_;
+    }
+
+  private:
+    static const size_t CHUNK_BITS = 12;
+    static const size_t CHUNK_SIZE = size_t( 1 ) << CHUNK_BITS;
+    static const size_t MAX_CHUNKS = 4096;
+    static const size_t BLOCK_SIZE = 64 * 1024;
+    enum : uint32_t { EMPTY = 0xffffffff };     // Unused slot in slots_
+
+    // The start of each acronym, by id, in fixed chunks that are never
+    // reallocated, so a reader can index them while names are added
+    const char **names_[ MAX_CHUNKS ];
+    size_t size_;
+
+    mutable mutex lock_;        // Guards adding names and the fields below
+    vector<uint32_t> slots_;    // Open-addressing index from name to id
+    vector<char *> blocks_;     // Character storage for the acronyms
+    size_t blockFree_;          // Unused bytes at the end of the last block
+
+    EnzymePool( ) : size_{ 0 }, slots_( 1024, EMPTY ), blockFree_{ 0 }
+    {
+        for( size_t c = 0; c < MAX_CHUNKS; ++c )
+            names_[ c ] = nullptr;
+        add( "", 0 );
+    }
+
+    // FNV-1a
+    static uint32_t hashOf( const char *name, size_t length )
+    {
+        uint32_t hash = 2166136261u;
+        for( size_t i = 0; i < length; ++i )
+        {
+            hash ^= static_cast<unsigned char>( name[ i ] );
+            hash *= 16777619u;
+        }
+        return hash;
+    }
+
+    /**
+     * Copy name into the blocks and give it the next id. A name too
+     * long for a block gets a block to itself.
+     */
+    uint32_t add( const char *name, size_t length )
+    {
+        if( size_ == MAX_CHUNKS * CHUNK_SIZE )
+            throw ArrayIndexOutOfBoundsException{ };
+        size_t chunk = size_ >> CHUNK_BITS;
+        if( names_[ chunk ] == nullptr )
+            names_[ chunk ] = new const char *[ CHUNK_SIZE ];
+
+        char *copy;
+        if( length + 1 > BLOCK_SIZE )
+        {
+            copy = new char[ length + 1 ];
+            blocks_.insert( blocks_.end( ) - ( blocks_.empty( ) ? 0 : 1 ), copy );
+        }
+        else
+        {
+            if( length + 1 > blockFree_ )
+            {
+                blocks_.push_back( new char[ BLOCK_SIZE ] );
+                blockFree_ = BLOCK_SIZE;
+            }
+            copy = blocks_.back( ) + ( BLOCK_SIZE - blockFree_ );
+            blockFree_ -= length + 1;
+        }
+        memcpy( copy, name, length );
+        copy[ length ] = '\0';
+        names_[ chunk ][ size_ & ( CHUNK_SIZE - 1 ) ] = copy;
+        return static_cast<uint32_t>( size_++ );
+    }
+
+    /**
+     * Double the index and reinsert every name except the empty one,
+     * which intern answers without a lookup.
+     */
+    void grow( )
+    {
+        slots_.assign( 2 * slots_.size( ), EMPTY );
+        size_t mask = slots_.size( ) - 1;
+        for( uint32_t id = 1; id < size_; ++id )
+        {
+            const char *s = name( id );
+            size_t slot = hashOf( s, strlen( s ) ) & mask;
+            while( slots_[ slot ] != EMPTY )
+                slot = ( slot + 1 ) & mask;
+            slots_[ slot ] = id;
+        }
+    }
+};
+
+#endif
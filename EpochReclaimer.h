@@ -0,0 +1,133 @@
+#ifndef EPOCH_RECLAIMER_H
+#define EPOCH_RECLAIMER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <thread>
+using namespace std;
+
+// EpochReclaimer class
+//
+// CONSTRUCTION: zero parameter
+//
+// Epoch-based reclamation for structures whose readers run without
+// locks. A reader pins the current epoch for as long as it holds
+// pointers into the structure. A writer that unlinks memory notes the
+// epoch it was unlinked in, then advances the epoch. Memory unlinked
+// in an epoch older than every pinned epoch cannot be reached by any
+// reader and may be freed.
+//
+// Readers may run on any number of threads. Unlinking, advance and
+// safeBefore are for one writer at a time.
+//
+// ******************PUBLIC OPERATIONS*********************
+// Guard( reclaimer )      --> Pin the current epoch until destroyed
+// uint64_t current( )     --> Return the current epoch
+// void advance( )         --> Start a new epoch
+// uint64_t safeBefore( )  --> Memory unlinked in an epoch below this may be freed
+
+class EpochReclaimer
+{
+  public:
+    // At most this many readers are pinned at once; more wait for a slot
+    static const int MAX_READERS = 64;
+
+    EpochReclaimer( ) : epoch_{ 1 }
+    {
+        for( int i = 0; i < MAX_READERS; ++i )
+            slots_[ i ].pinned.store( 0, memory_order_relaxed );
+    }
+
+    EpochReclaimer( const EpochReclaimer & rhs ) = delete;
+    EpochReclaimer & operator=( const EpochReclaimer & rhs ) = delete;
+
+    class Guard
+    {
+      public:
+        explicit Guard( const EpochReclaimer & reclaimer )
+          : slot_{ reclaimer.pin( ) }
+          { }
+
+        Guard( Guard && rhs ) : slot_{ rhs.slot_ }
+        {
+            rhs.slot_ = nullptr;
+        }
+
+        Guard( const Guard & rhs ) = delete;
+        Guard & operator=( const Guard & rhs ) = delete;
+
+        ~Guard( )
+        {
+            if( slot_ != nullptr )
+                slot_->store( 0, memory_order_release );
+        }
+
+      private:
+        atomic<uint64_t> *slot_;
+    };
+
+    uint64_t current( ) const
+    {
+        return epoch_.load( );
+    }
+
+    void advance( )
+    {
+        epoch_.fetch_add( 1 );
+    }
+
+    /**
+     * Return the oldest pinned epoch, or one past the current epoch if
+     * no reader is pinned.
+     */
+    uint64_t safeBefore( ) const
+    {
+        uint64_t oldest = epoch_.load( ) + 1;
+        for( int i = 0; i < MAX_READERS; ++i )
+        {
+            uint64_t pinned = slots_[ i ].pinned.load( );
+            if( pinned != 0 && pinned < oldest )
+                oldest = pinned;
+        }
+        return oldest;
+    }
+
+  private:
+    // One cache line per slot, so readers on different slots do not
+    // invalidate each other's lines
+    struct Slot
+    {
+        atomic<uint64_t> pinned;    // Pinned epoch, or 0 if free
+        char padding[ 64 - sizeof( atomic<uint64_t> ) ];
+    };
+
+    atomic<uint64_t> epoch_;
+    mutable Slot slots_[ MAX_READERS ];
+
+    /**
+     * Claim a free slot and pin the current epoch in it. The claim is
+     * sequentially consistent, so a writer that scans the slots after
+     * it sees the pin, and a writer that scanned before it has already
+     * published every unlink the reader could otherwise run into.
+     */
+    atomic<uint64_t> * pin( ) const
+    {
+        size_t start = hash<thread::id>( )( this_thread::get_id( ) ) % MAX_READERS;
+        while( true )
+        {
+            for( int i = 0; i < MAX_READERS; ++i )
+            {
+                atomic<uint64_t> & slot = slots_[ ( start + i ) % MAX_READERS ].pinned;
+                uint64_t expected = 0;
+                if( slot.load( memory_order_relaxed ) == 0 &&
+                    slot.compare_exchange_strong( expected, epoch_.load( ) ) )
+                    return &slot;
+            }
+            this_thread::yield( );
+        }
+    }
+};
+
+#endif
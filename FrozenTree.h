@@ -0,0 +1,238 @@
+#ifndef FROZEN_TREE_H
+#define FROZEN_TREE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <iostream>
+#include <utility>
+#include <vector>
+using namespace std;
+
+// FrozenTree class
+//
+// CONSTRUCTION: from a sorted vector of distinct items,
+//               usually through AvlTree::freeze( )
+//
+// An immutable search structure that stores its items in one array in
+// Eytzinger (BFS) order: the children of slot k are slots 2k and 2k+1.
+// Lookups descend without data-dependent branches and prefetch the
+// block of slots two levels below the current one.
+//
+// ******************PUBLIC OPERATIONS*********************
+// Comparable * find( x )   --> Return matching item or nullptr
+// pair find_count( x )     --> find, plus number of levels visited
+// void find_batch( queries, found ) --> Look up sorted queries in one pass
+// void range( lo, hi )     --> Print items strictly between lo and hi
+// size_t size( )           --> Return number of items
+// size_t depth( )          --> Return summed depth, as AvlTree::depth
+// void makeEmpty( )        --> Release the snapshot
+// ******************ERRORS********************************
+// None
+
+template <typename Comparable>
+class FrozenTree
+{
+  public:
+    FrozenTree( ) : size_{ 0 }
+      { }
+
+    /**
+     * Build from items sorted in increasing order with no duplicates.
+     */
+    explicit FrozenTree( const vector<Comparable> & sorted ) : size_{ sorted.size( ) }
+    {
+        nodes_.reserve( size_ );
+        vector<size_t> order( size_ + 1 );
+        size_t next = 0;
+        fillInOrder( order, next );
+        for( size_t k = 1; k <= size_; ++k )
+            nodes_.push_back( sorted[ order[ k ] ] );
+    }
+
+    const Comparable * find( const Comparable & x ) const
+    {
+        int calls = 0;
+        return find( x, calls );
+    }
+
+    pair<const Comparable *, int> find_count( const Comparable & x ) const
+    {
+        int calls = 0;
+        const Comparable *result = find( x, calls );
+        return pair<const Comparable *, int>( result, calls );
+    }
+
+    /**
+     * Look up queries sorted in increasing order in one traversal.
+     * Each slot is visited at most once for the whole batch, and the
+     * queries are split between its children, as in findBatch.
+     * found[ i ] is set to the match for queries[ i ], or nullptr.
+     */
+    void find_batch( const vector<Comparable> & queries, vector<const Comparable *> & found ) const
+    {
+        struct Task
+        {
+            size_t k;
+            size_t lo;
+            size_t hi;
+        };
+
+        found.assign( queries.size( ), nullptr );
+        vector<Task> pending;
+        Task task = { 1, 0, queries.size( ) };
+        while( true )
+        {
+            if( task.k > size_ || task.lo == task.hi )
+            {
+                if( pending.empty( ) )
+                    return;
+                task = pending.back( );
+                pending.pop_back( );
+                continue;
+            }
+            const Comparable & item = at( task.k );
+            size_t less = lower_bound( queries.begin( ) + task.lo, queries.begin( ) + task.hi, item )
+                          - queries.begin( );
+            size_t equal = less;
+            while( equal < task.hi && !( item < queries[ equal ] ) )
+                found[ equal++ ] = &item;
+
+            Task right = { 2 * task.k + 1, equal, task.hi };
+            pending.push_back( right );
+            task.k = 2 * task.k;
+            task.hi = less;
+        }
+    }
+
+    void range( const Comparable & left, const Comparable & right, ostream & out = cout ) const
+    {
+        for( size_t k = upperBound( left ); k != 0 && at( k ) < right; k = successor( k ) )
+            out << at( k ) << '\n';
+    }
+
+    size_t size( ) const
+    {
+        return size_;
+    }
+
+    size_t depth( ) const
+    {
+        size_t total = 0;
+        for( size_t k = 1; k <= size_; ++k )
+        {
+            total += level( k );
+            if( 2 * k > size_ )    // Leaf
+                total += 1;
+        }
+        return total;
+    }
+
+    bool isEmpty( ) const
+    {
+        return size_ == 0;
+    }
+
+    void makeEmpty( )
+    {
+        vector<Comparable>( ).swap( nodes_ );
+        size_ = 0;
+    }
+
+  private:
+    vector<Comparable> nodes_;    // Slot k lives at nodes_[ k - 1 ]
+    size_t size_;
+
+    const Comparable & at( size_t k ) const
+    {
+        return nodes_[ k - 1 ];
+    }
+
+    /**
+     * Descend to the first slot whose item is not less than x.
+     * Each level is one comparison folded into the index, so the
+     * loop has no branch that depends on the comparison result.
+     */
+    const Comparable * find( const Comparable & x, int & calls ) const
+    {
+        size_t k = 1;
+        while( k <= size_ )
+        {
+            prefetchGrandchildren( k );
+            k = 2 * k + ( at( k ) < x );
+            calls++;
+        }
+        k >>= __builtin_ffsll( ~k );
+        if( k == 0 || x < at( k ) )
+            return nullptr;
+        return &at( k );
+    }
+
+    /**
+     * Slots 4k .. 4k+3 are contiguous, so two levels ahead of k is
+     * one short run of cache lines whichever way the descent goes.
+     */
+    void prefetchGrandchildren( size_t k ) const
+    {
+        if( 4 * k + 3 > size_ )
+            return;
+        const char *first = reinterpret_cast<const char *>( &at( 4 * k ) );
+        const char *last = reinterpret_cast<const char *>( &at( 4 * k + 3 ) + 1 );
+        for( ; first < last; first += 64 )
+            __builtin_prefetch( first );
+    }
+
+    /**
+     * Return the slot of the first item greater than x, or 0 if none.
+     */
+    size_t upperBound( const Comparable & x ) const
+    {
+        size_t k = 1;
+        while( k <= size_ )
+            k = 2 * k + !( x < at( k ) );
+        return k >> __builtin_ffsll( ~k );
+    }
+
+    /**
+     * Return the slot holding the next larger item, or 0 past the end.
+     */
+    size_t successor( size_t k ) const
+    {
+        if( 2 * k + 1 <= size_ )
+        {
+            k = 2 * k + 1;
+            while( 2 * k <= size_ )
+                k = 2 * k;
+            return k;
+        }
+        return k >> __builtin_ffsll( ~k );
+    }
+
+    static int level( size_t k )
+    {
+        int l = 0;
+        for( ; k != 0; k >>= 1 )
+            ++l;
+        return l;
+    }
+
+    /**
+     * Record in order[ k ] the sorted index that belongs in slot k,
+     * by walking the implicit tree in order without recursion.
+     */
+    void fillInOrder( vector<size_t> & order, size_t & next ) const
+    {
+        size_t k = 1;
+        while( true )
+        {
+            while( k <= size_ )
+                k = 2 * k;
+            k >>= __builtin_ffsll( ~k );    // Climb to the next unvisited ancestor
+            if( k == 0 )
+                return;
+            order[ k ] = next++;
+            k = 2 * k + 1;
+        }
+    }
+};
+
+#endif
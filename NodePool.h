@@ -0,0 +1,180 @@
+#ifndef NODE_POOL_H
+#define NODE_POOL_H
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+using namespace std;
+
+// NodePool class
+//
+// CONSTRUCTION: zero parameter
+//
+// Hands out Node-sized slots carved from large contiguous chunks.
+// Slots returned through deallocate are recycled through a free list,
+// and release hands every chunk back to the heap in one sweep.
+//
+// ******************PUBLIC OPERATIONS*********************
+// Node * allocate( args... ) --> Construct a Node in a pooled slot
+// void deallocate( n )       --> Destroy n and recycle its slot
+// void destroy( n )          --> Destroy n only; slot is reclaimed by release
+// void release( )            --> Free all chunks at once
+// void adopt( rhs )          --> Take over rhs's chunks, leaving it empty
+// size_t chunkCount( )       --> Return number of chunks held
+// ******************ERRORS********************************
+// Throws bad_alloc if a chunk cannot be obtained
+
+template <typename Node>
+class NodePool
+{
+  public:
+    NodePool( ) : free_list_{ nullptr }, next_slot_{ nullptr }, end_slot_{ nullptr }
+      { }
+
+    NodePool( const NodePool & rhs ) = delete;
+    NodePool & operator=( const NodePool & rhs ) = delete;
+
+    NodePool( NodePool && rhs )
+      : chunks_{ std::move( rhs.chunks_ ) }, free_list_{ rhs.free_list_ },
+        next_slot_{ rhs.next_slot_ }, end_slot_{ rhs.end_slot_ }
+    {
+        rhs.chunks_.clear( );
+        rhs.free_list_ = rhs.next_slot_ = rhs.end_slot_ = nullptr;
+    }
+
+    /**
+     * Move. The chunks previously owned by this pool go to rhs.
+     */
+    NodePool & operator=( NodePool && rhs )
+    {
+        std::swap( chunks_, rhs.chunks_ );
+        std::swap( free_list_, rhs.free_list_ );
+        std::swap( next_slot_, rhs.next_slot_ );
+        std::swap( end_slot_, rhs.end_slot_ );
+        return *this;
+    }
+
+    /**
+     * Frees the chunks. Live nodes must already have been destroyed.
+     */
+    ~NodePool( )
+    {
+        release( );
+    }
+
+    /**
+     * Construct a Node from args in a recycled slot if one is available,
+     * otherwise in the next unused slot of the current chunk.
+     */
+    template <typename... Args>
+    Node * allocate( Args &&... args )
+    {
+        Slot *slot;
+        if( free_list_ != nullptr )
+        {
+            slot = free_list_;
+            free_list_ = free_list_->next_;
+        }
+        else
+        {
+            if( next_slot_ == end_slot_ )
+                addChunk( );
+            slot = next_slot_++;
+        }
+        return new ( slot ) Node( std::forward<Args>( args )... );
+    }
+
+    /**
+     * Destroy n and push its slot onto the free list.
+     */
+    void deallocate( Node *n )
+    {
+        n->~Node( );
+        Slot *slot = reinterpret_cast<Slot *>( n );
+        slot->next_ = free_list_;
+        free_list_ = slot;
+    }
+
+    /**
+     * Destroy n without recycling its slot.
+     * Used before release when tearing down a whole tree.
+     */
+    void destroy( Node *n )
+    {
+        n->~Node( );
+    }
+
+    /**
+     * Return every chunk to the heap in one sweep.
+     * Nodes still living in the pool are not destroyed.
+     */
+    void release( )
+    {
+        for( size_t i = 0; i < chunks_.size( ); ++i )
+            ::operator delete( chunks_[ i ] );
+        chunks_.clear( );
+        free_list_ = next_slot_ = end_slot_ = nullptr;
+    }
+
+    /**
+     * Take over every chunk of rhs along with the nodes living in them,
+     * so this pool can destroy and recycle them; rhs is left empty.
+     * rhs's unused and recycled slots join this pool's free list.
+     */
+    void adopt( NodePool & rhs )
+    {
+        chunks_.insert( chunks_.end( ), rhs.chunks_.begin( ), rhs.chunks_.end( ) );
+        while( rhs.next_slot_ != rhs.end_slot_ )
+        {
+            Slot *slot = rhs.next_slot_++;
+            slot->next_ = free_list_;
+            free_list_ = slot;
+        }
+        if( rhs.free_list_ != nullptr )
+        {
+            Slot *tail = rhs.free_list_;
+            while( tail->next_ != nullptr )
+                tail = tail->next_;
+            tail->next_ = free_list_;
+            free_list_ = rhs.free_list_;
+        }
+        rhs.chunks_.clear( );
+        rhs.free_list_ = rhs.next_slot_ = rhs.end_slot_ = nullptr;
+    }
+
+    size_t chunkCount( ) const
+    {
+        return chunks_.size( );
+    }
+
+  private:
+    union Slot
+    {
+        Slot *next_;
+        typename aligned_storage<sizeof( Node ), alignof( Node )>::type storage_;
+    };
+
+    // Roughly 64KB per chunk, but never fewer than 64 nodes.
+    static const size_t CHUNK_BYTES = 64 * 1024;
+    static const size_t SLOTS_PER_CHUNK =
+        CHUNK_BYTES / sizeof( Slot ) > 64 ? CHUNK_BYTES / sizeof( Slot ) : 64;
+
+    vector<Slot *> chunks_;
+    Slot *free_list_;
+    Slot *next_slot_;
+    Slot *end_slot_;
+
+    void addChunk( )
+    {
+        if( chunks_.size( ) == chunks_.capacity( ) )
+            chunks_.reserve( 2 * chunks_.size( ) + 1 );
+        Slot *chunk = static_cast<Slot *>( ::operator new( SLOTS_PER_CHUNK * sizeof( Slot ) ) );
+        chunks_.push_back( chunk );
+        next_slot_ = chunk;
+        end_slot_ = chunk + SLOTS_PER_CHUNK;
+    }
+};
+
+#endif
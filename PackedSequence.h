@@ -0,0 +1,270 @@
+#ifndef PACKED_SEQUENCE_H
+#define PACKED_SEQUENCE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+using namespace std;
+
+// PackedSequence class
+//
+// CONSTRUCTION: with a string, or a pointer and a length
+//
+// A recognition sequence packed at 4 bits per symbol. REBASE writes
+// sequences with the 15 IUPAC nucleotide codes and the cut mark ', and
+// those 16 symbols get codes 0 to 15 in ASCII order, so comparing packed
+// words gives the same order as comparing the strings.
+//
+// The object is two words. head_ holds symbols 0-15. For a sequence of
+// at most INLINE_SYMBOLS symbols, tail_ holds symbols 16-29 in its top
+// 56 bits and 2 * length + 1 in its low byte. Unused symbols are code 0,
+// so two such keys compare as the pair ( head_, tail_ ): symbols first,
+// and length breaks the tie when one is a prefix of the other.
+//
+// A longer sequence spills to the heap, and tail_ (even, since it is
+// aligned) points to a block holding the length and every symbol, 16 to
+// a word. Any other character makes the block hold the raw characters
+// instead, and such keys are compared as strings.
+//
+// ******************PUBLIC OPERATIONS*********************
+// bool operator<( rhs )  --> Compare as the strings would compare
+// string str( )          --> Return the sequence as a string
+// size_t length( )       --> Return number of symbols
+// bool isInline( )       --> Return true if no heap block is used
+// size_t hash( )         --> Return a hash of the sequence
+
+class PackedSequence
+{
+  public:
+    enum { INLINE_SYMBOLS = 30 };
+
+    PackedSequence( )
+      : head_{ 0 }, tail_{ 1 }
+    {
+    }
+
+    explicit PackedSequence( const string & s )
+    {
+        assign( s.data( ), s.size( ) );
+    }
+
+    PackedSequence( const char *s, size_t length )
+    {
+        assign( s, length );
+    }
+
+    PackedSequence( const PackedSequence & rhs )
+      : head_{ rhs.head_ }, tail_{ rhs.tail_ }
+    {
+        if( !rhs.isInline( ) )
+        {
+            size_t words = 1 + rhs.spill( )->words;
+            uint64_t *copy = new uint64_t[ words ];
+            memcpy( copy, rhs.spill( ), words * sizeof( uint64_t ) );
+            tail_ = reinterpret_cast<uintptr_t>( copy );
+        }
+    }
+
+    PackedSequence( PackedSequence && rhs )
+      : head_{ rhs.head_ }, tail_{ rhs.tail_ }
+    {
+        rhs.tail_ = 1;
+    }
+
+    ~PackedSequence( )
+    {
+        release( );
+    }
+
+    PackedSequence & operator=( const PackedSequence & rhs )
+    {
+        if( this != &rhs )
+        {
+            PackedSequence copy = rhs;
+            *this = std::move( copy );
+        }
+        return *this;
+    }
+
+    PackedSequence & operator=( PackedSequence && rhs )
+    {
+        if( this != &rhs )
+        {
+            release( );
+            head_ = rhs.head_;
+            tail_ = rhs.tail_;
+            rhs.tail_ = 1;
+        }
+        return *this;
+    }
+
+    bool isInline( ) const
+    {
+        return ( tail_ & 1 ) != 0;
+    }
+
+    size_t length( ) const
+    {
+        return isInline( ) ? ( tail_ & 0xff ) >> 1 : spill( )->length;
+    }
+
+    /**
+     * Two inline keys, which is every key in rebase210.txt, take two
+     * integer compares. Otherwise head_ settles most packed keys.
+     */
+    bool operator<( const PackedSequence & rhs ) const
+    {
+        if( ( tail_ & rhs.tail_ & 1 ) != 0 )
+            return head_ < rhs.head_ || ( head_ == rhs.head_ && tail_ < rhs.tail_ );
+        return compareSpilled( rhs ) < 0;
+    }
+
+    /**
+     * A sequence has only one encoding, so equal keys hash their words
+     * alike. An inline key is two words, mixed with two multiplies.
+     */
+    size_t hash( ) const
+    {
+        if( isInline( ) )
+            return mix( head_ ^ mix( tail_ ) );
+        const uint64_t *words = reinterpret_cast<const uint64_t *>( spill( ) + 1 );
+        uint64_t h = mix( spill( )->length );
+        if( isPacked( ) )
+            for( size_t w = 0; w < spill( )->words; ++w )
+                h = mix( h ^ words[ w ] );
+        else
+            for( size_t i = 0; i < length( ); ++i )
+                h = mix( h ^ reinterpret_cast<const unsigned char *>( words )[ i ] );
+        return static_cast<size_t>( h );
+    }
+
+    string str( ) const
+    {
+        if( !isPacked( ) )
+            return string( reinterpret_cast<const char *>( spill( ) + 1 ), length( ) );
+        string s( length( ), ' ' );
+        for( size_t i = 0; i < s.size( ); ++i )
+            s[ i ] = symbols( )[ ( word( i / 16 ) >> ( 60 - 4 * ( i % 16 ) ) ) & 0xf ];
+        return s;
+    }
+
+  private:
+    // The heap block: this header, then the symbols or the raw characters
+    struct Spill
+    {
+        uint32_t length;
+        uint32_t words : 31;    // Words after the header
+        uint32_t packed : 1;    // 0 if the block holds raw characters
+    };
+
+    // The symbol for each code
+    static const char * symbols( )
+    {
+        return "'ABCDGHKMNRSTVWY";
+    }
+
+    uint64_t head_;
+    uint64_t tail_;
+
+    // Finalizer from MurmurHash3: every input bit reaches every output bit
+    static uint64_t mix( uint64_t x )
+    {
+        x ^= x >> 33;
+        x *= 0xff51afd7ed558ccdULL;
+        x ^= x >> 33;
+        x *= 0xc4ceb9fe1a85ec53ULL;
+        return x ^ x >> 33;
+    }
+
+    static int codeOf( char c )
+    {
+        const char *p = static_cast<const char *>( memchr( symbols( ), c, 16 ) );
+        return p == nullptr ? -1 : static_cast<int>( p - symbols( ) );
+    }
+
+    const Spill * spill( ) const
+    {
+        return reinterpret_cast<const Spill *>( tail_ );
+    }
+
+    bool isPacked( ) const
+    {
+        return isInline( ) || spill( )->packed != 0;
+    }
+
+    /**
+     * Symbol word w of a packed key, 0 past the end. Word 1 of an inline
+     * key is its top 56 bits.
+     */
+    uint64_t word( size_t w ) const
+    {
+        if( w == 0 )
+            return head_;
+        if( isInline( ) )
+            return w == 1 ? tail_ & ~uint64_t( 0xff ) : 0;
+        const uint64_t *words = reinterpret_cast<const uint64_t *>( spill( ) + 1 );
+        return w < spill( )->words ? words[ w ] : 0;
+    }
+
+    size_t wordCount( ) const
+    {
+        return isInline( ) ? 2 : spill( )->words;
+    }
+
+    int compareSpilled( const PackedSequence & rhs ) const
+    {
+        if( !isPacked( ) || !rhs.isPacked( ) )
+            return str( ).compare( rhs.str( ) );
+        size_t words = wordCount( ) > rhs.wordCount( ) ? wordCount( ) : rhs.wordCount( );
+        for( size_t w = 0; w < words; ++w )
+            if( word( w ) != rhs.word( w ) )
+                return word( w ) < rhs.word( w ) ? -1 : 1;
+        return length( ) < rhs.length( ) ? -1 : length( ) > rhs.length( ) ? 1 : 0;
+    }
+
+    void release( )
+    {
+        if( !isInline( ) )
+            delete [ ] reinterpret_cast<uint64_t *>( tail_ );
+        tail_ = 1;
+    }
+
+    void assign( const char *s, size_t length )
+    {
+        uint64_t packed[ 2 ] = { 0, 0 };
+        bool allSymbols = true;
+        for( size_t i = 0; i < length && allSymbols; ++i )
+        {
+            int code = codeOf( s[ i ] );
+            allSymbols = code >= 0;
+            if( allSymbols && i < INLINE_SYMBOLS )
+                packed[ i / 16 ] |= uint64_t( code ) << ( 60 - 4 * ( i % 16 ) );
+        }
+        if( allSymbols && length <= INLINE_SYMBOLS )
+        {
+            head_ = packed[ 0 ];
+            tail_ = packed[ 1 ] | ( 2 * length + 1 );
+            return;
+        }
+
+        size_t words = allSymbols ? ( length + 15 ) / 16 : ( length + 7 ) / 8;
+        uint64_t *block = new uint64_t[ 1 + words ];
+        Spill *header = reinterpret_cast<Spill *>( block );
+        header->length = static_cast<uint32_t>( length );
+        header->words = static_cast<uint32_t>( words );
+        header->packed = allSymbols;
+        uint64_t *data = block + 1;
+        for( size_t w = 0; w < words; ++w )
+            data[ w ] = 0;
+        if( allSymbols )
+            for( size_t i = 0; i < length; ++i )
+                data[ i / 16 ] |= uint64_t( codeOf( s[ i ] ) ) << ( 60 - 4 * ( i % 16 ) );
+        else
+            memcpy( data, s, length );
+        head_ = allSymbols ? data[ 0 ] : 0;
+        tail_ = reinterpret_cast<uintptr_t>( block );
+    }
+};
+
+#endif
@@ -0,0 +1,216 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+using namespace std;
+
+// PerfCounters class
+//
+// CONSTRUCTION: zero parameter
+//
+// Hardware event counts for the calling thread, from Linux
+// perf_event_open: cycles, instructions, L1 data and last-level cache
+// misses, data TLB misses and branch mispredictions, plus task clock
+// and page faults, which the kernel counts in software. User-space
+// events only, so a default perf_event_paranoid setting allows them.
+//
+// Each event is opened on its own rather than as a group, so an event
+// the CPU, the hypervisor or the kernel refuses leaves the others
+// working; it is reported as unavailable. When more events are open
+// than the PMU has counters, the kernel time-shares them, and each
+// count is scaled up by the fraction of the time it was running.
+// Elsewhere than Linux every event is unavailable.
+//
+// ******************PUBLIC OPERATIONS*********************
+// void start( )          --> Zero and enable every available event
+// void stop( )           --> Disable the events and read their counts
+// bool available( e )    --> Return true if event e could be opened
+// bool anyAvailable( )   --> Return true if any event could be opened
+// string unavailable( )  --> Return the names of the events not opened
+// double count( e )      --> Return event e's count between start and stop
+// void report( out, label, ops ) --> Print each count per operation
+// string why( )          --> Return why the first unavailable event failed
+
+class PerfCounters
+{
+  public:
+    enum Event { CYCLES, INSTRUCTIONS, L1D_MISSES, LLC_MISSES, DTLB_MISSES, BRANCH_MISSES,
+                 TASK_CLOCK_NS, PAGE_FAULTS, EVENT_COUNT };
+
+    PerfCounters( )
+    {
+        for( int e = 0; e < EVENT_COUNT; ++e )
+        {
+            fds_[ e ] = open( static_cast<Event>( e ) );
+            counts_[ e ] = 0;
+            if( fds_[ e ] < 0 && why_.empty( ) )
+                why_ = string( name( static_cast<Event>( e ) ) ) + ": " + strerror( errno );
+        }
+    }
+
+    PerfCounters( const PerfCounters & rhs ) = delete;
+    PerfCounters & operator=( const PerfCounters & rhs ) = delete;
+
+    ~PerfCounters( )
+    {
+#ifdef __linux__
+        for( int e = 0; e < EVENT_COUNT; ++e )
+            if( fds_[ e ] >= 0 )
+                close( fds_[ e ] );
+#endif
+    }
+
+    static const char * name( Event e )
+    {
+        static const char *names[ EVENT_COUNT ] = {
+            "cycles", "instructions", "L1d misses", "LLC misses", "dTLB misses",
+            "branch misses", "task-clock ns", "page faults" };
+        return names[ e ];
+    }
+
+    bool available( Event e ) const
+    {
+        return fds_[ e ] >= 0;
+    }
+
+    bool anyAvailable( ) const
+    {
+        for( int e = 0; e < EVENT_COUNT; ++e )
+            if( available( static_cast<Event>( e ) ) )
+                return true;
+        return false;
+    }
+
+    string unavailable( ) const
+    {
+        string names;
+        for( int e = 0; e < EVENT_COUNT; ++e )
+            if( !available( static_cast<Event>( e ) ) )
+                names += ( names.empty( ) ? "" : ", " ) + string( name( static_cast<Event>( e ) ) );
+        return names;
+    }
+
+    const string & why( ) const
+    {
+        return why_;
+    }
+
+    void start( )
+    {
+#ifdef __linux__
+        for( int e = 0; e < EVENT_COUNT; ++e )
+            if( fds_[ e ] >= 0 )
+            {
+                ioctl( fds_[ e ], PERF_EVENT_IOC_RESET, 0 );
+                ioctl( fds_[ e ], PERF_EVENT_IOC_ENABLE, 0 );
+            }
+#endif
+    }
+
+    void stop( )
+    {
+#ifdef __linux__
+        for( int e = 0; e < EVENT_COUNT; ++e )
+            if( fds_[ e ] >= 0 )
+                ioctl( fds_[ e ], PERF_EVENT_IOC_DISABLE, 0 );
+        for( int e = 0; e < EVENT_COUNT; ++e )
+        {
+            // With both time fields requested, read returns value, enabled, running
+            uint64_t values[ 3 ] = { 0, 0, 0 };
+            counts_[ e ] = 0;
+            if( fds_[ e ] < 0 || read( fds_[ e ], values, sizeof( values ) ) != sizeof( values ) )
+                continue;
+            counts_[ e ] = values[ 2 ] == 0 ? 0 : double( values[ 0 ] ) * values[ 1 ] / values[ 2 ];
+        }
+#endif
+    }
+
+    double count( Event e ) const
+    {
+        return counts_[ e ];
+    }
+
+    /**
+     * Print one line: label, then each available event's count divided
+     * by ops, or a note that no event is available.
+     */
+    void report( ostream & out, const string & label, size_t ops ) const
+    {
+        out << label << " Counters per Operation:";
+        if( !anyAvailable( ) )
+            out << " unavailable (" << why_ << ")";
+        const char *separator = " ";
+        for( int e = 0; e < EVENT_COUNT; ++e )
+        {
+            Event event = static_cast<Event>( e );
+            if( !available( event ) )
+                continue;
+            out << separator << name( event ) << " " << ( ops == 0 ? 0 : count( event ) / ops );
+            separator = ", ";
+        }
+        out << endl;
+    }
+
+  private:
+    int fds_[ EVENT_COUNT ];
+    double counts_[ EVENT_COUNT ];
+    string why_;
+
+    /**
+     * Open event e for this thread on any CPU, disabled; return the file
+     * descriptor, or -1 with errno set.
+     */
+    static int open( Event e )
+    {
+#ifdef __linux__
+        perf_event_attr attr;
+        memset( &attr, 0, sizeof( attr ) );
+        attr.size = sizeof( attr );
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        attr.type = PERF_TYPE_HARDWARE;
+        switch( e )
+        {
+          case CYCLES:        attr.config = PERF_COUNT_HW_CPU_CYCLES; break;
+          case INSTRUCTIONS:  attr.config = PERF_COUNT_HW_INSTRUCTIONS; break;
+          case LLC_MISSES:    attr.config = PERF_COUNT_HW_CACHE_MISSES; break;
+          case BRANCH_MISSES: attr.config = PERF_COUNT_HW_BRANCH_MISSES; break;
+          case L1D_MISSES:
+          case DTLB_MISSES:
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = ( e == L1D_MISSES ? PERF_COUNT_HW_CACHE_L1D : PERF_COUNT_HW_CACHE_DTLB ) |
+                          PERF_COUNT_HW_CACHE_OP_READ << 8 | PERF_COUNT_HW_CACHE_RESULT_MISS << 16;
+            break;
+          case TASK_CLOCK_NS:
+            attr.type = PERF_TYPE_SOFTWARE;
+            attr.config = PERF_COUNT_SW_TASK_CLOCK;
+            break;
+          case PAGE_FAULTS:
+            attr.type = PERF_TYPE_SOFTWARE;
+            attr.config = PERF_COUNT_SW_PAGE_FAULTS;
+            break;
+          default:
+            errno = EINVAL;
+            return -1;
+        }
+        return static_cast<int>( syscall( __NR_perf_event_open, &attr, 0, -1, -1, 0 ) );
+#else
+        errno = ENOSYS;
+        return -1;
+#endif
+    }
+};
+
+#endif
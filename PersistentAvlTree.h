@@ -0,0 +1,425 @@
+#ifndef PERSISTENT_AVL_TREE_H
+#define PERSISTENT_AVL_TREE_H
+
+#include "dsexceptions.h"
+#include "NodePool.h"
+#include "SortAndMerge.h"
+#include <cstddef>
+#include <iostream>
+#include <limits>
+#include <type_traits>
+#include <utility>
+#include <vector>
+using namespace std;
+
+// PersistentAvlTree class
+//
+// CONSTRUCTION: zero parameter
+//
+// An AVL tree that keeps every version it has ever had. Version 0 is
+// the empty tree, and each insert, replace or remove makes the next
+// version from the latest one by path copying: the nodes on the path
+// to x, and any a rotation takes apart, are copied, and everything
+// else is shared with the older versions. A version costs O( log N )
+// new nodes, so memory grows with the number of changes rather than
+// with the number of versions times their size. Any version can be
+// searched at any time.
+//
+// Nodes are arena-scoped: they live in one pool until makeEmpty or
+// the destructor frees them all, and no single version is ever freed.
+//
+// ******************PUBLIC OPERATIONS*********************
+// Version insert( x )    --> New version with x added; merge into an equal item
+// Version replace( x )   --> New version with x in place of an equal item
+// Version remove( x )    --> New version without x
+// Version bulkLoad( items ) --> New version with a batch merged in
+// Version latest( )      --> Return the newest version
+// size_t versionCount( ) --> Return the number of versions
+// Comparable * find( x, v )  --> Return item matching x in version v or nullptr
+// bool contains( x, v )  --> Return true if x is present in version v
+// size_t size( v )       --> Return number of items in version v
+// size_t for_each_in_range( lo, hi, v, visit, limit ) --> Visit items in ( lo, hi )
+// void range( lo, hi, v, out ) --> Print items in ( lo, hi ) of version v
+// size_t nodeCount( )    --> Return nodes held for all versions together
+// void makeEmpty( )      --> Drop every version but the empty version 0
+// ******************ERRORS********************************
+// Throws ArrayIndexOutOfBoundsException for a version not yet made
+
+template <typename Comparable>
+class PersistentAvlTree
+{
+  private:
+    struct AvlNode;
+
+  public:
+    typedef size_t Version;
+
+    PersistentAvlTree( ) : roots_( 1, nullptr ), nodes_{ 0 }
+      { }
+
+    PersistentAvlTree( const PersistentAvlTree & rhs ) = delete;
+    PersistentAvlTree & operator=( const PersistentAvlTree & rhs ) = delete;
+
+    ~PersistentAvlTree( )
+    {
+        makeEmpty( );
+    }
+
+    Version latest( ) const
+    {
+        return roots_.size( ) - 1;
+    }
+
+    size_t versionCount( ) const
+    {
+        return roots_.size( );
+    }
+
+    size_t nodeCount( ) const
+    {
+        return nodes_;
+    }
+
+    /**
+     * Make a new version with x inserted; an equal item absorbs x
+     * through merge. Return the new version.
+     */
+    Version insert( const Comparable & x )
+    {
+        return publish( insert( roots_.back( ), x, false ) );
+    }
+
+    /**
+     * Make a new version with x inserted, taking the place of an equal
+     * item rather than merging into it. Return the new version.
+     */
+    Version replace( const Comparable & x )
+    {
+        return publish( insert( roots_.back( ), x, true ) );
+    }
+
+    /**
+     * Make a new version without x. If x is not present the new
+     * version shares the whole tree with the one before.
+     */
+    Version remove( const Comparable & x )
+    {
+        return publish( remove( roots_.back( ), x ) );
+    }
+
+    /**
+     * Make a new version holding the items of the latest version and
+     * the batch merged together, as a perfectly balanced tree built in
+     * linear time. It shares no nodes with older versions, so it suits
+     * a first load rather than a small change.
+     */
+    Version bulkLoad( vector<Comparable> items )
+    {
+        vector<const AvlNode *> pending;
+        for( const AvlNode *t = roots_.back( ); t != nullptr || !pending.empty( ); t = t->right_ )
+        {
+            for( ; t != nullptr; t = t->left_ )
+                pending.push_back( t );
+            t = pending.back( );
+            pending.pop_back( );
+            items.push_back( t->element_ );
+        }
+        sortAndMerge( items );
+        return publish( buildBalanced( items, 0, items.size( ) ) );
+    }
+
+    /**
+     * Return the item matching x in version v, or nullptr.
+     */
+    const Comparable * find( const Comparable & x, Version v ) const
+    {
+        const AvlNode *t = rootOf( v );
+        while( t != nullptr )
+        {
+            if( x < t->element_ )
+                t = t->left_;
+            else if( t->element_ < x )
+                t = t->right_;
+            else
+                return &t->element_;
+        }
+        return nullptr;
+    }
+
+    bool contains( const Comparable & x, Version v ) const
+    {
+        return find( x, v ) != nullptr;
+    }
+
+    size_t size( Version v ) const
+    {
+        return sizeOfNode( rootOf( v ) );
+    }
+
+    bool isEmpty( Version v ) const
+    {
+        return size( v ) == 0;
+    }
+
+    /**
+     * Visit the items of version v strictly between left and right in
+     * order, stopping after limit items or once visit returns false.
+     * Return the number visited.
+     */
+    template <typename Visitor>
+    size_t for_each_in_range( const Comparable & left, const Comparable & right, Version v,
+                              Visitor visit, size_t limit = numeric_limits<size_t>::max( ) ) const
+    {
+        size_t visited = 0;
+        vector<const AvlNode *> pending;
+        for( const AvlNode *t = rootOf( v ); t != nullptr; )
+        {
+            if( left < t->element_ )
+            {
+                pending.push_back( t );
+                t = t->left_;
+            }
+            else
+                t = t->right_;
+        }
+        while( !pending.empty( ) && visited < limit )
+        {
+            const AvlNode *t = pending.back( );
+            pending.pop_back( );
+            if( !( t->element_ < right ) )
+                break;
+            ++visited;
+            if( !visit( t->element_ ) )
+                break;
+            for( t = t->right_; t != nullptr; t = t->left_ )
+                pending.push_back( t );
+        }
+        return visited;
+    }
+
+    void range( const Comparable & left, const Comparable & right, Version v,
+                ostream & out = cout ) const
+    {
+        for_each_in_range( left, right, v, [&out]( const Comparable & x ) {
+            out << x << '\n';
+            return true;
+        } );
+    }
+
+    /**
+     * Free every node and drop every version but version 0.
+     */
+    void makeEmpty( )
+    {
+        // The nodes a version made are the ones it reaches without
+        // passing through a node of an older version, so each node is
+        // destroyed once, from the version that made it
+        if( !is_trivially_destructible<AvlNode>::value )
+        {
+            vector<const AvlNode *> pending;
+            for( Version v = 1; v < roots_.size( ); ++v )
+            {
+                pending.push_back( roots_[ v ] );
+                while( !pending.empty( ) )
+                {
+                    const AvlNode *t = pending.back( );
+                    pending.pop_back( );
+                    if( t == nullptr || t->version_ != v )
+                        continue;
+                    pending.push_back( t->left_ );
+                    pending.push_back( t->right_ );
+                    pool_.destroy( const_cast<AvlNode *>( t ) );
+                }
+            }
+        }
+        roots_.assign( 1, nullptr );
+        nodes_ = 0;
+        pool_.release( );
+    }
+
+  private:
+    struct AvlNode
+    {
+        Comparable     element_;
+        const AvlNode *left_;
+        const AvlNode *right_;
+        int            height_;
+        size_t         size_;       // Items in this subtree
+        Version        version_;    // The version that made this node
+
+        AvlNode( const Comparable & ele, const AvlNode *lt, const AvlNode *rt, Version v )
+          : element_{ ele }, left_{ lt }, right_{ rt },
+            height_{ max( heightOfNode( lt ), heightOfNode( rt ) ) + 1 },
+            size_{ sizeOfNode( lt ) + sizeOfNode( rt ) + 1 }, version_{ v } { }
+
+        AvlNode( Comparable && ele, const AvlNode *lt, const AvlNode *rt, Version v )
+          : element_{ std::move( ele ) }, left_{ lt }, right_{ rt },
+            height_{ max( heightOfNode( lt ), heightOfNode( rt ) ) + 1 },
+            size_{ sizeOfNode( lt ) + sizeOfNode( rt ) + 1 }, version_{ v } { }
+    };
+
+    vector<const AvlNode *> roots_;     // roots_[ v ] is version v
+    NodePool<AvlNode> pool_;
+    size_t nodes_;
+
+    static const int ALLOWED_IMBALANCE = 1;
+
+    static int heightOfNode( const AvlNode *t )
+    {
+        return t == nullptr ? -1 : t->height_;
+    }
+
+    static size_t sizeOfNode( const AvlNode *t )
+    {
+        return t == nullptr ? 0 : t->size_;
+    }
+
+    static int max( int lhs, int rhs )
+    {
+        return lhs > rhs ? lhs : rhs;
+    }
+
+    const AvlNode * rootOf( Version v ) const
+    {
+        if( v >= roots_.size( ) )
+            throw ArrayIndexOutOfBoundsException{ };
+        return roots_[ v ];
+    }
+
+    Version publish( const AvlNode *root )
+    {
+        roots_.push_back( root );
+        return latest( );
+    }
+
+    // Every node made now belongs to the version about to be published
+    template <typename Item>
+    const AvlNode * allocate( Item && x, const AvlNode *lt, const AvlNode *rt )
+    {
+        ++nodes_;
+        return pool_.allocate( std::forward<Item>( x ), lt, rt, roots_.size( ) );
+    }
+
+    /**
+     * Return a new version of subtree t with x inserted. Nodes on the
+     * path are copied; an equal item is copied and merged with x, or
+     * replaced by x if replace is set.
+     */
+    const AvlNode * insert( const AvlNode *t, const Comparable & x, bool replace )
+    {
+        if( t == nullptr )
+            return allocate( x, nullptr, nullptr );
+        if( x < t->element_ )
+            return balance( t->element_, insert( t->left_, x, replace ), t->right_ );
+        if( t->element_ < x )
+            return balance( t->element_, t->left_, insert( t->right_, x, replace ) );
+        if( replace )
+            return allocate( x, t->left_, t->right_ );
+        Comparable merged = t->element_;
+        merged.merge( x );
+        return allocate( std::move( merged ), t->left_, t->right_ );
+    }
+
+    /**
+     * Return a new version of subtree t without x, or t itself, with
+     * nothing copied, if x is not present.
+     */
+    const AvlNode * remove( const AvlNode *t, const Comparable & x )
+    {
+        if( t == nullptr )
+            return nullptr;
+        if( x < t->element_ )
+        {
+            const AvlNode *lt = remove( t->left_, x );
+            return lt == t->left_ ? t : balance( t->element_, lt, t->right_ );
+        }
+        if( t->element_ < x )
+        {
+            const AvlNode *rt = remove( t->right_, x );
+            return rt == t->right_ ? t : balance( t->element_, t->left_, rt );
+        }
+
+        if( t->left_ == nullptr )
+            return t->right_;
+        if( t->right_ == nullptr )
+            return t->left_;
+        const AvlNode *successor = t->right_;
+        while( successor->left_ != nullptr )
+            successor = successor->left_;
+        return balance( successor->element_, t->left_, removeMin( t->right_ ) );
+    }
+
+    /**
+     * Return a new version of subtree t without its smallest item.
+     */
+    const AvlNode * removeMin( const AvlNode *t )
+    {
+        if( t->left_ == nullptr )
+            return t->right_;
+        return balance( t->element_, removeMin( t->left_ ), t->right_ );
+    }
+
+    /**
+     * Return a new node holding a copy of x over subtrees lt and rt,
+     * whose heights differ by at most two, rotating as needed. A child
+     * taken apart by a rotation is copied; the original stays in the
+     * versions that share it, or is recycled if this update made it.
+     */
+    const AvlNode * balance( const Comparable & x, const AvlNode *lt, const AvlNode *rt )
+    {
+        const AvlNode *result;
+        if( heightOfNode( lt ) - heightOfNode( rt ) > ALLOWED_IMBALANCE )
+        {
+            if( heightOfNode( lt->left_ ) >= heightOfNode( lt->right_ ) )
+                result = allocate( lt->element_, lt->left_, allocate( x, lt->right_, rt ) );
+            else
+            {
+                const AvlNode *lr = lt->right_;
+                result = allocate( lr->element_, allocate( lt->element_, lt->left_, lr->left_ ),
+                                   allocate( x, lr->right_, rt ) );
+                discard( lr );
+            }
+            discard( lt );
+        }
+        else if( heightOfNode( rt ) - heightOfNode( lt ) > ALLOWED_IMBALANCE )
+        {
+            if( heightOfNode( rt->right_ ) >= heightOfNode( rt->left_ ) )
+                result = allocate( rt->element_, allocate( x, lt, rt->left_ ), rt->right_ );
+            else
+            {
+                const AvlNode *rl = rt->left_;
+                result = allocate( rl->element_, allocate( x, lt, rl->left_ ),
+                                   allocate( rt->element_, rl->right_, rt->right_ ) );
+                discard( rl );
+            }
+            discard( rt );
+        }
+        else
+            result = allocate( x, lt, rt );
+        return result;
+    }
+
+    /**
+     * Recycle t if the update in progress made it, as no version can
+     * reach it yet.
+     */
+    void discard( const AvlNode *t )
+    {
+        if( t->version_ != roots_.size( ) )
+            return;
+        --nodes_;
+        pool_.deallocate( const_cast<AvlNode *>( t ) );
+    }
+
+    const AvlNode * buildBalanced( vector<Comparable> & items, size_t lo, size_t hi )
+    {
+        if( lo == hi )
+            return nullptr;
+        size_t mid = lo + ( hi - lo ) / 2;
+        const AvlNode *lt = buildBalanced( items, lo, mid );
+        const AvlNode *rt = buildBalanced( items, mid + 1, hi );
+        return allocate( std::move( items[ mid ] ), lt, rt );
+    }
+};
+
+#endif
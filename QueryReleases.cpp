@@ -0,0 +1,103 @@
+#include "PersistentAvlTree.h"
+#include "SequenceMap.cpp"
+#include "ReleaseDelta.h"
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdlib>
+using namespace std;
+
+// Answers "which enzymes recognized X in release N?" for several REBASE
+// releases at once. The first release is bulk loaded into a
+// PersistentAvlTree, and every later one is applied as its difference
+// from the release before, so the releases share every node their
+// changes did not touch. Each query is then answered for every release.
+//
+// With --synthetic, writes releases derived from one REBASE file
+// instead, each with a given fraction of its enzymes changed.
+
+// Turn the latest version into release next, given the release before;
+// return the number of items changed
+size_t ApplyRelease(PersistentAvlTree<SequenceMap> &tree, const vector<SequenceMap> &old,
+                    const vector<SequenceMap> &next) {
+    ReleaseDelta delta;
+    DiffReleases(old, next, delta);
+    for (size_t i = 0; i < delta.removes.size(); i++) tree.remove(delta.removes[i]);
+    for (size_t i = 0; i < delta.changes.size(); i++) tree.replace(delta.changes[i]);
+    for (size_t i = 0; i < delta.inserts.size(); i++) tree.insert(delta.inserts[i]);
+    return delta.size();
+}
+
+void AnswerQuery(const PersistentAvlTree<SequenceMap> &tree, const vector<string> &releases,
+                 const vector<PersistentAvlTree<SequenceMap>::Version> &versions, const string &input) {
+    SequenceMap to_find(input, "");
+    for (size_t r = 0; r < versions.size(); r++) {
+        const SequenceMap *found = tree.find(to_find, versions[r]);
+        cout << releases[r] << ": ";
+        if (found != nullptr) cout << *found << '\n';
+        else cout << input << " not present\n";
+    }
+}
+
+int
+main(int argc, char **argv) {
+    if (argc == 6 && string(argv[1]) == "--synthetic") {
+        if (!WriteSyntheticReleases(argv[2], argv[3], atoi(argv[4]), atof(argv[5]))) {
+            cout << "Cannot read " << argv[2] << " or write the releases" << endl;
+            return 1;
+        }
+        return 0;
+    }
+    if (argc < 3) {
+        cout << "Usage: " << argv[0] << " <queryfilename | -> <databasefilename> [databasefilename ...]" << endl;
+        cout << "       " << argv[0] << " --synthetic <databasefilename> <outprefix> <releases> <churn>" << endl;
+        return 0;
+    }
+    ios_base::sync_with_stdio(false);
+
+    PersistentAvlTree<SequenceMap> tree;
+    vector<string> releases;
+    vector<PersistentAvlTree<SequenceMap>::Version> versions;
+    vector<SequenceMap> old, next;
+    size_t separate_nodes = 0;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (int a = 2; a < argc; a++) {
+        if (!ReadRelease(argv[a], next)) {
+            cout << "Cannot read " << argv[a] << endl;
+            return 1;
+        }
+        size_t changed = next.size();
+        if (versions.empty()) tree.bulkLoad(next);
+        else changed = ApplyRelease(tree, old, next);
+        releases.push_back(argv[a]);
+        versions.push_back(tree.latest());
+        separate_nodes += next.size();
+        cerr << argv[a] << ": " << next.size() << " sequences, " << changed << " changed, version "
+             << tree.latest() << ", " << tree.nodeCount() << " nodes in all" << endl;
+        old.swap(next);
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cerr << "Loaded " << releases.size() << " releases in " << seconds << " s: " << tree.nodeCount()
+         << " nodes, against " << separate_nodes << " for a tree per release" << endl;
+
+    string line;
+    if (string(argv[1]) == "-") {
+        cout << "Type a recognition sequence per line; quit to exit." << endl;
+        while (getline(cin, line) && line != "quit") {
+            AnswerQuery(tree, releases, versions, line);
+            cout.flush();
+        }
+        return 0;
+    }
+    ifstream queries(argv[1]);
+    if (!queries) {
+        cout << "Cannot read " << argv[1] << endl;
+        return 1;
+    }
+    while (getline(queries, line))
+        if (!line.empty()) AnswerQuery(tree, releases, versions, line);
+    return 0;
+}
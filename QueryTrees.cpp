@@ -1,53 +1,78 @@
 #include "BinarySearchTree.h"
 #include "AvlTree.h"
+#include "BPlusTree.h"
+#include "RadixTrie.h"
+#include "SequenceHashMap.h"
+#include "SplayTree.h"
 #include "SequenceMap.cpp"
+#include "RebaseParser.h"
+#include "ReleaseDelta.h"
+#include "PerfCounters.h"
 
 #include <iostream>
 #include <fstream>
+#include <iterator>
 #include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <thread>
+#include <cstdlib>
 
 using namespace std;
 
-// Get enzyme acronym
-string GetEnzymeAcronym(string &db_line) {
-    size_t loc = db_line.find("/");
-    string ret = db_line.substr(0, loc);
-    //remove acronym
-    db_line = db_line.substr(loc + 1);
-    return ret;
-}
-
-// Get recognition sequence
-bool GetNextRecognitionSequence(string &db_line, string &a_reco_seq) {
-    size_t loc = db_line.find("/");
-    if (loc == string::npos || loc == db_line.size() - 1) {
-        return false;
-    }
+// Hardware counters for populating the tree, or nullptr unless --perf
+// was given; reported on cerr so that batch answers stay clean
+PerfCounters *populate_counters = nullptr;
 
-    a_reco_seq = db_line.substr(0, loc);
-    //remove sequence
-    db_line = db_line.substr(loc + 1);
+// Newer releases of the database given after --reload, applied in turn
+// to the live tree once the queries have been answered
+vector<string> reload_filenames;
 
-    return true;
-}
+// A smaller delta is applied one item at a time
+const size_t RELOAD_BATCH = 256;
 
 template<typename TreeType>
 void PopulateQueryTree(TreeType &a_tree, string &db_filename) {
-    string db_line;
-    fstream fin(db_filename.c_str());
-    for (int i = 0; i < 10; i++)
-        getline(fin, db_line);
-    // read file line by line
-    while (getline(fin, db_line)) {
-        string an_enz_acro = GetEnzymeAcronym(db_line);
-
-        string a_reco_seq;
-        while (GetNextRecognitionSequence(db_line, a_reco_seq)) {
-            SequenceMap new_sequence_map(a_reco_seq, an_enz_acro);
-            a_tree.insert(new_sequence_map);
-        }
+    if (populate_counters != nullptr) populate_counters->start();
+    vector<SequenceMap> sequence_maps;
+    if (!ReadRebaseFile(db_filename, sequence_maps)) {
+        cout << "Cannot read " << db_filename << endl;
+        exit(1);
+    }
+    // build the whole tree at once
+    a_tree.bulkLoad(std::move(sequence_maps));
+    if (populate_counters != nullptr) {
+        populate_counters->stop();
+        populate_counters->report(cerr, "Populate", a_tree.size());
     }
-    fin.close();
+}
+
+// Not const: a splay tree restructures itself on every lookup
+template <typename TreeType>
+void AnswerQuery(TreeType &a_tree, const string &input) {
+    SequenceMap to_find(input, "");
+    const SequenceMap *search_result = a_tree.find(to_find);
+    if (search_result != nullptr) {
+        cout << *search_result << '\n';
+    } else {
+        cout << "Error: " << input << " was not found in the tree\n";
+    }
+}
+
+// The trie also answers "PREFIX*", every sequence starting with PREFIX,
+// and "?PATTERN", every sequence matching an IUPAC pattern such as GANTC
+void AnswerQuery(RadixTrie<SequenceMap> &a_trie, const string &input) {
+    bool is_prefix = !input.empty() && input.back() == '*';
+    bool is_pattern = !input.empty() && input[0] == '?';
+    if (!is_prefix && !is_pattern) {
+        AnswerQuery<RadixTrie<SequenceMap> >(a_trie, input);
+        return;
+    }
+    auto print = [](const SequenceMap &item) { cout << item << '\n'; };
+    size_t found = is_prefix ? a_trie.prefix(input.substr(0, input.size() - 1), print)
+                             : a_trie.match(input.substr(1), print);
+    if (found == 0) cout << "Error: no sequence in the tree matches " << input << '\n';
 }
 
 template <typename TreeType>
@@ -55,26 +80,224 @@ void TestQueryTree(TreeType &a_tree) {
     cout << "To exit the program type in quit." << endl;
     cout << "Sequence: ";
     string input;
-    getline(cin, input);
-    while (input != "quit") {
-       SequenceMap to_find(input, "");
-       SequenceMap *search_result = a_tree.find(to_find);
+    while (getline(cin, input) && input != "quit") {
+        AnswerQuery(a_tree, input);
+        cout << "Sequence: " << flush;
+    }
+}
+
+// Append each non-empty line in [begin, end) to queries
+void SplitQueries(const char *begin, const char *end, vector<string> &queries) {
+    for (const char *line = begin; line < end;) {
+        const char *eol = FindByte(line, end, '\n');
+        const char *last = (eol > line && eol[-1] == '\r') ? eol - 1 : eol;
+        if (last > line) queries.emplace_back(line, last);
+        line = eol == end ? end : eol + 1;
+    }
+}
+
+// Read one query per line from query_filename, or from stdin if it is "-"
+bool ReadQueries(const string &query_filename, vector<string> &queries) {
+    if (query_filename == "-") {
+        string piped((istreambuf_iterator<char>(cin)), istreambuf_iterator<char>());
+        SplitQueries(piped.data(), piped.data() + piped.size(), queries);
+        return true;
+    }
+    MappedFile file(query_filename);
+    if (!file.isOpen()) return false;
+    SplitQueries(file.data(), file.data() + file.size(), queries);
+    return true;
+}
+
+// Batch mode: sort and deduplicate the queries, resolve them in one
+// traversal of the tree, then print the answers in the original order
+template <typename TreeType>
+void BatchQueryTree(TreeType &a_tree, const string &query_filename) {
+    vector<string> queries;
+    if (!ReadQueries(query_filename, queries)) {
+        cout << "Cannot read queries from " << query_filename << endl;
+        return;
+    }
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+    // Sort in tree order, then keep one key per distinct query;
+    // keys[slot[i]] is the key for queries[i]
+    vector<SequenceMap> to_find;
+    to_find.reserve(queries.size());
+    for (size_t i = 0; i < queries.size(); i++) to_find.emplace_back(queries[i], "");
+    vector<size_t> order(queries.size());
+    for (size_t i = 0; i < order.size(); i++) order[i] = i;
+    sort(order.begin(), order.end(), [&to_find](size_t a, size_t b) { return to_find[a] < to_find[b]; });
+
+    vector<SequenceMap> keys;
+    vector<size_t> slot(queries.size());
+    for (size_t i = 0; i < order.size(); i++) {
+        if (keys.empty() || keys.back() < to_find[order[i]])
+            keys.push_back(std::move(to_find[order[i]]));
+        slot[order[i]] = keys.size() - 1;
+    }
+    vector<const SequenceMap *> found;
+    a_tree.find_batch(keys, found);
+
+    for (size_t i = 0; i < queries.size(); i++) {
+        const SequenceMap *search_result = found[slot[i]];
         if (search_result != nullptr) {
-            cout << *search_result << endl;
+            cout << *search_result << '\n';
         } else {
-            cout << "Error: " + input + " was not found in the tree" << endl;
+            cout << "Error: " << queries[i] << " was not found in the tree\n";
+        }
+    }
+    cout.flush();
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cerr << queries.size() << " queries in " << seconds * 1000 << " ms, "
+         << queries.size() / seconds << " queries/sec" << endl;
+}
+
+// A trie gains nothing from sorted queries, and its prefix and pattern
+// queries can answer many lines each, so it answers in input order
+void BatchQueryTree(RadixTrie<SequenceMap> &a_trie, const string &query_filename) {
+    vector<string> queries;
+    if (!ReadQueries(query_filename, queries)) {
+        cout << "Cannot read queries from " << query_filename << endl;
+        return;
+    }
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (size_t i = 0; i < queries.size(); i++) AnswerQuery(a_trie, queries[i]);
+    cout.flush();
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cerr << queries.size() << " queries in " << seconds * 1000 << " ms, "
+         << queries.size() / seconds << " queries/sec" << endl;
+}
+
+template <typename TreeType>
+void ApplyDeltaOneByOne(TreeType &a_tree, const ReleaseDelta &delta) {
+    for (size_t i = 0; i < delta.removes.size(); i++) a_tree.remove(delta.removes[i]);
+    for (size_t i = 0; i < delta.changes.size(); i++) {
+        a_tree.remove(delta.changes[i]);
+        a_tree.insert(delta.changes[i]);
+    }
+    for (size_t i = 0; i < delta.inserts.size(); i++) a_tree.insert(delta.inserts[i]);
+}
+
+// One sorted run holding the items of two sorted runs with no key in common
+vector<SequenceMap> MergeRuns(vector<SequenceMap> &first, vector<SequenceMap> &second) {
+    vector<SequenceMap> merged;
+    merged.reserve(first.size() + second.size());
+    merge(make_move_iterator(first.begin()), make_move_iterator(first.end()),
+          make_move_iterator(second.begin()), make_move_iterator(second.end()), back_inserter(merged));
+    return merged;
+}
+
+// Changed items are removed and inserted again with their new enzymes.
+// A large delta adds its items with one bulkLoad when they are enough
+// to pay for the rebuild a bulkLoad into a full tree can mean; the
+// removals still go one at a time. Return how the delta was applied.
+template <typename TreeType>
+const char *ApplyDelta(TreeType &a_tree, ReleaseDelta &delta) {
+    size_t added = delta.inserts.size() + delta.changes.size();
+    if (delta.size() < RELOAD_BATCH || added < a_tree.size() / 8) {
+        ApplyDeltaOneByOne(a_tree, delta);
+        return "one at a time";
+    }
+    for (size_t i = 0; i < delta.removes.size(); i++) a_tree.remove(delta.removes[i]);
+    for (size_t i = 0; i < delta.changes.size(); i++) a_tree.remove(delta.changes[i]);
+    a_tree.bulkLoad(MergeRuns(delta.inserts, delta.changes));
+    return "with bulkLoad";
+}
+
+// An AvlTree takes a large delta as two set operations: the removed and
+// changed items out, then the inserted and changed items in. Each part
+// of the delta is sorted, so merging two parts gives a sorted run that
+// the trees for them are built from without a sort.
+const char *ApplyDelta(AvlTree<SequenceMap> &a_tree, ReleaseDelta &delta) {
+    if (delta.size() < RELOAD_BATCH) {
+        ApplyDeltaOneByOne(a_tree, delta);
+        return "one at a time";
+    }
+    size_t threads = max(1u, thread::hardware_concurrency());
+    AvlTree<SequenceMap> gone, added;
+    // The changed items are copied into gone, since added needs them too
+    vector<SequenceMap> changes(delta.changes);
+    gone.bulkLoad(MergeRuns(delta.removes, changes));
+    a_tree.differenceWith(std::move(gone), threads);
+    added.bulkLoad(MergeRuns(delta.inserts, delta.changes));
+    a_tree.unionWith(std::move(added), threads);
+    return "with set operations";
+}
+
+// Reload mode: bring the live tree up to date with each file in
+// reload_filenames by applying only its difference from the release
+// loaded before, answer the queries again, and compare the time taken
+// with building a new tree from the file. Reading and diffing the new
+// file does not touch the tree; only applying the delta does.
+template <typename TreeType>
+auto ReloadQueryTree(TreeType &a_tree, const string &db_filename, const string &query_filename, int)
+        -> decltype(a_tree.remove(SequenceMap("", "")), void()) {
+    vector<SequenceMap> loaded, next;
+    ReadRelease(db_filename, loaded);
+    for (size_t f = 0; f < reload_filenames.size(); f++) {
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        if (!ReadRelease(reload_filenames[f], next)) {
+            cout << "Cannot read " << reload_filenames[f] << endl;
+            return;
         }
-        cout << "Sequence: ";
-        getline(cin, input);
+        ReleaseDelta delta;
+        DiffReleases(loaded, next, delta);
+        size_t inserted = delta.inserts.size(), removed = delta.removes.size(), changed = delta.changes.size();
+        chrono::steady_clock::time_point diffed = chrono::steady_clock::now();
+        const char *how = ApplyDelta(a_tree, delta);
+        double diff_seconds = chrono::duration<double>(diffed - start).count();
+        double apply_seconds = chrono::duration<double>(chrono::steady_clock::now() - diffed).count();
+
+        start = chrono::steady_clock::now();
+        TreeType rebuilt;
+        PopulateQueryTree(rebuilt, reload_filenames[f]);
+        double rebuild_seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        cerr << "Reloaded " << reload_filenames[f] << ": " << inserted << " inserted, " << removed
+             << " removed, " << changed << " changed " << how << "; reading and diffing took "
+             << diff_seconds * 1000 << " ms, applying " << apply_seconds * 1000 << " ms, and a full rebuild takes "
+             << rebuild_seconds * 1000 << " ms" << endl;
+        loaded.swap(next);
+        BatchQueryTree(a_tree, query_filename);
     }
 }
+
+template <typename TreeType>
+void ReloadQueryTree(TreeType &, const string &, const string &, long) {
+    cout << "This tree type cannot be reloaded in place" << endl;
+}
+
+template <typename TreeType>
+void RunQueries(TreeType &a_tree, int argc, char **argv) {
+    if (argc == 4)
+        BatchQueryTree(a_tree, argv[3]);
+    else
+        TestQueryTree(a_tree);
+    if (argc == 4 && !reload_filenames.empty())
+        ReloadQueryTree(a_tree, argv[1], argv[3], 0);
+}
 // Sample main for program queryTrees
 int
 main(int argc, char **argv) {
-    if (argc != 3) {
-        cout << "Usage: " << argv[0] << " <databasefilename> <tree-type>" << endl;
+    if (argc > 2 && string(argv[argc - 1]) == "--perf") {
+        static PerfCounters counters;
+        populate_counters = &counters;
+        if (!counters.unavailable().empty())
+            cerr << "Unavailable counters: " << counters.unavailable() << " (" << counters.why() << ")" << endl;
+        argc--;
+    }
+    for (int i = 4; i < argc; i++) {
+        if (string(argv[i]) != "--reload") continue;
+        reload_filenames.assign(argv + i + 1, argv + argc);
+        argc = i;
+    }
+    if (argc != 3 && argc != 4) {
+        cout << "Usage: " << argv[0] << " <databasefilename> <tree-type> [queryfilename | -]"
+             << " [--reload databasefilename ...] [--perf]" << endl;
         return 0;
     }
+    // Batch answers can run to many lines; let cout buffer them
+    ios_base::sync_with_stdio(false);
     string db_filename(argv[1]);
     string param_tree(argv[2]);
     cout << "Input filename is " << db_filename << endl;
@@ -82,14 +305,43 @@ main(int argc, char **argv) {
         cout << "I will run the BST code" << endl;
         BinarySearchTree<SequenceMap> a_tree;
         PopulateQueryTree(a_tree, db_filename);
-        TestQueryTree(a_tree);
+        RunQueries(a_tree, argc, argv);
     } else if (param_tree == "AVL") {
         cout << "I will run the AVL code" << endl;
         AvlTree<SequenceMap> a_tree;
         PopulateQueryTree(a_tree, db_filename);
-        TestQueryTree(a_tree);
+        RunQueries(a_tree, argc, argv);
+    } else if (param_tree == "BTREE") {
+        cout << "I will run the BTREE code" << endl;
+        BPlusTree<SequenceMap> a_tree;
+        PopulateQueryTree(a_tree, db_filename);
+        RunQueries(a_tree, argc, argv);
+    } else if (param_tree == "FROZEN") {
+        cout << "I will run the FROZEN code" << endl;
+        AvlTree<SequenceMap> a_tree;
+        PopulateQueryTree(a_tree, db_filename);
+        FrozenTree<SequenceMap> frozen_tree = a_tree.freeze();
+        a_tree.makeEmpty();
+        RunQueries(frozen_tree, argc, argv);
+    } else if (param_tree == "TRIE") {
+        cout << "I will run the TRIE code" << endl;
+        RadixTrie<SequenceMap> a_trie;
+        PopulateQueryTree(a_trie, db_filename);
+        RunQueries(a_trie, argc, argv);
+    } else if (param_tree == "HASH") {
+        cout << "I will run the HASH code" << endl;
+        SequenceHashMap<SequenceMap> a_map;
+        PopulateQueryTree(a_map, db_filename);
+        RunQueries(a_map, argc, argv);
+    } else if (param_tree == "SPLAY" || param_tree == "SEMISPLAY") {
+        cout << "I will run the " << param_tree << " code" << endl;
+        SplayTree<SequenceMap> a_tree(param_tree == "SPLAY" ? SplayTree<SequenceMap>::FULL_SPLAY
+                                                            : SplayTree<SequenceMap>::SEMI_SPLAY);
+        PopulateQueryTree(a_tree, db_filename);
+        RunQueries(a_tree, argc, argv);
     } else {
-        cout << "Unknown tree type " << param_tree << " (User should provide BST, or AVL)" << endl;
+        cout << "Unknown tree type " << param_tree
+             << " (User should provide BST, AVL, BTREE, FROZEN, TRIE, HASH, SPLAY, or SEMISPLAY)" << endl;
     }
     return 0;
 }
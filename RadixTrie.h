@@ -0,0 +1,649 @@
+#ifndef RADIX_TRIE_H
+#define RADIX_TRIE_H
+
+#include "SortAndMerge.h"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+using namespace std;
+
+// RadixTrie class
+//
+// CONSTRUCTION: zero parameter, or a range of items to bulk-load
+//
+// An adaptive radix trie over the recognition sequence of each item.
+// Comparable must provide getRecognitionSequence( ), the key as a
+// string, and merge, which absorbs an item with the same key.
+//
+// Each node holds the run of key bytes leading to it from its parent,
+// beyond the byte that selects it, so chains of single children are
+// collapsed into one node. A node grows through four sizes as children
+// are added: 4 and 16 children kept as sorted byte arrays, 48 behind a
+// 256-entry index, and a direct array of 256. A node with no children
+// is a leaf and has no child array at all. Children are visited in
+// byte order, which is the order std::string compares keys in, so
+// enumerations come out in the same order as the other trees.
+//
+// match treats the query as an IUPAC pattern. A query symbol matches
+// any key symbol that names a subset of its bases: N matches A, C, G,
+// T, R, Y, ... and N itself, R matches A, G and R, and A matches only A.
+// Any other byte matches only itself. A cut mark ' in a key is skipped
+// unless the pattern has one in the same place, so GAATTC finds
+// G'AATTC. The pattern is expanded one symbol at a time as the trie is
+// walked, so only the branches that can still match are visited.
+//
+// ******************PUBLIC OPERATIONS*********************
+// void insert( x )       --> Insert x; merge into an item with the same key
+// void bulkLoad( items ) --> Insert a batch of items
+// bool contains( x )     --> Return true if x is present
+// Comparable * find( x ) --> Return item with the key of x, or nullptr
+// void find_batch( queries, found ) --> Look up each query
+// size_t prefix( p, visit ) --> Visit items whose key starts with p
+// size_t match( pattern, visit ) --> Visit items whose key matches pattern
+// void forEach( visit )  --> Call visit on each item in key order
+// size_t size( )         --> Return number of items
+// boolean isEmpty( )     --> Return true if empty; else false
+// void makeEmpty( )      --> Remove all items
+// void nodeCounts( counts ) --> Count nodes of each size
+
+template <typename Comparable>
+class RadixTrie
+{
+  public:
+    // Node sizes, in the order a node grows through them
+    enum NodeType : uint8_t { LEAF, NODE4, NODE16, NODE48, NODE256, NODE_TYPES };
+
+    RadixTrie( ) : root_{ nullptr }, size_{ 0 }
+      { }
+
+    template <typename Iterator>
+    RadixTrie( Iterator first, Iterator last ) : root_{ nullptr }, size_{ 0 }
+    {
+        bulkLoad( vector<Comparable>( first, last ) );
+    }
+
+    RadixTrie( const RadixTrie & rhs ) = delete;
+    RadixTrie & operator=( const RadixTrie & rhs ) = delete;
+
+    ~RadixTrie( )
+    {
+        makeEmpty( );
+    }
+
+    void insert( const Comparable & x )
+    {
+        insert( x.getRecognitionSequence( ), Comparable( x ) );
+    }
+
+    void insert( Comparable && x )
+    {
+        string key = x.getRecognitionSequence( );
+        insert( key, std::move( x ) );
+    }
+
+    /**
+     * Add a batch of items. Items with the same key are merged in their
+     * original order, as if inserted one at a time, and the rest go in
+     * in key order, which keeps the trie's inserts close together.
+     */
+    void bulkLoad( vector<Comparable> items )
+    {
+        sortAndMerge( items );
+        for( size_t i = 0; i < items.size( ); ++i )
+            insert( std::move( items[ i ] ) );
+    }
+
+    bool contains( const Comparable & x ) const
+    {
+        return find( x ) != nullptr;
+    }
+
+    const Comparable * find( const Comparable & x ) const
+    {
+        const Node *n = descend( x.getRecognitionSequence( ), true );
+        return n == nullptr ? nullptr : n->value_;
+    }
+
+    Comparable * find( const Comparable & x )
+    {
+        const Node *n = descend( x.getRecognitionSequence( ), true );
+        return n == nullptr ? nullptr : n->value_;
+    }
+
+    /**
+     * A trie lookup does not get cheaper when its neighbour was just
+     * looked up, so each query is resolved on its own.
+     */
+    void find_batch( const vector<Comparable> & queries, vector<const Comparable *> & found ) const
+    {
+        found.resize( queries.size( ) );
+        for( size_t i = 0; i < queries.size( ); ++i )
+            found[ i ] = find( queries[ i ] );
+    }
+
+    /**
+     * Call visit on every item whose key begins with p, in key order.
+     * Return the number of items visited.
+     */
+    template <typename Visit>
+    size_t prefix( const string & p, Visit visit ) const
+    {
+        const Node *n = descend( p, false );
+        return n == nullptr ? 0 : visitAll( n, visit );
+    }
+
+    /**
+     * Call visit on every item whose key matches pattern symbol by
+     * symbol, apart from skipped cut marks, in key order. Return the
+     * number of items visited.
+     */
+    template <typename Visit>
+    size_t match( const string & pattern, Visit visit ) const
+    {
+        return root_ == nullptr ? 0 : match( root_, pattern, 0, visit );
+    }
+
+    template <typename Visit>
+    void forEach( Visit visit ) const
+    {
+        if( root_ != nullptr )
+            visitAll( root_, visit );
+    }
+
+    size_t size( ) const
+    {
+        return size_;
+    }
+
+    bool isEmpty( ) const
+    {
+        return size_ == 0;
+    }
+
+    void makeEmpty( )
+    {
+        freeSubtree( root_ );
+        root_ = nullptr;
+        size_ = 0;
+    }
+
+    /**
+     * Set counts[ t ] to the number of nodes of type t.
+     */
+    void nodeCounts( size_t counts[ NODE_TYPES ] ) const
+    {
+        for( int t = 0; t < NODE_TYPES; ++t )
+            counts[ t ] = 0;
+        countNodes( root_, counts );
+    }
+
+  private:
+    struct Node
+    {
+        NodeType type_;
+        uint16_t count_;            // Number of children
+        string prefix_;             // Key bytes after the selecting byte
+        Comparable *value_;         // Item whose key ends here, or nullptr
+
+        explicit Node( NodeType type ) : type_{ type }, count_{ 0 }, value_{ nullptr }
+          { }
+    };
+
+    struct Node4 : Node
+    {
+        unsigned char keys_[ 4 ];   // Sorted
+        Node *children_[ 4 ];
+
+        Node4( ) : Node{ NODE4 }
+          { }
+    };
+
+    struct Node16 : Node
+    {
+        unsigned char keys_[ 16 ];  // Sorted
+        Node *children_[ 16 ];
+
+        Node16( ) : Node{ NODE16 }
+          { }
+    };
+
+    struct Node48 : Node
+    {
+        unsigned char index_[ 256 ];    // Slot + 1 of each byte's child; 0 if none
+        Node *children_[ 48 ];
+
+        Node48( ) : Node{ NODE48 }
+          { memset( index_, 0, sizeof( index_ ) ); }
+    };
+
+    struct Node256 : Node
+    {
+        Node *children_[ 256 ];
+
+        Node256( ) : Node{ NODE256 }
+        {
+            for( int c = 0; c < 256; ++c )
+                children_[ c ] = nullptr;
+        }
+    };
+
+    Node *root_;
+    size_t size_;
+
+    /**
+     * Internal method to insert x under key. A node whose prefix
+     * disagrees with the key is split where they part.
+     */
+    void insert( const string & key, Comparable && x )
+    {
+        Node **link = &root_;
+        size_t depth = 0;
+        for( ; ; )
+        {
+            Node *n = *link;
+            if( n == nullptr )
+            {
+                *link = newLeaf( key, depth, std::move( x ) );
+                return;
+            }
+
+            size_t common = 0;
+            while( common < n->prefix_.size( ) && depth + common < key.size( ) &&
+                   n->prefix_[ common ] == key[ depth + common ] )
+                ++common;
+            if( common < n->prefix_.size( ) )
+            {
+                Node *split = new Node4;
+                split->prefix_ = n->prefix_.substr( 0, common );
+                unsigned char edge = n->prefix_[ common ];
+                n->prefix_.erase( 0, common + 1 );
+                *link = split;
+                addChild( *link, edge, n );
+                depth += common;
+                if( depth == key.size( ) )
+                {
+                    split->value_ = new Comparable( std::move( x ) );
+                    ++size_;
+                }
+                else
+                    addChild( *link, key[ depth ], newLeaf( key, depth + 1, std::move( x ) ) );
+                return;
+            }
+
+            depth += common;
+            if( depth == key.size( ) )
+            {
+                if( n->value_ != nullptr )
+                    n->value_->merge( x );
+                else
+                {
+                    n->value_ = new Comparable( std::move( x ) );
+                    ++size_;
+                }
+                return;
+            }
+
+            Node **child = childLink( n, key[ depth ] );
+            if( child == nullptr )
+            {
+                addChild( *link, key[ depth ], newLeaf( key, depth + 1, std::move( x ) ) );
+                return;
+            }
+            link = child;
+            ++depth;
+        }
+    }
+
+    Node * newLeaf( const string & key, size_t depth, Comparable && x )
+    {
+        Node *leaf = new Node{ LEAF };
+        leaf->prefix_.assign( key, depth, string::npos );
+        leaf->value_ = new Comparable( std::move( x ) );
+        ++size_;
+        return leaf;
+    }
+
+    /**
+     * Walk the path spelled by key. Return the node where key ends,
+     * or nullptr if the trie has no such path. If exact is false, key
+     * may also end partway through a node's prefix.
+     */
+    const Node * descend( const string & key, bool exact ) const
+    {
+        const Node *n = root_;
+        size_t depth = 0;
+        while( n != nullptr )
+        {
+            size_t length = n->prefix_.size( );
+            if( depth + length > key.size( ) )
+            {
+                if( exact )
+                    return nullptr;
+                length = key.size( ) - depth;
+            }
+            if( n->prefix_.compare( 0, length, key, depth, length ) != 0 )
+                return nullptr;
+            depth += length;
+            if( depth == key.size( ) )
+                return n;
+            Node * const *child = childLink( const_cast<Node *>( n ), key[ depth ] );
+            n = child == nullptr ? nullptr : *child;
+            ++depth;
+        }
+        return nullptr;
+    }
+
+    /**
+     * Return the link to the child of n selected by byte c, or nullptr.
+     */
+    static Node ** childLink( Node *n, unsigned char c )
+    {
+        switch( n->type_ )
+        {
+          case NODE4:
+          {
+            Node4 *n4 = static_cast<Node4 *>( n );
+            for( int i = 0; i < n->count_; ++i )
+                if( n4->keys_[ i ] == c )
+                    return &n4->children_[ i ];
+            return nullptr;
+          }
+          case NODE16:
+          {
+            Node16 *n16 = static_cast<Node16 *>( n );
+            for( int i = 0; i < n->count_ && n16->keys_[ i ] <= c; ++i )
+                if( n16->keys_[ i ] == c )
+                    return &n16->children_[ i ];
+            return nullptr;
+          }
+          case NODE48:
+          {
+            Node48 *n48 = static_cast<Node48 *>( n );
+            return n48->index_[ c ] == 0 ? nullptr : &n48->children_[ n48->index_[ c ] - 1 ];
+          }
+          case NODE256:
+          {
+            Node256 *n256 = static_cast<Node256 *>( n );
+            return n256->children_[ c ] == nullptr ? nullptr : &n256->children_[ c ];
+          }
+          default:
+            return nullptr;
+        }
+    }
+
+    /**
+     * Add child under byte c to the node at link, which has no child
+     * there yet. A full node is first replaced by one of the next size.
+     */
+    static void addChild( Node * & link, unsigned char c, Node *child )
+    {
+        Node *n = link;
+        if( n->type_ == LEAF || ( n->type_ == NODE4 && n->count_ == 4 ) ||
+            ( n->type_ == NODE16 && n->count_ == 16 ) || ( n->type_ == NODE48 && n->count_ == 48 ) )
+            link = n = grow( n );
+
+        switch( n->type_ )
+        {
+          case NODE4:
+            insertSorted( static_cast<Node4 *>( n )->keys_, static_cast<Node4 *>( n )->children_,
+                          n->count_, c, child );
+            break;
+          case NODE16:
+            insertSorted( static_cast<Node16 *>( n )->keys_, static_cast<Node16 *>( n )->children_,
+                          n->count_, c, child );
+            break;
+          case NODE48:
+          {
+            Node48 *n48 = static_cast<Node48 *>( n );
+            n48->children_[ n->count_ ] = child;
+            n48->index_[ c ] = static_cast<unsigned char>( n->count_ + 1 );
+            break;
+          }
+          default:
+            static_cast<Node256 *>( n )->children_[ c ] = child;
+            break;
+        }
+        ++n->count_;
+    }
+
+    static void insertSorted( unsigned char *keys, Node **children, int count,
+                              unsigned char c, Node *child )
+    {
+        int i = count;
+        for( ; i > 0 && keys[ i - 1 ] > c; --i )
+        {
+            keys[ i ] = keys[ i - 1 ];
+            children[ i ] = children[ i - 1 ];
+        }
+        keys[ i ] = c;
+        children[ i ] = child;
+    }
+
+    /**
+     * Return a node of the next size holding everything n held, and
+     * delete n.
+     */
+    static Node * grow( Node *n )
+    {
+        Node *bigger;
+        switch( n->type_ )
+        {
+          case LEAF:
+            bigger = new Node4;
+            break;
+          case NODE4:
+          {
+            Node4 *n4 = static_cast<Node4 *>( n );
+            Node16 *n16 = new Node16;
+            memcpy( n16->keys_, n4->keys_, n->count_ );
+            memcpy( n16->children_, n4->children_, n->count_ * sizeof( Node * ) );
+            bigger = n16;
+            break;
+          }
+          case NODE16:
+          {
+            Node16 *n16 = static_cast<Node16 *>( n );
+            Node48 *n48 = new Node48;
+            for( int i = 0; i < n->count_; ++i )
+            {
+                n48->children_[ i ] = n16->children_[ i ];
+                n48->index_[ n16->keys_[ i ] ] = static_cast<unsigned char>( i + 1 );
+            }
+            bigger = n48;
+            break;
+          }
+          default:
+          {
+            Node48 *n48 = static_cast<Node48 *>( n );
+            Node256 *n256 = new Node256;
+            for( int c = 0; c < 256; ++c )
+                if( n48->index_[ c ] != 0 )
+                    n256->children_[ c ] = n48->children_[ n48->index_[ c ] - 1 ];
+            bigger = n256;
+            break;
+          }
+        }
+        bigger->count_ = n->count_;
+        bigger->prefix_ = std::move( n->prefix_ );
+        bigger->value_ = n->value_;
+        n->value_ = nullptr;
+        freeNode( n );
+        return bigger;
+    }
+
+    /**
+     * Call visit( c, child ) for each child of n in byte order.
+     */
+    template <typename Visit>
+    static void forEachChild( const Node *n, Visit visit )
+    {
+        switch( n->type_ )
+        {
+          case NODE4:
+            for( int i = 0; i < n->count_; ++i )
+                visit( static_cast<const Node4 *>( n )->keys_[ i ],
+                       static_cast<const Node4 *>( n )->children_[ i ] );
+            break;
+          case NODE16:
+            for( int i = 0; i < n->count_; ++i )
+                visit( static_cast<const Node16 *>( n )->keys_[ i ],
+                       static_cast<const Node16 *>( n )->children_[ i ] );
+            break;
+          case NODE48:
+          {
+            const Node48 *n48 = static_cast<const Node48 *>( n );
+            for( int c = 0; c < 256; ++c )
+                if( n48->index_[ c ] != 0 )
+                    visit( static_cast<unsigned char>( c ), n48->children_[ n48->index_[ c ] - 1 ] );
+            break;
+          }
+          case NODE256:
+          {
+            const Node256 *n256 = static_cast<const Node256 *>( n );
+            for( int c = 0; c < 256; ++c )
+                if( n256->children_[ c ] != nullptr )
+                    visit( static_cast<unsigned char>( c ), n256->children_[ c ] );
+            break;
+          }
+          default:
+            break;
+        }
+    }
+
+    /**
+     * Visit every item under n in key order; a key ending at n is a
+     * prefix of every key below it, so it comes first.
+     */
+    template <typename Visit>
+    static size_t visitAll( const Node *n, Visit & visit )
+    {
+        size_t visited = 0;
+        if( n->value_ != nullptr )
+        {
+            visit( *n->value_ );
+            ++visited;
+        }
+        forEachChild( n, [&visit, &visited]( unsigned char, const Node *child ) {
+            visited += visitAll( child, visit );
+        } );
+        return visited;
+    }
+
+    /**
+     * Internal method to match the key bytes from the start of the
+     * prefix of n on, against pattern from position depth.
+     */
+    template <typename Visit>
+    static size_t match( const Node *n, const string & pattern, size_t depth, Visit & visit )
+    {
+        for( size_t i = 0; i < n->prefix_.size( ); ++i )
+            if( !advance( pattern, depth, n->prefix_[ i ] ) )
+                return 0;
+
+        size_t visited = 0;
+        if( depth == pattern.size( ) && n->value_ != nullptr )
+        {
+            visit( *n->value_ );
+            ++visited;
+        }
+        forEachChild( n, [&]( unsigned char c, const Node *child ) {
+            size_t next = depth;
+            if( advance( pattern, next, c ) )
+                visited += match( child, pattern, next, visit );
+        } );
+        return visited;
+    }
+
+    /**
+     * Consume key byte c: step past pattern[ depth ] if c matches it,
+     * or skip c if it is a cut mark. Return false if c cannot match.
+     */
+    static bool advance( const string & pattern, size_t & depth, char c )
+    {
+        if( depth < pattern.size( ) && symbolMatches( pattern[ depth ], c ) )
+        {
+            ++depth;
+            return true;
+        }
+        return c == '\'';
+    }
+
+    /**
+     * The bases named by an IUPAC code as a bit set, A = 1, C = 2,
+     * G = 4, T = 8; 0 for any other byte.
+     */
+    static int bases( char c )
+    {
+        switch( c )
+        {
+          case 'A': return 1;
+          case 'C': return 2;
+          case 'G': return 4;
+          case 'T': return 8;
+          case 'M': return 1 | 2;
+          case 'R': return 1 | 4;
+          case 'W': return 1 | 8;
+          case 'S': return 2 | 4;
+          case 'Y': return 2 | 8;
+          case 'K': return 4 | 8;
+          case 'V': return 1 | 2 | 4;
+          case 'H': return 1 | 2 | 8;
+          case 'D': return 1 | 4 | 8;
+          case 'B': return 2 | 4 | 8;
+          case 'N': return 1 | 2 | 4 | 8;
+          default: return 0;
+        }
+    }
+
+    /**
+     * Return true if key symbol c names a subset of the bases of query
+     * symbol q.
+     */
+    static bool symbolMatches( char q, char c )
+    {
+        if( q == c )
+            return true;
+        int queryBases = bases( q ), keyBases = bases( c );
+        return keyBases != 0 && ( keyBases & ~queryBases ) == 0;
+    }
+
+    static void countNodes( const Node *n, size_t counts[ NODE_TYPES ] )
+    {
+        if( n == nullptr )
+            return;
+        ++counts[ n->type_ ];
+        forEachChild( n, [counts]( unsigned char, const Node *child ) { countNodes( child, counts ); } );
+    }
+
+    static void freeSubtree( Node *n )
+    {
+        if( n == nullptr )
+            return;
+        forEachChild( n, []( unsigned char, const Node *child ) {
+            freeSubtree( const_cast<Node *>( child ) );
+        } );
+        delete n->value_;
+        freeNode( n );
+    }
+
+    /**
+     * Delete n as the type it was allocated as.
+     */
+    static void freeNode( Node *n )
+    {
+        switch( n->type_ )
+        {
+          case NODE4: delete static_cast<Node4 *>( n ); break;
+          case NODE16: delete static_cast<Node16 *>( n ); break;
+          case NODE48: delete static_cast<Node48 *>( n ); break;
+          case NODE256: delete static_cast<Node256 *>( n ); break;
+          default: delete n; break;
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,180 @@
+#ifndef REBASE_PARSER_H
+#define REBASE_PARSER_H
+
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+using namespace std;
+
+// REBASE parser
+//
+// A REBASE file starts with a 10-line header, followed by one enzyme
+// per line:
+//     AarI/CACCTGCNNNN'NNNN/'NNNNNNNNGCAGGTG//
+// i.e. the enzyme acronym, then its recognition sequences, each ended
+// by '/', with an empty field closing the line.
+//
+// The file is memory-mapped and scanned in place with memchr, which
+// glibc vectorizes, so no line or token is ever copied. Each token is
+// handed to the caller as a pointer into the mapping plus a length.
+//
+// ******************PUBLIC OPERATIONS*********************
+// bool ParseRebaseFile( name, visit ) --> Call visit for every pair in a file
+// bool ReadRebaseFile( name, items ) --> Read every pair in a file into items
+// size_t ParseRebase( begin, end, visit ) --> Same, over a buffer
+//
+// visit( enzyme, enzyme_length, sequence, sequence_length ) is called
+// once per recognition sequence, in file order.
+
+// Number of header lines before the first enzyme
+const int REBASE_HEADER_LINES = 10;
+
+// MappedFile class
+//
+// CONSTRUCTION: with a file name
+//
+// Read-only private mapping of a whole file, unmapped on destruction.
+// isOpen( ) is false if the file could not be opened or mapped.
+class MappedFile
+{
+  public:
+    explicit MappedFile( const string & filename )
+      : data_{ nullptr }, size_{ 0 }, open_{ false }
+    {
+        int fd = ::open( filename.c_str( ), O_RDONLY );
+        if( fd < 0 )
+            return;
+        struct stat info;
+        if( fstat( fd, &info ) == 0 )
+        {
+            size_ = static_cast<size_t>( info.st_size );
+            if( size_ == 0 )
+                open_ = true;
+            else
+            {
+                void *mapping = mmap( nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0 );
+                if( mapping != MAP_FAILED )
+                {
+                    madvise( mapping, size_, MADV_SEQUENTIAL );
+                    data_ = static_cast<const char *>( mapping );
+                    open_ = true;
+                }
+                else
+                    size_ = 0;
+            }
+        }
+        ::close( fd );
+    }
+
+    MappedFile( const MappedFile & rhs ) = delete;
+    MappedFile & operator=( const MappedFile & rhs ) = delete;
+
+    ~MappedFile( )
+    {
+        if( data_ != nullptr )
+            munmap( const_cast<char *>( data_ ), size_ );
+    }
+
+    const char * data( ) const
+    {
+        return data_;
+    }
+
+    size_t size( ) const
+    {
+        return size_;
+    }
+
+    bool isOpen( ) const
+    {
+        return open_;
+    }
+
+  private:
+    const char *data_;
+    size_t size_;
+    bool open_;
+};
+
+/**
+ * Return the position of the first c in [ begin, end ), or end.
+ */
+inline const char * FindByte( const char *begin, const char *end, char c )
+{
+    const void *found = memchr( begin, c, end - begin );
+    return found == nullptr ? end : static_cast<const char *>( found );
+}
+
+/**
+ * Parse the REBASE records in [ begin, end ), skipping the header.
+ * Return the number of recognition sequences visited.
+ */
+template <typename Visitor>
+size_t ParseRebase( const char *begin, const char *end, Visitor visit )
+{
+    const char *line = begin;
+    for( int i = 0; i < REBASE_HEADER_LINES && line < end; i++ )
+    {
+        const char *eol = FindByte( line, end, '\n' );
+        line = eol == end ? end : eol + 1;
+    }
+
+    size_t visited = 0;
+    while( line < end )
+    {
+        const char *eol = FindByte( line, end, '\n' );
+        const char *last = ( eol > line && eol[ -1 ] == '\r' ) ? eol - 1 : eol;
+
+        const char *enzyme = line;
+        const char *field = FindByte( line, last, '/' );
+        size_t enzyme_length = field - enzyme;
+        while( field < last )
+        {
+            const char *sequence = field + 1;
+            field = FindByte( sequence, last, '/' );
+            if( field == last || field == sequence )
+                break;  // Unterminated or empty field ends the record
+            visit( enzyme, enzyme_length, sequence, static_cast<size_t>( field - sequence ) );
+            visited++;
+        }
+        line = eol == end ? end : eol + 1;
+    }
+    return visited;
+}
+
+/**
+ * Parse the REBASE file db_filename.
+ * Return false if it could not be opened.
+ */
+template <typename Visitor>
+bool ParseRebaseFile( const string & db_filename, Visitor visit )
+{
+    MappedFile file( db_filename );
+    if( !file.isOpen( ) )
+        return false;
+    ParseRebase( file.data( ), file.data( ) + file.size( ), visit );
+    return true;
+}
+
+/**
+ * Read the REBASE file db_filename into items, one per recognition
+ * sequence in file order, each built from ( sequence, sequence_length,
+ * enzyme, enzyme_length ) as SequenceMap is.
+ * Return false if it could not be opened.
+ */
+template <typename Item>
+bool ReadRebaseFile( const string & db_filename, vector<Item> & items )
+{
+    items.clear( );
+    return ParseRebaseFile( db_filename, [&items]( const char *enzyme, size_t enzyme_length,
+                                                   const char *sequence, size_t sequence_length ) {
+        items.emplace_back( sequence, sequence_length, enzyme, enzyme_length );
+    } );
+}
+
+#endif
@@ -0,0 +1,167 @@
+#ifndef RELEASE_DELTA_H
+#define RELEASE_DELTA_H
+
+#include "RebaseParser.h"
+#include "SequenceMap.h"
+#include "SortAndMerge.h"
+#include <cstdio>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+using namespace std;
+
+// REBASE release deltas
+//
+// A release is read as one item per recognition sequence, in sorted
+// order, each listing its enzymes in file order, just as a tree loaded
+// from the file holds them. Two releases read that way are compared in
+// one merge pass into the items to insert, to remove, and to change,
+// whose enzyme lists differ.
+//
+// Synthetic releases for testing start from a real file and change a
+// fraction of its enzymes per release: each chosen enzyme is dropped,
+// has one recognition sequence mutated, or gains a new sibling enzyme
+// with a mutated sequence, in equal proportions.
+//
+// ******************PUBLIC OPERATIONS*********************
+// bool ReadRelease( name, items ) --> Read a file as sorted, merged items
+// void DiffReleases( old, next, delta ) --> Find what turns old into next
+// bool WriteSyntheticReleases( name, prefix, count, churn ) --> Write count releases
+
+// What turns one release into the next; changes hold the new items
+struct ReleaseDelta
+{
+    vector<SequenceMap> inserts;
+    vector<SequenceMap> removes;
+    vector<SequenceMap> changes;
+
+    size_t size( ) const
+    {
+        return inserts.size( ) + removes.size( ) + changes.size( );
+    }
+};
+
+/**
+ * Read the REBASE file db_filename into items, one per recognition
+ * sequence, sorted. Return false if it could not be opened.
+ */
+inline bool ReadRelease( const string & db_filename, vector<SequenceMap> & items )
+{
+    bool opened = ReadRebaseFile( db_filename, items );
+    sortAndMerge( items );
+    return opened;
+}
+
+/**
+ * Compare two releases read by ReadRelease and fill delta with the
+ * items only next has, those only old has, and next's copy of those
+ * whose enzymes differ. O( old + next ).
+ */
+inline void DiffReleases( const vector<SequenceMap> & old, const vector<SequenceMap> & next,
+                          ReleaseDelta & delta )
+{
+    delta.inserts.clear( );
+    delta.removes.clear( );
+    delta.changes.clear( );
+    size_t i = 0, j = 0;
+    while( i < old.size( ) || j < next.size( ) )
+    {
+        if( j == next.size( ) || ( i < old.size( ) && old[ i ] < next[ j ] ) )
+            delta.removes.push_back( old[ i++ ] );
+        else if( i == old.size( ) || next[ j ] < old[ i ] )
+            delta.inserts.push_back( next[ j++ ] );
+        else
+        {
+            if( !old[ i ].sameEnzymes( next[ j ] ) )
+                delta.changes.push_back( next[ j ] );
+            ++i;
+            ++j;
+        }
+    }
+}
+
+/**
+ * Write releases prefix.0.txt, a copy of db_filename, through
+ * prefix.count.txt, each changing about churn of the enzymes of the
+ * one before. Return false if a file could not be read or written.
+ */
+inline bool WriteSyntheticReleases( const string & db_filename, const string & prefix,
+                                    int count, double churn )
+{
+    // Each record is an enzyme and its recognition sequences
+    vector<pair<string, vector<string> > > records;
+    const char *last_enzyme = nullptr;
+    bool opened = ParseRebaseFile( db_filename, [&]( const char *enzyme, size_t enzyme_length,
+                                                     const char *sequence, size_t sequence_length ) {
+        if( enzyme != last_enzyme )
+            records.push_back( make_pair( string( enzyme, enzyme_length ), vector<string>( ) ) );
+        last_enzyme = enzyme;
+        records.back( ).second.push_back( string( sequence, sequence_length ) );
+    } );
+    if( !opened )
+        return false;
+
+    mt19937 random( 1 );
+    uniform_real_distribution<double> chance( 0.0, 1.0 );
+    // Change one base, skipping the cut marks
+    auto mutate = [&random]( string sequence ) {
+        size_t i = random( ) % sequence.size( );
+        while( sequence[ i ] == '\'' || sequence[ i ] == '^' )
+            i = ( i + 1 ) % sequence.size( );
+        char base;
+        do
+            base = "ACGT"[ random( ) % 4 ];
+        while( base == sequence[ i ] );
+        sequence[ i ] = base;
+        return sequence;
+    };
+
+    for( int release = 0; release <= count; ++release )
+    {
+        if( release > 0 )
+        {
+            vector<pair<string, vector<string> > > next;
+            for( size_t r = 0; r < records.size( ); ++r )
+            {
+                if( chance( random ) >= churn )
+                {
+                    next.push_back( records[ r ] );
+                    continue;
+                }
+                int action = random( ) % 3;
+                if( action == 1 )
+                {
+                    next.push_back( records[ r ] );
+                    string & sequence = next.back( ).second[ random( ) % next.back( ).second.size( ) ];
+                    sequence = mutate( sequence );
+                }
+                else if( action == 2 )
+                {
+                    next.push_back( records[ r ] );
+                    string name = records[ r ].first + "." + to_string( release ) + "." + to_string( r );
+                    next.push_back( make_pair( name, vector<string>( 1, mutate( records[ r ].second[ 0 ] ) ) ) );
+                }
+            }
+            records.swap( next );
+        }
+
+        string filename = prefix + "." + to_string( release ) + ".txt";
+        FILE *out = fopen( filename.c_str( ), "w" );
+        if( out == nullptr )
+            return false;
+        for( int i = 0; i < REBASE_HEADER_LINES; ++i )
+            fputs( " \n", out );
+        for( size_t r = 0; r < records.size( ); ++r )
+        {
+            fputs( records[ r ].first.c_str( ), out );
+            for( size_t s = 0; s < records[ r ].second.size( ); ++s )
+                fprintf( out, "/%s", records[ r ].second[ s ].c_str( ) );
+            fputs( "//\n", out );
+        }
+        fclose( out );
+    }
+    return true;
+}
+
+#endif
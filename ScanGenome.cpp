@@ -0,0 +1,145 @@
+#include "AvlTree.h"
+#include "SiteScanner.h"
+#include "SequenceMap.cpp"
+#include "RebaseParser.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <thread>
+using namespace std;
+
+// Restriction digest of a FASTA file. Every recognition sequence in the
+// REBASE tree is compiled into one SiteScanner, the FASTA file is
+// scanned on the given number of threads, and the number of sites of
+// each enzyme is printed. With a sites file, every site is also written
+// there, one per line: record, first base, strand, cut position (-1 if
+// REBASE gives none), recognition sequence and enzymes.
+//
+// With --synthetic, writes a random genome of the given size instead,
+// for measuring throughput.
+
+// Small xorshift generator so the synthetic genome is reproducible
+uint64_t NextRandom(uint64_t &state) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+// Write a FASTA file of about megabytes MB of random bases, 60 to a
+// line, in records of at most 256 MB
+void WriteSyntheticGenome(const string &filename, size_t megabytes) {
+    FILE *out = fopen(filename.c_str(), "w");
+    if (out == nullptr) {
+        cout << "Cannot write " << filename << endl;
+        exit(1);
+    }
+    const size_t record_bytes = 256 << 20;
+    uint64_t state = 88172645463325252ULL;
+    size_t target = megabytes << 20;
+    char line[61];
+    line[60] = '\n';
+    for (size_t written = 0, record = 1; written < target; record++) {
+        written += fprintf(out, ">chr%zu synthetic\n", record);
+        for (size_t bytes = 0; bytes < record_bytes && written < target; bytes += 61, written += 61) {
+            uint64_t bits = 0;
+            for (int i = 0; i < 60; i++) {
+                if (i % 32 == 0) bits = NextRandom(state);
+                line[i] = "ACGT"[bits & 3];
+                bits >>= 2;
+            }
+            fwrite(line, 1, sizeof(line), out);
+        }
+    }
+    fclose(out);
+}
+
+int
+main(int argc, char **argv) {
+    if (argc == 4 && string(argv[1]) == "--synthetic") {
+        WriteSyntheticGenome(argv[2], atoi(argv[3]));
+        return 0;
+    }
+    if (argc < 3 || argc > 5) {
+        cout << "Usage: " << argv[0] << " <databasefilename> <fastafilename> [threads] [sitesfilename]" << endl;
+        cout << "       " << argv[0] << " --synthetic <fastafilename> <megabytes>" << endl;
+        return 0;
+    }
+    int threads = argc >= 4 ? atoi(argv[3]) : thread::hardware_concurrency();
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    vector<SequenceMap> sequence_maps;
+    if (!ReadRebaseFile(argv[1], sequence_maps)) {
+        cout << "Cannot read " << argv[1] << endl;
+        return 1;
+    }
+    AvlTree<SequenceMap> a_tree;
+    a_tree.bulkLoad(std::move(sequence_maps));
+
+    // Site i of the scanner is sites[i] of the tree
+    SiteScanner scanner;
+    vector<const SequenceMap *> sites;
+    a_tree.forEach([&scanner, &sites](const SequenceMap &item) {
+        scanner.addSite(item.getRecognitionSequence());
+        sites.push_back(&item);
+    });
+    scanner.compile();
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout << sites.size() << " recognition sequences, " << scanner.stateCount()
+         << " automaton states, built in " << seconds * 1000 << " ms" << endl;
+
+    MappedFile genome(argv[2]);
+    if (!genome.isOpen()) {
+        cout << "Cannot read " << argv[2] << endl;
+        return 1;
+    }
+    FILE *sites_out = nullptr;
+    if (argc == 5 && (sites_out = fopen(argv[4], "w")) == nullptr) {
+        cout << "Cannot write " << argv[4] << endl;
+        return 1;
+    }
+
+    ThreadPool pool(threads < 1 ? 1 : threads);
+    vector<string> records;
+    vector<size_t> site_counts(sites.size(), 0);
+    size_t bases;
+    start = chrono::steady_clock::now();
+    if (sites_out == nullptr) {
+        bases = scanner.countSites(genome.data(), genome.data() + genome.size(), pool, site_counts);
+    } else {
+        bases = scanner.scanFasta(genome.data(), genome.data() + genome.size(), pool, records,
+                                  [&](const SiteScanner::Hit &hit) {
+            site_counts[hit.site]++;
+            const SequenceMap &item = *sites[hit.site];
+            fprintf(sites_out, "%s\t%llu\t%c\t%ld\t%s\t", records[hit.record].c_str(),
+                    static_cast<unsigned long long>(hit.position), hit.reverse ? '-' : '+',
+                    scanner.cutPosition(hit), item.getRecognitionSequence().c_str());
+            for (size_t i = 0; i < item.getEnzymeCount(); i++)
+                fprintf(sites_out, i == 0 ? "%s" : " %s", item.getEnzymeAcronym(i));
+            fputc('\n', sites_out);
+        });
+        fclose(sites_out);
+    }
+    seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    size_t total_sites = 0;
+    for (size_t i = 0; i < site_counts.size(); i++) total_sites += site_counts[i];
+
+    // An enzyme with several recognition sequences counts all of them
+    map<string, size_t> enzyme_counts;
+    for (size_t i = 0; i < sites.size(); i++)
+        for (size_t e = 0; e < sites[i]->getEnzymeCount(); e++)
+            enzyme_counts[sites[i]->getEnzymeAcronym(e)] += site_counts[i];
+    for (map<string, size_t>::const_iterator it = enzyme_counts.begin(); it != enzyme_counts.end(); ++it)
+        cout << it->first << ": " << it->second << " sites" << endl;
+
+    cout << bases << " bases, " << total_sites << " sites in "
+         << seconds * 1000 << " ms on " << pool.size() << " threads, "
+         << genome.size() / seconds / 1e9 << " GB/s" << endl;
+    return 0;
+}
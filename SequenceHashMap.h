@@ -0,0 +1,444 @@
+#ifndef SEQUENCE_HASH_MAP_H
+#define SEQUENCE_HASH_MAP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+using namespace std;
+
+// SequenceHashMap class
+//
+// CONSTRUCTION: zero parameter, or a range of items to bulk-load
+//
+// An open-addressing hash table for exact-match lookups, with the
+// insert, find and remove_count interface of the trees. Comparable
+// must provide hash( ), operator< and merge; two items are the same
+// key when neither is less than the other.
+//
+// Collisions are resolved by Robin Hood linear probing: an item being
+// inserted takes the slot of any item closer to its home slot than the
+// new item is to its own, and the displaced item moves on. Probe
+// lengths stay short and even, and a lookup stops as soon as it meets
+// an item closer to home than the key would be. Each slot has a 32-bit
+// control word, 0 if the slot is empty and otherwise 16 bits of the
+// item's hash and its distance from home plus 1, so a probe compares
+// items only when those match. A removal shifts the items after it
+// back a slot rather than leaving a tombstone.
+//
+// The table doubles when it is MAX_LOAD_PERCENT full. Rather than
+// rehash everything at once, the old table is kept and every later
+// insert or remove moves the next MIGRATE_SLOTS of its slots into the
+// new one; lookups check both until the old table is empty. bulkLoad
+// sizes the table for its whole batch up front instead.
+//
+// Items are in no particular order, so there is no range query.
+//
+// ******************PUBLIC OPERATIONS*********************
+// void insert( x )       --> Insert x; merge into an item with the same key
+// void bulkLoad( items ) --> Insert a batch of items
+// void remove( x )       --> Remove x
+// bool contains( x )     --> Return true if x is present
+// Comparable * find( x ) --> Return item with the key of x, or nullptr
+// pair find_count( x )   --> find, plus number of slots probed
+// void find_batch( queries, found ) --> Look up each query
+// bool remove_count( x ) --> remove, counting slots probed
+// void forEach( visit )  --> Call visit on each item, in no order
+// size_t size( )         --> Return number of items
+// size_t depth( )        --> Return summed probe lengths of all items
+// size_t capacity( )     --> Return number of slots
+// boolean isEmpty( )     --> Return true if empty; else false
+// void makeEmpty( )      --> Remove all items
+
+template <typename Comparable>
+class SequenceHashMap
+{
+  public:
+    enum { MIN_CAPACITY = 16, MAX_LOAD_PERCENT = 80, MIGRATE_SLOTS = 16 };
+
+    SequenceHashMap( ) : migrated_{ 0 }, remove_calls{ 0 }
+      { }
+
+    template <typename Iterator>
+    SequenceHashMap( Iterator first, Iterator last ) : migrated_{ 0 }, remove_calls{ 0 }
+    {
+        bulkLoad( vector<Comparable>( first, last ) );
+    }
+
+    SequenceHashMap( const SequenceHashMap & rhs ) = delete;
+    SequenceHashMap & operator=( const SequenceHashMap & rhs ) = delete;
+
+    ~SequenceHashMap( )
+    {
+        makeEmpty( );
+    }
+
+    /**
+     * Insert x; an item with the same key absorbs x through merge.
+     */
+    void insert( const Comparable & x )
+    {
+        insertItem( x );
+    }
+
+    void insert( Comparable && x )
+    {
+        insertItem( std::move( x ) );
+    }
+
+    /**
+     * Add a batch of items, merging items with the same key in their
+     * original order. The table is grown once for the whole batch.
+     */
+    void bulkLoad( vector<Comparable> items )
+    {
+        size_t needed = size( ) + items.size( );
+        if( needed * 100 > capacity( ) * MAX_LOAD_PERCENT )
+        {
+            size_t slots = MIN_CAPACITY;
+            while( needed * 100 > slots * MAX_LOAD_PERCENT )
+                slots *= 2;
+            resize( slots );
+            migrate( old_.capacity );
+        }
+        for( size_t i = 0; i < items.size( ); ++i )
+            insertItem( std::move( items[ i ] ) );
+    }
+
+    /**
+     * Remove x. Nothing is done if x is not found.
+     */
+    void remove( const Comparable & x )
+    {
+        int calls = 0;
+        removeItem( x, calls );
+    }
+
+    bool remove_count( const Comparable & x )
+    {
+        remove_calls = 0;
+        return removeItem( x, remove_calls );
+    }
+
+    int get_remove_calls( ) const
+    {
+        return remove_calls;
+    }
+
+    bool contains( const Comparable & x ) const
+    {
+        return find( x ) != nullptr;
+    }
+
+    Comparable * find( const Comparable & x )
+    {
+        int calls = 0;
+        return findItem( x, calls );
+    }
+
+    /**
+     * Read-only lookups; any number of threads may run them at once
+     * as long as no thread modifies the table.
+     */
+    const Comparable * find( const Comparable & x ) const
+    {
+        int calls = 0;
+        return findItem( x, calls );
+    }
+
+    pair<Comparable *, int> find_count( const Comparable & x )
+    {
+        int calls = 0;
+        Comparable *result = findItem( x, calls );
+        return pair<Comparable *, int>( result, calls );
+    }
+
+    pair<const Comparable *, int> find_count( const Comparable & x ) const
+    {
+        int calls = 0;
+        const Comparable *result = findItem( x, calls );
+        return pair<const Comparable *, int>( result, calls );
+    }
+
+    /**
+     * Hashing scatters neighbouring keys, so sorted queries gain
+     * nothing and each is looked up on its own.
+     */
+    void find_batch( const vector<Comparable> & queries, vector<const Comparable *> & found ) const
+    {
+        found.resize( queries.size( ) );
+        for( size_t i = 0; i < queries.size( ); ++i )
+            found[ i ] = find( queries[ i ] );
+    }
+
+    template <typename Visit>
+    void forEach( Visit visit ) const
+    {
+        forEachIn( table_, visit );
+        forEachIn( old_, visit );
+    }
+
+    size_t size( ) const
+    {
+        return table_.size + old_.size;
+    }
+
+    /**
+     * The slots find( x ) probes for every item x, summed; the hash
+     * table's counterpart of a tree's summed node depths.
+     */
+    size_t depth( ) const
+    {
+        size_t probes = 0;
+        forEachSlot( table_, [&probes]( uint32_t control, size_t ) {
+            probes += distanceOf( control );
+        } );
+        // An item still in the old table is found after a miss in the new
+        forEachSlot( old_, [this, &probes]( uint32_t control, size_t slot ) {
+            int calls = 0;
+            findIn( table_, itemAt( old_, slot ).hash( ), itemAt( old_, slot ), calls );
+            probes += calls + distanceOf( control );
+        } );
+        return probes;
+    }
+
+    size_t capacity( ) const
+    {
+        return table_.capacity;
+    }
+
+    bool isEmpty( ) const
+    {
+        return size( ) == 0;
+    }
+
+    void makeEmpty( )
+    {
+        release( table_ );
+        release( old_ );
+        migrated_ = 0;
+    }
+
+  private:
+    typedef typename aligned_storage<sizeof( Comparable ), alignof( Comparable )>::type Slot;
+
+    // Control word layout: hash tag above, distance from home + 1 below
+    enum : uint32_t { DISTANCE_BITS = 16, DISTANCE_MASK = ( 1u << DISTANCE_BITS ) - 1 };
+
+    struct Table
+    {
+        uint32_t *control;
+        Slot *slots;
+        size_t capacity;    // A power of 2, or 0 before the first insert
+        size_t size;
+
+        Table( ) : control{ nullptr }, slots{ nullptr }, capacity{ 0 }, size{ 0 }
+          { }
+    };
+
+    static const size_t NOT_FOUND = ~size_t( 0 );
+
+    Table table_;       // Where inserts go
+    Table old_;         // The table being migrated out of, if any
+    size_t migrated_;   // Slots of old_ below this are empty
+    int remove_calls;
+
+    static Comparable & itemAt( const Table & t, size_t slot )
+    {
+        return *reinterpret_cast<Comparable *>( &t.slots[ slot ] );
+    }
+
+    static uint32_t tagOf( size_t h )
+    {
+        return static_cast<uint32_t>( h >> ( 64 - DISTANCE_BITS ) ) << DISTANCE_BITS;
+    }
+
+    static uint32_t distanceOf( uint32_t control )
+    {
+        return control & DISTANCE_MASK;
+    }
+
+    static bool sameKey( const Comparable & a, const Comparable & b )
+    {
+        return !( a < b ) && !( b < a );
+    }
+
+    /**
+     * Return the slot of x in t, or NOT_FOUND, adding the slots probed
+     * to calls. distance runs one ahead of the probe distance, as the
+     * control words store it, so an empty slot (0) also ends the probe.
+     */
+    static size_t findIn( const Table & t, size_t h, const Comparable & x, int & calls )
+    {
+        if( t.size == 0 )
+            return NOT_FOUND;
+        size_t mask = t.capacity - 1;
+        uint32_t tag = tagOf( h );
+        for( size_t slot = h & mask, distance = 1; ; slot = ( slot + 1 ) & mask, ++distance )
+        {
+            ++calls;
+            uint32_t control = t.control[ slot ];
+            if( distanceOf( control ) < distance )
+                return NOT_FOUND;
+            if( control == ( tag | distance ) && sameKey( itemAt( t, slot ), x ) )
+                return slot;
+        }
+    }
+
+    Comparable * findItem( const Comparable & x, int & calls ) const
+    {
+        size_t h = x.hash( );
+        size_t slot = findIn( table_, h, x, calls );
+        if( slot != NOT_FOUND )
+            return &itemAt( table_, slot );
+        slot = findIn( old_, h, x, calls );
+        return slot == NOT_FOUND ? nullptr : &itemAt( old_, slot );
+    }
+
+    /**
+     * Place x, whose key is not in t, by Robin Hood displacement.
+     * A chain of DISTANCE_MASK colliding keys would overflow the
+     * distance; at MAX_LOAD_PERCENT with a mixing hash that never comes
+     * near happening.
+     */
+    static void placeIn( Table & t, size_t h, Comparable && x )
+    {
+        size_t mask = t.capacity - 1;
+        uint32_t carried = tagOf( h ) | 1;
+        Comparable item( std::move( x ) );
+        for( size_t slot = h & mask; ; slot = ( slot + 1 ) & mask, ++carried )
+        {
+            uint32_t control = t.control[ slot ];
+            if( control == 0 )
+            {
+                t.control[ slot ] = carried;
+                new ( &t.slots[ slot ] ) Comparable( std::move( item ) );
+                ++t.size;
+                return;
+            }
+            if( distanceOf( control ) < distanceOf( carried ) )
+            {
+                t.control[ slot ] = carried;
+                carried = control;
+                swap( item, itemAt( t, slot ) );
+            }
+        }
+    }
+
+    /**
+     * Remove the item in slot from t and shift the items after it,
+     * up to an empty slot or one already at home, back by one.
+     */
+    static void eraseIn( Table & t, size_t slot )
+    {
+        size_t mask = t.capacity - 1;
+        itemAt( t, slot ).~Comparable( );
+        for( size_t next = ( slot + 1 ) & mask; distanceOf( t.control[ next ] ) > 1;
+             slot = next, next = ( next + 1 ) & mask )
+        {
+            t.control[ slot ] = t.control[ next ] - 1;
+            new ( &t.slots[ slot ] ) Comparable( std::move( itemAt( t, next ) ) );
+            itemAt( t, next ).~Comparable( );
+        }
+        t.control[ slot ] = 0;
+        --t.size;
+    }
+
+    template <typename Item>
+    void insertItem( Item && x )
+    {
+        size_t h = x.hash( );
+        int calls = 0;
+        Comparable *found = findItem( x, calls );
+        if( found != nullptr )
+        {
+            found->merge( x );
+            return;
+        }
+        if( ( size( ) + 1 ) * 100 > capacity( ) * MAX_LOAD_PERCENT )
+            resize( capacity( ) == 0 ? size_t( MIN_CAPACITY ) : 2 * capacity( ) );
+        placeIn( table_, h, Comparable( std::forward<Item>( x ) ) );
+        migrate( MIGRATE_SLOTS );
+    }
+
+    bool removeItem( const Comparable & x, int & calls )
+    {
+        size_t h = x.hash( );
+        size_t slot = findIn( table_, h, x, calls );
+        if( slot != NOT_FOUND )
+            eraseIn( table_, slot );
+        else if( ( slot = findIn( old_, h, x, calls ) ) != NOT_FOUND )
+            eraseIn( old_, slot );
+        migrate( MIGRATE_SLOTS );
+        return slot != NOT_FOUND;
+    }
+
+    /**
+     * Start moving every item into a fresh table of the given number of
+     * slots, first finishing any earlier move.
+     */
+    void resize( size_t slots )
+    {
+        migrate( old_.capacity );
+        old_ = table_;
+        table_ = Table( );
+        table_.control = new uint32_t[ slots ]( );
+        table_.slots = new Slot[ slots ];
+        table_.capacity = slots;
+        migrated_ = 0;
+    }
+
+    /**
+     * Move items out of old_ for up to steps steps, each of which
+     * either moves one item or passes one empty slot. Moving an item
+     * shifts later items back into its slot, so the same slot is
+     * looked at again until it is empty; every slot below migrated_
+     * stays empty, since nothing is inserted into old_.
+     */
+    void migrate( size_t steps )
+    {
+        for( ; steps > 0 && migrated_ < old_.capacity; --steps )
+        {
+            if( old_.control[ migrated_ ] == 0 )
+            {
+                ++migrated_;
+                continue;
+            }
+            Comparable & x = itemAt( old_, migrated_ );
+            placeIn( table_, x.hash( ), std::move( x ) );
+            eraseIn( old_, migrated_ );
+        }
+        if( old_.capacity != 0 && migrated_ == old_.capacity )
+            release( old_ );
+    }
+
+    static void release( Table & t )
+    {
+        forEachSlot( t, [&t]( uint32_t, size_t slot ) {
+            itemAt( t, slot ).~Comparable( );
+        } );
+        delete [ ] t.control;
+        delete [ ] t.slots;
+        t = Table( );
+    }
+
+    template <typename Visit>
+    static void forEachSlot( const Table & t, Visit visit )
+    {
+        for( size_t slot = 0; slot < t.capacity; ++slot )
+            if( t.control[ slot ] != 0 )
+                visit( t.control[ slot ], slot );
+    }
+
+    template <typename Visit>
+    static void forEachIn( const Table & t, Visit & visit )
+    {
+        forEachSlot( t, [&t, &visit]( uint32_t, size_t slot ) {
+            visit( static_cast<const Comparable &>( itemAt( t, slot ) ) );
+        } );
+    }
+};
+
+#endif
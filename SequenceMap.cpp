@@ -1,24 +1,71 @@
 #include "SequenceMap.h"
 
-SequenceMap::SequenceMap(const string &a_rec_seq, const string &an_enz_acro) {
-    recognition_sequence_ = a_rec_seq;
-    enzyme_acronyms_.push_back(an_enz_acro);
+SequenceMap::SequenceMap(const string &a_rec_seq, const string &an_enz_acro)
+    : recognition_sequence_(a_rec_seq) {
+    enzyme_ids_.push_back(EnzymePool::instance().intern(an_enz_acro));
+}
+
+SequenceMap::SequenceMap(const char *a_rec_seq, size_t rec_seq_length,
+                         const char *an_enz_acro, size_t enz_acro_length)
+    : recognition_sequence_(a_rec_seq, rec_seq_length) {
+    enzyme_ids_.push_back(EnzymePool::instance().intern(an_enz_acro, enz_acro_length));
+}
+
+SequenceMap::SequenceMap(const string &a_rec_seq, const vector<string> &enz_acros)
+    : recognition_sequence_(a_rec_seq) {
+    for (size_t i = 0; i < enz_acros.size(); i++)
+        enzyme_ids_.push_back(EnzymePool::instance().intern(enz_acros[i]));
+}
+
+string SequenceMap::getRecognitionSequence() const {
+    return recognition_sequence_.str();
+}
+
+vector<string> SequenceMap::getEnzymeAcronyms() const {
+    vector<string> acronyms;
+    for (size_t i = 0; i < enzyme_ids_.size(); i++)
+        acronyms.push_back(getEnzymeAcronym(i));
+    return acronyms;
+}
+
+size_t SequenceMap::getEnzymeCount() const {
+    return enzyme_ids_.size();
+}
+
+const char *SequenceMap::getEnzymeAcronym(size_t i) const {
+    return EnzymePool::instance().name(enzyme_ids_[i]);
 }
 
 bool SequenceMap::operator<(const SequenceMap &rhs) const {
     return recognition_sequence_ < rhs.recognition_sequence_;
 }
 
-ostream& operator<<(ostream &stream, SequenceMap &to_display) {
-    stream << to_display.recognition_sequence_ << " : ";
-    for (size_t i = 0; i < to_display.enzyme_acronyms_.size(); i++) {
-        stream << to_display.enzyme_acronyms_[i] << " ";
+size_t SequenceMap::hash() const {
+    return recognition_sequence_.hash();
+}
+
+bool SequenceMap::sameEnzymes(const SequenceMap &rhs) const {
+    if (enzyme_ids_.size() != rhs.enzyme_ids_.size()) return false;
+    for (size_t i = 0; i < enzyme_ids_.size(); i++)
+        if (enzyme_ids_[i] != rhs.enzyme_ids_[i]) return false;
+    return true;
+}
+
+ostream& operator<<(ostream &stream, const SequenceMap &to_display) {
+    stream << to_display.recognition_sequence_.str() << " : ";
+    for (size_t i = 0; i < to_display.enzyme_ids_.size(); i++) {
+        stream << to_display.getEnzymeAcronym(i) << " ";
     }
     return stream;
 }
 
+// Acronyms already listed are skipped; ids are interned, so comparing
+// them compares the names
 void SequenceMap::merge(const SequenceMap &other_sequence) {
-    enzyme_acronyms_.insert(enzyme_acronyms_.end(),
-                            other_sequence.enzyme_acronyms_.begin(),
-                            other_sequence.enzyme_acronyms_.end());
+    for (size_t i = 0; i < other_sequence.enzyme_ids_.size(); i++) {
+        uint32_t id = other_sequence.enzyme_ids_[i];
+        size_t j = 0;
+        while (j < enzyme_ids_.size() && enzyme_ids_[j] != id) j++;
+        if (j == enzyme_ids_.size()) enzyme_ids_.push_back(id);
+    }
 }
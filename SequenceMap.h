@@ -1,19 +1,45 @@
 #ifndef SEQUENCE_MAP_H_
 #define SEQUENCE_MAP_H_
 
+#include "EnzymePool.h"
+#include "PackedSequence.h"
+#include "SmallVector.h"
+#include "StringSequence.h"
 #include <iostream>
 #include <string>
 #include <vector>
 using namespace std;
 
+// The recognition sequence key: packed at 4 bits per symbol (see
+// PackedSequence.h), or a plain string when compiled with
+// -DSEQUENCE_MAP_STRING_KEY
+#ifdef SEQUENCE_MAP_STRING_KEY
+typedef StringSequence RecognitionKey;
+#else
+typedef PackedSequence RecognitionKey;
+#endif
+
 class SequenceMap {
 private:
-    string recognition_sequence_;
-    vector<string> enzyme_acronyms_;
+    RecognitionKey recognition_sequence_;
+    // Ids of the acronyms in EnzymePool, in the order they were added;
+    // most sequences have few enough to stay inline
+    SmallVector<uint32_t, 3> enzyme_ids_;
 public:
     SequenceMap(const string &a_rec_seq, const string &an_enz_acro);
+    SequenceMap(const char *a_rec_seq, size_t rec_seq_length,
+                const char *an_enz_acro, size_t enz_acro_length);
+    SequenceMap(const string &a_rec_seq, const vector<string> &enz_acros);
+    string getRecognitionSequence() const;
+    vector<string> getEnzymeAcronyms() const;
+    size_t getEnzymeCount() const;
+    const char *getEnzymeAcronym(size_t i) const;
     bool operator<(const SequenceMap &rhs) const;
-    friend ostream& operator<<(ostream &stream, SequenceMap &to_display);
+    // Hash of the recognition sequence, for SequenceHashMap
+    size_t hash() const;
+    // True if both list the same enzymes in the same order
+    bool sameEnzymes(const SequenceMap &rhs) const;
+    friend ostream& operator<<(ostream &stream, const SequenceMap &to_display);
     void merge(const SequenceMap &other_sequence);
 };
 
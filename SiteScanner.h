@@ -0,0 +1,631 @@
+#ifndef SITE_SCANNER_H
+#define SITE_SCANNER_H
+
+#include "dsexceptions.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <string>
+#include <vector>
+using namespace std;
+
+// SiteScanner class
+//
+// CONSTRUCTION: zero parameter; add every site, then compile
+//
+// Finds every occurrence of a set of recognition sequences, on both
+// strands, in the records of a FASTA file. Sequences are written as in
+// REBASE: IUPAC codes with ' marking where the top strand is cut.
+//
+// A degenerate site cannot go into an Aho-Corasick automaton whole;
+// CCANNNNNNNTTC alone would spell 4^7 strings. Instead each site, and
+// its reverse complement unless it is a palindrome, contributes one
+// anchor: the stretch of it that says the most about the bases while
+// spelling at most MAX_SPELLINGS concrete strings. Every spelling of
+// every anchor goes into one automaton over A, C, G and T, and each
+// anchor hit is checked against the full site, 16 positions at a
+// time, as nibble masks against the chunk's bases kept one-hot.
+//
+// scanFasta cuts each record into chunks of about CHUNK_BYTES, which
+// the pool's threads copy into arrays of base codes and scan. A chunk
+// also reads as many bases past its end as the longest site needs, so
+// a site is found by the chunk holding its first base, however it
+// straddles chunks or line breaks. Chunks run in batches and their
+// hits are reported in file order before the next batch starts, so
+// memory stays bounded however large the file is.
+//
+// Genome bases may be upper or lower case. Any base other than A, C, G
+// or T, such as N, is never part of a site.
+//
+// ******************PUBLIC OPERATIONS*********************
+// size_t addSite( sequence ) --> Add a recognition sequence; return its index
+// void compile( )            --> Build the automaton, after the last addSite
+// size_t countSites( begin, end, pool, counts ) --> Count each site
+// size_t scanFasta( begin, end, pool, records, visit ) --> Report every site
+// long cutPosition( hit )    --> Return where the hit's top strand is cut
+// size_t stateCount( )       --> Return number of automaton states
+// ******************ERRORS********************************
+// Throws IllegalArgumentException for a site with no bases, or any
+// character that is not an IUPAC code or '
+
+class SiteScanner
+{
+  public:
+    // One site found: the record it is in, the position of its first
+    // base in that record, counting from 0, and which site it is.
+    // reverse is true if the site reads on the bottom strand.
+    struct Hit
+    {
+        uint64_t position;
+        uint32_t record;
+        uint32_t site;
+        bool reverse;
+    };
+
+    enum { MAX_SPELLINGS = 16, CHUNK_BYTES = 1 << 20 };
+
+    SiteScanner( ) : longest_{ 0 }
+    {
+        memset( codes_, OTHER, sizeof( codes_ ) );
+        codes_[ 'A' ] = codes_[ 'a' ] = 0;
+        codes_[ 'C' ] = codes_[ 'c' ] = 1;
+        codes_[ 'G' ] = codes_[ 'g' ] = 2;
+        codes_[ 'T' ] = codes_[ 't' ] = 3;
+        codes_[ '\n' ] = codes_[ '\r' ] = SKIP;
+    }
+
+    /**
+     * Add a recognition sequence and return its index, which hits
+     * report as their site.
+     */
+    size_t addSite( const string & sequence )
+    {
+        Pattern forward;
+        forward.site = static_cast<uint32_t>( forwardPattern_.size( ) );
+        forward.reverse = false;
+        forward.cut = -1;
+        for( size_t i = 0; i < sequence.size( ); ++i )
+        {
+            if( sequence[ i ] == '\'' )
+            {
+                forward.cut = static_cast<int>( forward.masks.size( ) );
+                continue;
+            }
+            int bases = basesOf( sequence[ i ] );
+            if( bases == 0 )
+                throw IllegalArgumentException{ };
+            forward.masks.push_back( static_cast<uint8_t>( bases ) );
+        }
+        if( forward.masks.empty( ) )
+            throw IllegalArgumentException{ };
+
+        Pattern backward = forward;
+        backward.reverse = true;
+        reverse( backward.masks.begin( ), backward.masks.end( ) );
+        for( size_t i = 0; i < backward.masks.size( ); ++i )
+            backward.masks[ i ] = complement( backward.masks[ i ] );
+        forward.nibbles = packNibbles( forward.masks );
+        backward.nibbles = packNibbles( backward.masks );
+
+        forwardPattern_.push_back( static_cast<uint32_t>( patterns_.size( ) ) );
+        patterns_.push_back( forward );
+        if( backward.masks != forward.masks )
+            patterns_.push_back( backward );
+        longest_ = max( longest_, forward.masks.size( ) );
+        return forward.site;
+    }
+
+    /**
+     * Build the automaton over the anchors of every site added so far.
+     */
+    void compile( )
+    {
+        next_.assign( 4, NONE );
+        vector<vector<uint32_t> > found( 1 );
+        probes_.clear( );
+        for( uint32_t p = 0; p < patterns_.size( ); ++p )
+        {
+            Probe probe = chooseAnchor( patterns_[ p ] );
+            probe.pattern = p;
+            probes_.push_back( probe );
+            spell( probe, 0, 0, found );
+        }
+
+        // Breadth-first, so a state's failure state is finished first;
+        // missing moves become the failure state's moves, and each state
+        // inherits the probes that end at its failure state
+        vector<uint32_t> failure( found.size( ), 0 );
+        deque<uint32_t> queue;
+        for( int c = 0; c < 4; ++c )
+        {
+            uint32_t & t = next_[ c ];
+            if( t == NONE )
+                t = 0;
+            else
+                queue.push_back( t );
+        }
+        while( !queue.empty( ) )
+        {
+            uint32_t s = queue.front( );
+            queue.pop_front( );
+            const vector<uint32_t> & inherited = found[ failure[ s ] ];
+            found[ s ].insert( found[ s ].end( ), inherited.begin( ), inherited.end( ) );
+            for( int c = 0; c < 4; ++c )
+            {
+                uint32_t & t = next_[ 4 * s + c ];
+                if( t == NONE )
+                    t = next_[ 4 * failure[ s ] + c ];
+                else
+                {
+                    failure[ t ] = next_[ 4 * failure[ s ] + c ];
+                    queue.push_back( t );
+                }
+            }
+        }
+
+        firstOutput_.assign( 1, 0 );
+        outputs_.clear( );
+        for( size_t s = 0; s < found.size( ); ++s )
+        {
+            outputs_.insert( outputs_.end( ), found[ s ].begin( ), found[ s ].end( ) );
+            firstOutput_.push_back( static_cast<uint32_t>( outputs_.size( ) ) );
+        }
+    }
+
+    size_t stateCount( ) const
+    {
+        return next_.size( ) / 4;
+    }
+
+    /**
+     * The position, on the top strand of the record, of the first base
+     * after the cut that hit's enzyme makes in its own top strand; -1 if
+     * the site carries no cut mark.
+     */
+    long cutPosition( const Hit & hit ) const
+    {
+        const Pattern & p = patterns_[ forwardPattern_[ hit.site ] ];
+        if( p.cut < 0 )
+            return -1;
+        return hit.reverse ? static_cast<long>( hit.position + p.masks.size( ) - p.cut )
+                           : static_cast<long>( hit.position + p.cut );
+    }
+
+    /**
+     * Count the sites in the FASTA text in [ begin, end ) with the
+     * threads of pool: counts[ i ] becomes the number of times site i
+     * occurs on either strand. Return the number of bases read.
+     */
+    size_t countSites( const char *begin, const char *end, ThreadPool & pool,
+                       vector<size_t> & counts ) const
+    {
+        vector<string> records;
+        vector<Chunk> chunks;
+        splitRecords( begin, end, records, chunks );
+
+        vector<ChunkBuffer> buffers( pool.size( ) );
+        vector<vector<size_t> > workerCounts( pool.size( ), vector<size_t>( forwardPattern_.size( ), 0 ) );
+        vector<size_t> workerBases( pool.size( ), 0 );
+        pool.parallelFor( chunks.size( ), 1, [&]( size_t b, size_t e, size_t worker ) {
+            vector<size_t> & mine = workerCounts[ worker ];
+            for( size_t i = b; i < e; ++i )
+            {
+                size_t owned, n;
+                loadChunk( chunks[ i ], buffers[ worker ], owned, n );
+                findSites( buffers[ worker ], owned, n, [&]( size_t, uint32_t p ) {
+                    ++mine[ patterns_[ p ].site ];
+                } );
+                workerBases[ worker ] += owned;
+            }
+        } );
+
+        counts.assign( forwardPattern_.size( ), 0 );
+        size_t total = 0;
+        for( size_t w = 0; w < pool.size( ); ++w )
+        {
+            for( size_t i = 0; i < counts.size( ); ++i )
+                counts[ i ] += workerCounts[ w ][ i ];
+            total += workerBases[ w ];
+        }
+        return total;
+    }
+
+    /**
+     * Scan the FASTA text in [ begin, end ) with the threads of pool.
+     * The name of each record, up to the first blank, is appended to
+     * records. visit( hit ) is called for every site found, in order
+     * of record, then position, then site, forward strand first.
+     * Return the number of bases read.
+     */
+    template <typename Visit>
+    size_t scanFasta( const char *begin, const char *end, ThreadPool & pool,
+                      vector<string> & records, Visit visit ) const
+    {
+        vector<Chunk> chunks;
+        size_t firstRecord = records.size( );
+        splitRecords( begin, end, records, chunks );
+
+        vector<ChunkBuffer> buffers( pool.size( ) );
+        vector<vector<vector<uint32_t> > > rings( pool.size( ) );
+        size_t batch = 2 * pool.size( );
+        vector<vector<uint64_t> > hits( batch );
+        vector<size_t> bases( batch );
+        size_t total = 0;
+        uint64_t recordBases = 0;
+        for( size_t first = 0; first < chunks.size( ); first += batch )
+        {
+            size_t count = min( batch, chunks.size( ) - first );
+            pool.parallelFor( count, 1, [&]( size_t b, size_t e, size_t worker ) {
+                for( size_t i = b; i < e; ++i )
+                    bases[ i ] = listChunk( chunks[ first + i ], buffers[ worker ], rings[ worker ],
+                                            hits[ i ] );
+            } );
+
+            for( size_t i = 0; i < count; ++i )
+            {
+                const Chunk & chunk = chunks[ first + i ];
+                if( chunk.startsRecord )
+                    recordBases = 0;
+                for( size_t h = 0; h < hits[ i ].size( ); ++h )
+                {
+                    const Pattern & p = patterns_[ hits[ i ][ h ] & 0xffffffff ];
+                    Hit hit = { recordBases + ( hits[ i ][ h ] >> 32 ),
+                                static_cast<uint32_t>( firstRecord + chunk.record ), p.site, p.reverse };
+                    visit( static_cast<const Hit &>( hit ) );
+                }
+                recordBases += bases[ i ];
+                total += bases[ i ];
+            }
+        }
+        return total;
+    }
+
+  private:
+    // A site, or the reverse complement of one, as one base mask per
+    // position, A = 1, C = 2, G = 4, T = 8
+    struct Pattern
+    {
+        vector<uint8_t> masks;
+        vector<uint64_t> nibbles;   // The masks, 16 to a word, low nibble first
+        uint32_t site;
+        int cut;                // Bases before the top-strand cut, or -1
+        bool reverse;
+    };
+
+    // The part of a pattern that goes into the automaton
+    struct Probe
+    {
+        uint32_t pattern;
+        uint32_t offset;        // Position of the anchor in the pattern
+        uint32_t length;
+    };
+
+    // A worker's copy of a chunk: a code per base for the automaton, and
+    // the bases again as one-hot nibbles, 16 to a word, for checking
+    // whole patterns a word at a time
+    struct ChunkBuffer
+    {
+        vector<uint8_t> codes;
+        vector<uint64_t> nibbles;
+    };
+
+    // A stretch of one record's bases, and where in the text it is
+    struct Chunk
+    {
+        const char *begin;      // Bases owned by this chunk
+        const char *end;
+        const char *limit;      // End of the record, for reading ahead
+        size_t record;
+        bool startsRecord;
+    };
+
+    enum : uint32_t { NONE = 0xffffffff };
+    enum { OTHER = 4, SKIP = 5 };   // Codes for non-ACGT bases and line breaks
+
+    vector<Pattern> patterns_;
+    vector<uint32_t> forwardPattern_;   // Index in patterns_ of each site
+    vector<Probe> probes_;
+    vector<uint32_t> next_;         // Move of state s on base c at 4 * s + c
+    vector<uint32_t> firstOutput_;  // Probes ending at s: outputs_[ first[ s ], first[ s + 1 ] )
+    vector<uint32_t> outputs_;
+    size_t longest_;                // Bases in the longest site
+    uint8_t codes_[ 256 ];          // Code of each byte of genome text
+
+    static int basesOf( char c )
+    {
+        switch( c )
+        {
+          case 'A': return 1;
+          case 'C': return 2;
+          case 'G': return 4;
+          case 'T': return 8;
+          case 'M': return 1 | 2;
+          case 'R': return 1 | 4;
+          case 'W': return 1 | 8;
+          case 'S': return 2 | 4;
+          case 'Y': return 2 | 8;
+          case 'K': return 4 | 8;
+          case 'V': return 1 | 2 | 4;
+          case 'H': return 1 | 2 | 8;
+          case 'D': return 1 | 4 | 8;
+          case 'B': return 2 | 4 | 8;
+          case 'N': return 1 | 2 | 4 | 8;
+          default: return 0;
+        }
+    }
+
+    // Swap A with T and C with G; the bit order makes that a reversal
+    static uint8_t complement( uint8_t mask )
+    {
+        return static_cast<uint8_t>( ( mask & 1 ) << 3 | ( mask & 2 ) << 1 |
+                                     ( mask & 4 ) >> 1 | ( mask & 8 ) >> 3 );
+    }
+
+    static int spellings( uint8_t mask )
+    {
+        return ( mask & 1 ) + ( mask >> 1 & 1 ) + ( mask >> 2 & 1 ) + ( mask >> 3 & 1 );
+    }
+
+    /**
+     * The window of p with the most information, log2( 4 / spellings )
+     * summed over its positions, that spells at most MAX_SPELLINGS
+     * strings.
+     */
+    static Probe chooseAnchor( const Pattern & p )
+    {
+        Probe best = { 0, 0, 1 };
+        double bestBits = -1, bits = 0;
+        int product = 1;
+        size_t low = 0;
+        for( size_t high = 0; high < p.masks.size( ); ++high )
+        {
+            product *= spellings( p.masks[ high ] );
+            bits += 2 - log2( spellings( p.masks[ high ] ) );
+            while( product > MAX_SPELLINGS )
+            {
+                product /= spellings( p.masks[ low ] );
+                bits -= 2 - log2( spellings( p.masks[ low ] ) );
+                ++low;
+            }
+            if( low <= high && bits > bestBits + 1e-9 )
+            {
+                bestBits = bits;
+                best.offset = static_cast<uint32_t>( low );
+                best.length = static_cast<uint32_t>( high - low + 1 );
+            }
+        }
+        return best;
+    }
+
+    /**
+     * Add every spelling of probe's anchor from position i on, starting
+     * at automaton state s.
+     */
+    void spell( const Probe & probe, uint32_t i, uint32_t s, vector<vector<uint32_t> > & found )
+    {
+        if( i == probe.length )
+        {
+            found[ s ].push_back( static_cast<uint32_t>( probes_.size( ) - 1 ) );
+            return;
+        }
+        uint8_t mask = patterns_[ probe.pattern ].masks[ probe.offset + i ];
+        for( int c = 0; c < 4; ++c )
+        {
+            if( ( mask >> c & 1 ) == 0 )
+                continue;
+            if( next_[ 4 * s + c ] == NONE )
+            {
+                next_[ 4 * s + c ] = static_cast<uint32_t>( found.size( ) );
+                found.push_back( vector<uint32_t>( ) );
+                next_.insert( next_.end( ), 4, NONE );
+            }
+            spell( probe, i + 1, next_[ 4 * s + c ], found );
+        }
+    }
+
+    /**
+     * Return the first '>' at the start of a line in [ p, end ), or end.
+     */
+    static const char * nextHeader( const char *begin, const char *p, const char *end )
+    {
+        for( ; ; )
+        {
+            p = static_cast<const char *>( memchr( p, '>', end - p ) );
+            if( p == nullptr )
+                return end;
+            if( p == begin || p[ -1 ] == '\n' )
+                return p;
+            ++p;
+        }
+    }
+
+    /**
+     * Append a record for each header and cut the sequence lines under
+     * it into chunks. Text before the first header is a record with an
+     * empty name.
+     */
+    static void splitRecords( const char *begin, const char *end, vector<string> & records,
+                              vector<Chunk> & chunks )
+    {
+        size_t firstRecord = records.size( );
+        const char *p = begin;
+        while( p < end )
+        {
+            const char *sequence = p;
+            if( *p == '>' )
+            {
+                const char *eol = static_cast<const char *>( memchr( p, '\n', end - p ) );
+                sequence = eol == nullptr ? end : eol + 1;
+                const char *nameEnd = p + 1;
+                while( nameEnd < sequence && !isspace( static_cast<unsigned char>( *nameEnd ) ) )
+                    ++nameEnd;
+                records.push_back( string( p + 1, nameEnd ) );
+            }
+            else
+                records.push_back( string( ) );
+
+            const char *limit = nextHeader( begin, sequence, end );
+            const char *c = sequence;
+            do
+            {
+                const char *stop = limit - c > CHUNK_BYTES ? c + CHUNK_BYTES : limit;
+                Chunk chunk = { c, stop, limit, records.size( ) - 1 - firstRecord, c == sequence };
+                chunks.push_back( chunk );
+                c = stop;
+            } while( c < limit );
+            p = limit;
+        }
+    }
+
+    /**
+     * Copy the chunk's bases, and enough after it to finish any site
+     * starting in it, into buffer. owned is the number of bases in the
+     * chunk itself and n the number copied.
+     */
+    void loadChunk( const Chunk & chunk, ChunkBuffer & buffer, size_t & owned, size_t & n ) const
+    {
+        vector<uint8_t> & codes = buffer.codes;
+        codes.resize( static_cast<size_t>( chunk.end - chunk.begin ) + longest_ );
+        n = 0;
+        for( const char *c = chunk.begin; c < chunk.end; ++c )
+        {
+            uint8_t code = codes_[ static_cast<unsigned char>( *c ) ];
+            codes[ n ] = code;
+            n += code != SKIP;
+        }
+        owned = n;
+        for( const char *c = chunk.end; c < chunk.limit && n + 1 < owned + longest_; ++c )
+        {
+            uint8_t code = codes_[ static_cast<unsigned char>( *c ) ];
+            codes[ n ] = code;
+            n += code != SKIP;
+        }
+
+        // Two spare words let a pattern be read from any start below n
+        buffer.nibbles.assign( n / 16 + 2, 0 );
+        for( size_t i = 0; i < n; ++i )
+            if( codes[ i ] < 4 )
+                buffer.nibbles[ i / 16 ] |= uint64_t( 1 ) << ( 4 * ( i % 16 ) + codes[ i ] );
+    }
+
+    /**
+     * Run the automaton over the n bases in buffer and call
+     * found( start, pattern ) for each pattern occurring at a start
+     * below owned. A pattern is found once its anchor has been read,
+     * so starts arrive at most longest_ - 1 bases out of order.
+     */
+    template <typename Found>
+    void findSites( const ChunkBuffer & buffer, size_t owned, size_t n, Found found ) const
+    {
+        const uint8_t *base = buffer.codes.data( );
+        const uint64_t *text = buffer.nibbles.data( );
+        uint32_t s = 0;
+        for( size_t i = 0; i < n; ++i )
+        {
+            if( base[ i ] == OTHER )
+            {
+                s = 0;
+                continue;
+            }
+            s = next_[ 4 * s + base[ i ] ];
+            for( uint32_t o = firstOutput_[ s ]; o < firstOutput_[ s + 1 ]; ++o )
+            {
+                const Probe & probe = probes_[ outputs_[ o ] ];
+                const Pattern & p = patterns_[ probe.pattern ];
+                size_t tail = probe.offset + probe.length;
+                if( i + 1 < tail )
+                    continue;
+                size_t start = i + 1 - tail;
+                if( start >= owned || start + p.masks.size( ) > n )
+                    continue;
+                if( matches( text, start, p ) )
+                    found( start, probe.pattern );
+            }
+        }
+    }
+
+    /**
+     * Return true if every base from start on is one the pattern allows
+     * there. ANDing one-hot text with the masks leaves a bit in each
+     * nibble where the base is allowed; folding each nibble onto its low
+     * bit then checks 16 positions at once.
+     */
+    static bool matches( const uint64_t *text, size_t start, const Pattern & p )
+    {
+        const uint64_t LOW_BITS = 0x1111111111111111ULL;
+        size_t length = p.masks.size( );
+        for( size_t w = 0; w < p.nibbles.size( ); ++w, start += 16 )
+        {
+            size_t word = start / 16, shift = 4 * ( start % 16 );
+            uint64_t bases = shift == 0 ? text[ word ]
+                                        : text[ word ] >> shift | text[ word + 1 ] << ( 64 - shift );
+            uint64_t x = bases & p.nibbles[ w ];
+            x = ( x | x >> 1 | x >> 2 | x >> 3 ) & LOW_BITS;
+            size_t left = length - 16 * w;
+            uint64_t need = left >= 16 ? LOW_BITS : LOW_BITS & ( ( uint64_t( 1 ) << ( 4 * left ) ) - 1 );
+            if( x != need )
+                return false;
+        }
+        return true;
+    }
+
+    static vector<uint64_t> packNibbles( const vector<uint8_t> & masks )
+    {
+        vector<uint64_t> nibbles( ( masks.size( ) + 15 ) / 16, 0 );
+        for( size_t i = 0; i < masks.size( ); ++i )
+            nibbles[ i / 16 ] |= uint64_t( masks[ i ] ) << ( 4 * ( i % 16 ) );
+        return nibbles;
+    }
+
+    /**
+     * Find the sites starting in the chunk and put them in hits in
+     * order, as start << 32 | pattern. ring holds the patterns found at
+     * each recent start until no more can arrive there; starts arrive
+     * out of order by less than longest_, so twice that many slots
+     * cover every start not yet final.
+     * Return the number of bases the chunk owns.
+     */
+    size_t listChunk( const Chunk & chunk, ChunkBuffer & buffer, vector<vector<uint32_t> > & ring,
+                      vector<uint64_t> & hits ) const
+    {
+        size_t owned, n;
+        loadChunk( chunk, buffer, owned, n );
+        size_t slots = 1;
+        while( slots < 2 * longest_ )
+            slots *= 2;
+        ring.resize( slots );
+        hits.clear( );
+
+        size_t flushed = 0;         // Starts below this are in hits
+        auto flush = [&]( size_t upTo ) {
+            for( ; flushed < upTo; ++flushed )
+            {
+                vector<uint32_t> & slot = ring[ flushed & ( slots - 1 ) ];
+                sort( slot.begin( ), slot.end( ) );
+                for( size_t k = 0; k < slot.size( ); ++k )
+                    hits.push_back( uint64_t( flushed ) << 32 | slot[ k ] );
+                slot.clear( );
+            }
+        };
+        size_t last = 0;
+        findSites( buffer, owned, n, [&]( size_t start, uint32_t p ) {
+            // Every site found from here on starts at or after
+            // start + 1 - longest_, so the starts before that are final
+            if( start + 1 > longest_ + last )
+            {
+                last = start + 1 - longest_;
+                flush( last );
+            }
+            ring[ start & ( slots - 1 ) ].push_back( p );
+        } );
+        flush( owned );
+        return owned;
+    }
+};
+
+#endif
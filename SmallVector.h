@@ -0,0 +1,173 @@
+#ifndef SMALL_VECTOR_H
+#define SMALL_VECTOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+using namespace std;
+
+// SmallVector class
+//
+// CONSTRUCTION: zero parameter
+//
+// A growable array of trivially copyable items that keeps up to N items
+// inside the object and allocates only once it grows past N. The inline
+// items share storage with the heap pointer and capacity, so
+// SmallVector<uint32_t, 3> is 16 bytes, against 24 for an empty vector.
+//
+// ******************PUBLIC OPERATIONS*********************
+// void push_back( x )    --> Append x
+// size_t size( )         --> Return number of items
+// bool empty( )          --> Return true if there are no items
+// T operator[ ]( i )     --> Return item i; no bounds check
+// const T * begin( ), end( )  --> Iterate over the items
+// void clear( )          --> Remove all items
+
+template <typename T, size_t N>
+class SmallVector
+{
+    static_assert( is_trivially_copyable<T>::value, "SmallVector items are copied with memcpy" );
+    static_assert( N > 0, "SmallVector needs room for one inline item" );
+
+  public:
+    SmallVector( )
+    {
+        storage_.small.size = 0;
+    }
+
+    SmallVector( const SmallVector & rhs )
+    {
+        storage_.small.size = 0;
+        append( rhs.begin( ), rhs.size( ) );
+    }
+
+    SmallVector( SmallVector && rhs )
+    {
+        storage_ = rhs.storage_;
+        rhs.storage_.small.size = 0;
+    }
+
+    ~SmallVector( )
+    {
+        clear( );
+    }
+
+    SmallVector & operator=( const SmallVector & rhs )
+    {
+        if( this != &rhs )
+        {
+            clear( );
+            append( rhs.begin( ), rhs.size( ) );
+        }
+        return *this;
+    }
+
+    SmallVector & operator=( SmallVector && rhs )
+    {
+        if( this != &rhs )
+        {
+            clear( );
+            storage_ = rhs.storage_;
+            rhs.storage_.small.size = 0;
+        }
+        return *this;
+    }
+
+    size_t size( ) const
+    {
+        return storage_.small.size;
+    }
+
+    bool empty( ) const
+    {
+        return size( ) == 0;
+    }
+
+    T operator[]( size_t i ) const
+    {
+        return begin( )[ i ];
+    }
+
+    const T * begin( ) const
+    {
+        return isHeap( ) ? storage_.large.items : storage_.small.items;
+    }
+
+    const T * end( ) const
+    {
+        return begin( ) + size( );
+    }
+
+    void push_back( const T & x )
+    {
+        append( &x, 1 );
+    }
+
+    void clear( )
+    {
+        if( isHeap( ) )
+            delete [ ] storage_.large.items;
+        storage_.small.size = 0;
+    }
+
+  private:
+    // Both layouts begin with the size, so it can be read through
+    // either; the items are on the heap exactly when size exceeds N
+    struct Small
+    {
+        uint32_t size;
+        T items[ N ];
+    };
+
+    struct Large
+    {
+        uint32_t size;
+        uint32_t capacity;
+        T *items;
+    };
+
+    union Storage
+    {
+        Small small;
+        Large large;
+    } storage_;
+
+    bool isHeap( ) const
+    {
+        return storage_.small.size > N;
+    }
+
+    /**
+     * Append count items from p, moving to the heap, or to a block
+     * twice as large, when they do not fit.
+     */
+    void append( const T *p, size_t count )
+    {
+        size_t oldSize = size( );
+        size_t newSize = oldSize + count;
+        if( newSize <= N )
+        {
+            memcpy( storage_.small.items + oldSize, p, count * sizeof( T ) );
+            storage_.small.size = newSize;
+            return;
+        }
+
+        size_t capacity = isHeap( ) ? storage_.large.capacity : N;
+        if( newSize > capacity )
+        {
+            while( capacity < newSize )
+                capacity *= 2;
+            T *grown = new T[ capacity ];
+            memcpy( grown, begin( ), oldSize * sizeof( T ) );
+            if( isHeap( ) )
+                delete [ ] storage_.large.items;
+            storage_.large.items = grown;
+            storage_.large.capacity = capacity;
+        }
+        memcpy( storage_.large.items + oldSize, p, count * sizeof( T ) );
+        storage_.large.size = newSize;
+    }
+};
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef SORT_AND_MERGE_H
+#define SORT_AND_MERGE_H
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+using namespace std;
+
+/**
+ * Sort items and fold each run of equal items into its first member
+ * with merge, leaving items strictly increasing. Input that is already
+ * sorted, such as a snapshot, skips the sort. The sort is stable,
+ * so equal items are merged in their original order, exactly as if
+ * they had been inserted into a tree one at a time.
+ */
+template <typename Comparable>
+void sortAndMerge( vector<Comparable> & items )
+{
+    if( !is_sorted( items.begin( ), items.end( ) ) )
+        stable_sort( items.begin( ), items.end( ) );
+    if( items.empty( ) )
+        return;
+
+    size_t kept = 0;
+    for( size_t i = 1; i < items.size( ); ++i )
+    {
+        if( items[ kept ] < items[ i ] )
+        {
+            if( ++kept != i )
+                items[ kept ] = std::move( items[ i ] );
+        }
+        else
+            items[ kept ].merge( items[ i ] );
+    }
+    items.erase( items.begin( ) + kept + 1, items.end( ) );
+}
+
+#endif
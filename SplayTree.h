@@ -0,0 +1,693 @@
+#ifndef SPLAY_TREE_H
+#define SPLAY_TREE_H
+
+#include "dsexceptions.h"
+#include "NodePool.h"
+#include "BatchSearch.h"
+#include "SortAndMerge.h"
+#include "TreeStats.h"
+#include <algorithm>
+#include <iostream>
+#include <iterator>
+#include <utility>
+#include <vector>
+using namespace std;
+
+// SplayTree class
+//
+// CONSTRUCTION: zero parameter, a Mode, or a range of items to bulk-load;
+//               Stats is a TreeStats policy, NoStats by default
+//
+// Top-down splay tree: every find, insert and remove moves the item it
+// reaches (or the last node on its path) to the root, so recently used
+// items are cheap to reach again and a skewed workload costs far less
+// than log N per access, amortized. Lookups therefore modify the tree,
+// so find, find_count and contains are not const and one tree must not
+// be searched by several threads at once.
+//
+// In SEMI_SPLAY mode a lookup searches without writing, then, if the
+// item lies deeper than half the height of a perfectly balanced tree
+// of the same size, semi-splays it: a bottom-up pass that roughly
+// halves the depth of every node on the path with about half the
+// rotations of a splay. The top levels hold about sqrt( N ) items,
+// room for the popular ones, which settle there and are then found
+// without any writes. A miss changes nothing; insert and remove always
+// splay.
+//
+// ******************PUBLIC OPERATIONS*********************
+// void insert( x )       --> Insert x; merge into an equal item
+// void bulkLoad( items ) --> Insert a batch of items in linear time
+// void remove( x )       --> Remove x
+// bool contains( x )     --> Return true if x is present
+// Comparable * find( x ) --> Return matching item or nullptr
+// pair find_count( x )   --> find, plus number of links followed
+// void find_batch( queries, found ) --> Look up sorted queries in one pass, without splaying
+// bool remove_count( x ) --> remove; get_remove_calls( ) returns its links
+// Comparable findMin( )  --> Return smallest item
+// Comparable findMax( )  --> Return largest item
+// boolean isEmpty( )     --> Return true if empty; else false
+// void makeEmpty( )      --> Remove all items
+// void printTree( )      --> Print tree in sorted order
+// void forEach( visit )  --> Call visit on each item in sorted order
+// size_t size( )         --> Return number of items
+// size_t depth( )        --> Return summed depth of all items, in O( N )
+// void setMode( mode )   --> Switch between FULL_SPLAY and SEMI_SPLAY
+// Stats & stats( )       --> Return the statistics policy
+// ******************ERRORS********************************
+// Throws UnderflowException as warranted
+
+template <typename Comparable, typename Stats = NoStats>
+class SplayTree
+{
+  public:
+    enum Mode { FULL_SPLAY, SEMI_SPLAY };
+
+    explicit SplayTree( Mode mode = FULL_SPLAY ) : root_{ nullptr }, size_{ 0 }, mode_{ mode }
+      { }
+
+    template <typename Iterator>
+    SplayTree( Iterator first, Iterator last ) : root_{ nullptr }, size_{ 0 }, mode_{ FULL_SPLAY }
+    {
+        bulkLoad( first, last );
+    }
+
+    SplayTree( const SplayTree & rhs ) : root_{ nullptr }, size_{ rhs.size_ }, mode_{ rhs.mode_ }
+    {
+        root_ = clone( rhs.root_ );
+    }
+
+    SplayTree( SplayTree && rhs )
+      : root_{ rhs.root_ }, pool_{ std::move( rhs.pool_ ) }, size_{ rhs.size_ }, mode_{ rhs.mode_ }
+    {
+        rhs.root_ = nullptr;
+        rhs.size_ = 0;
+    }
+
+    ~SplayTree( )
+    {
+        makeEmpty( );
+    }
+
+    /**
+     * Deep copy.
+     */
+    SplayTree & operator=( const SplayTree & rhs )
+    {
+        SplayTree copy = rhs;
+        std::swap( *this, copy );
+        return *this;
+    }
+
+    /**
+     * Move.
+     */
+    SplayTree & operator=( SplayTree && rhs )
+    {
+        std::swap( root_, rhs.root_ );
+        std::swap( pool_, rhs.pool_ );
+        std::swap( size_, rhs.size_ );
+        std::swap( mode_, rhs.mode_ );
+        return *this;
+    }
+
+    /**
+     * Find the smallest item in the tree, without splaying.
+     * Throw UnderflowException if empty.
+     */
+    const Comparable & findMin( ) const
+    {
+        if( isEmpty( ) )
+            throw UnderflowException{ };
+        BinaryNode *t = root_;
+        while( t->left_ != nullptr )
+            t = t->left_;
+        return t->element_;
+    }
+
+    /**
+     * Find the largest item in the tree, without splaying.
+     * Throw UnderflowException if empty.
+     */
+    const Comparable & findMax( ) const
+    {
+        if( isEmpty( ) )
+            throw UnderflowException{ };
+        BinaryNode *t = root_;
+        while( t->right_ != nullptr )
+            t = t->right_;
+        return t->element_;
+    }
+
+    /**
+     * Returns true if x is found in the tree.
+     */
+    bool contains( const Comparable & x )
+    {
+        return find( x ) != nullptr;
+    }
+
+    /**
+     * Test if the tree is logically empty.
+     * Return true if empty, false otherwise.
+     */
+    bool isEmpty( ) const
+    {
+        return root_ == nullptr;
+    }
+
+    /**
+     * Print the tree contents in sorted order.
+     */
+    void printTree( ostream & out = cout ) const
+    {
+        if( isEmpty( ) )
+            out << "Empty tree" << endl;
+        else
+            inOrder( root_, [&out]( const Comparable & x ) { out << x << " "; } );
+        out << endl;
+    }
+
+    /**
+     * Make the tree logically empty.
+     */
+    void makeEmpty( )
+    {
+        if( !is_trivially_destructible<BinaryNode>::value )
+            makeEmpty( root_ );
+        root_ = nullptr;
+        size_ = 0;
+        pool_.release( );
+    }
+
+    /**
+     * Insert x into the tree, copying or moving it as passed;
+     * duplicates are merged into the item already present.
+     */
+    template <typename Item>
+    void insert( Item && x )
+    {
+        typename Stats::Probe probe( stats_, Stats::INSERT );
+        if( root_ != nullptr )
+        {
+            splay( x, root_, probe );
+            if( !probe.less( x, root_->element_ ) && !probe.less( root_->element_, x ) )
+            {
+                root_->element_.merge( x );
+                return;
+            }
+        }
+        BinaryNode *newNode = pool_.allocate( std::forward<Item>( x ), nullptr, nullptr );
+        probe.allocate( );
+        if( root_ != nullptr )
+        {
+            // root_ is x's neighbour, so one of its subtrees moves under newNode
+            if( probe.less( newNode->element_, root_->element_ ) )
+            {
+                newNode->left_ = root_->left_;
+                newNode->right_ = root_;
+                root_->left_ = nullptr;
+            }
+            else
+            {
+                newNode->right_ = root_->right_;
+                newNode->left_ = root_;
+                root_->right_ = nullptr;
+            }
+        }
+        root_ = newNode;
+        ++size_;
+    }
+
+    /**
+     * Add a batch of items. The batch and the current contents are
+     * sorted and merged, and the tree is rebuilt perfectly balanced
+     * in linear time.
+     */
+    void bulkLoad( vector<Comparable> items )
+    {
+        if( !isEmpty( ) )
+        {
+            vector<Comparable> current;
+            current.reserve( size( ) + items.size( ) );
+            inOrder( root_, [&current]( const Comparable & x ) { current.push_back( x ); } );
+            current.insert( current.end( ), make_move_iterator( items.begin( ) ),
+                            make_move_iterator( items.end( ) ) );
+            items.swap( current );
+            makeEmpty( );
+        }
+        sortAndMerge( items );
+        size_ = items.size( );
+        root_ = buildBalanced( items, 0, items.size( ) );
+    }
+
+    /**
+     * Add the items in [ first, last ) as one batch.
+     */
+    template <typename Iterator>
+    void bulkLoad( Iterator first, Iterator last )
+    {
+        bulkLoad( vector<Comparable>( first, last ) );
+    }
+
+    /**
+     * Remove x from the tree. Nothing is done if x is not found.
+     */
+    void remove( const Comparable & x )
+    {
+        typename Stats::Probe probe( stats_, Stats::REMOVE );
+        remove( x, probe );
+    }
+
+    /**
+     * Return the matching item, or nullptr if x is not found.
+     */
+    Comparable * find( const Comparable & x )
+    {
+        typename Stats::Probe probe( stats_, Stats::FIND );
+        return find( x, probe );
+    }
+
+    pair<Comparable *, int> find_count( const Comparable & x )
+    {
+        typename Stats::LinkProbe probe( stats_, Stats::FIND );
+        Comparable *found = find( x, probe );
+        return pair<Comparable *, int>( found, probe.links( ) );
+    }
+
+    /**
+     * Look up queries sorted in increasing order in one traversal.
+     * Nothing is splayed, so a batch leaves the tree as it was.
+     */
+    void find_batch( const vector<Comparable> & queries, vector<const Comparable *> & found ) const
+    {
+        findBatch( root_, queries, found );
+    }
+
+    bool remove_count( const Comparable & x )
+    {
+        typename Stats::LinkProbe probe( stats_, Stats::REMOVE );
+        return remove( x, probe );
+    }
+
+    int get_remove_calls( ) const
+    {
+        return stats_.lastLinks( Stats::REMOVE );
+    }
+
+    size_t size( ) const
+    {
+        return size_;
+    }
+
+    /**
+     * Return the sum of the node depths, with the root at depth 1 and
+     * each leaf counted once more, as AvlTree::depth( ) does. Splaying
+     * moves nodes at every access, so depths are not kept in the nodes
+     * and this walks the whole tree.
+     */
+    size_t depth( ) const
+    {
+        size_t sum = 0;
+        vector<pair<BinaryNode *, size_t> > pending;
+        if( root_ != nullptr )
+            pending.push_back( make_pair( root_, size_t( 1 ) ) );
+        while( !pending.empty( ) )
+        {
+            BinaryNode *t = pending.back( ).first;
+            size_t level = pending.back( ).second;
+            pending.pop_back( );
+            sum += level;
+            if( t->left_ == nullptr && t->right_ == nullptr )
+                sum++;
+            if( t->left_ != nullptr )
+                pending.push_back( make_pair( t->left_, level + 1 ) );
+            if( t->right_ != nullptr )
+                pending.push_back( make_pair( t->right_, level + 1 ) );
+        }
+        return sum;
+    }
+
+    template <typename Visitor>
+    void forEach( Visitor visit ) const
+    {
+        inOrder( root_, visit );
+    }
+
+    Mode mode( ) const
+    {
+        return mode_;
+    }
+
+    void setMode( Mode mode )
+    {
+        mode_ = mode;
+    }
+
+    /**
+     * Return the statistics policy, to read or reset its counts.
+     */
+    const Stats & stats( ) const
+    {
+        return stats_;
+    }
+
+    Stats & stats( )
+    {
+        return stats_;
+    }
+
+  private:
+    struct BinaryNode
+    {
+        Comparable element_;
+        BinaryNode *left_;
+        BinaryNode *right_;
+
+        BinaryNode( const Comparable & the_element, BinaryNode *lt, BinaryNode *rt )
+          : element_{ the_element }, left_{ lt }, right_{ rt } { }
+
+        BinaryNode( Comparable && the_element, BinaryNode *lt, BinaryNode *rt )
+          : element_{ std::move( the_element ) }, left_{ lt }, right_{ rt } { }
+    };
+
+    BinaryNode *root_;
+    NodePool<BinaryNode> pool_;
+    size_t size_;
+    Mode mode_;
+    vector<BinaryNode **> path_;    // Links walked by the last semi-splayed find
+    Stats stats_;
+
+    /**
+     * Internal method to find x, splaying it to the root, or in
+     * SEMI_SPLAY mode searching without writing and then semi-splaying
+     * x if it lies below the top levels.
+     */
+    template <typename Probe>
+    Comparable * find( const Comparable & x, Probe & probe )
+    {
+        if( root_ == nullptr )
+            return nullptr;
+        if( mode_ == FULL_SPLAY )
+        {
+            splay( x, root_, probe );
+            if( probe.less( x, root_->element_ ) || probe.less( root_->element_, x ) )
+                return nullptr;
+            return &root_->element_;
+        }
+
+        path_.clear( );
+        BinaryNode **link = &root_;
+        while( *link != nullptr )
+        {
+            if( probe.less( x, ( *link )->element_ ) )
+            {
+                path_.push_back( link );
+                link = &( *link )->left_;
+            }
+            else if( probe.less( ( *link )->element_, x ) )
+            {
+                path_.push_back( link );
+                link = &( *link )->right_;
+            }
+            else
+                break;
+            probe.follow( );
+        }
+        if( *link == nullptr )
+            return nullptr;     // A miss changes nothing
+
+        // Rotations move nodes, not items, so the item stays put
+        Comparable *found = &( *link )->element_;
+        int topLevels = 1;
+        for( size_t n = size_; n > 3; n >>= 2 )
+            ++topLevels;
+        if( path_.size( ) >= size_t( topLevels ) )
+            semiSplay( link, probe );
+        return found;
+    }
+
+    /**
+     * Internal method to semi-splay the node at *link, whose ancestors'
+     * links are path_, root first. Each step looks at the node, its
+     * parent and its grandparent. In a zig-zag the node is rotated up
+     * two levels as in a splay. In a zig-zig only the parent is
+     * rotated over the grandparent, and the next step starts from the
+     * parent. Every node on the path ends up about half as deep, with
+     * about half the rotations of a splay.
+     */
+    template <typename Probe>
+    void semiSplay( BinaryNode **link, Probe & probe )
+    {
+        size_t k = path_.size( );   // *link is at depth k, root at 0
+        int levels = 0;
+        while( k >= 2 )
+        {
+            BinaryNode **parent = path_[ k - 1 ];
+            BinaryNode **grand = path_[ k - 2 ];
+            bool leftChild = ( *parent )->left_ == *link;
+            bool parentLeftChild = ( *grand )->left_ == *parent;
+            if( leftChild == parentLeftChild )
+            {
+                if( parentLeftChild )
+                    rotateWithLeftChild( *grand );
+                else
+                    rotateWithRightChild( *grand );
+                probe.rotate( false );
+            }
+            else
+            {
+                if( leftChild )
+                {
+                    rotateWithLeftChild( *parent );
+                    rotateWithRightChild( *grand );
+                }
+                else
+                {
+                    rotateWithRightChild( *parent );
+                    rotateWithLeftChild( *grand );
+                }
+                probe.rotate( true );
+            }
+            // Either way the next step starts from the node now at *grand
+            link = grand;
+            k -= 2;
+            ++levels;
+        }
+        if( k == 1 )
+        {
+            if( root_->left_ == *link )
+                rotateWithLeftChild( root_ );
+            else
+                rotateWithRightChild( root_ );
+            probe.rotate( false );
+            ++levels;
+        }
+        probe.rebalance( levels );
+    }
+
+    /**
+     * Internal method to remove x: splay it to the root, then splay
+     * the largest item of its left subtree up to replace it.
+     * probe counts the links followed by both splays.
+     * Return true if x was removed.
+     */
+    template <typename Probe>
+    bool remove( const Comparable & x, Probe & probe )
+    {
+        if( root_ == nullptr )
+            return false;
+        splay( x, root_, probe );
+        if( probe.less( x, root_->element_ ) || probe.less( root_->element_, x ) )
+            return false;   // Item not found; do nothing
+
+        BinaryNode *oldNode = root_;
+        if( root_->left_ == nullptr )
+            root_ = root_->right_;
+        else
+        {
+            // Everything on the left is smaller than x, so splaying x
+            // there brings the largest item up with no right child
+            root_ = root_->left_;
+            splay( x, root_, probe );
+            root_->right_ = oldNode->right_;
+        }
+        pool_.deallocate( oldNode );
+        --size_;
+        return true;
+    }
+
+    /**
+     * Internal method to perform a top-down splay. The last node
+     * accessed becomes the new root: x if it is present, else its
+     * predecessor or successor. Nodes left of the path are hung on a
+     * left tree, those right of it on a right tree, and the two are
+     * reassembled under the new root at the end.
+     * probe counts each level descended, each zig-zig rotation and
+     * the levels splayed.
+     */
+    template <typename Probe>
+    void splay( const Comparable & x, BinaryNode * & t, Probe & probe )
+    {
+        BinaryNode *leftTree = nullptr;
+        BinaryNode *rightTree = nullptr;
+        BinaryNode **leftTreeMax = &leftTree;       // Link that takes the next smaller node
+        BinaryNode **rightTreeMin = &rightTree;     // Link that takes the next larger node
+        int levels = 0;
+
+        while( true )
+        {
+            if( probe.less( x, t->element_ ) )
+            {
+                probe.follow( );
+                if( t->left_ == nullptr )
+                    break;
+                if( probe.less( x, t->left_->element_ ) )
+                {
+                    rotateWithLeftChild( t );
+                    probe.rotate( false );
+                    probe.follow( );
+                    if( t->left_ == nullptr )
+                        break;
+                }
+                // Link t into the right tree
+                *rightTreeMin = t;
+                rightTreeMin = &t->left_;
+                t = t->left_;
+            }
+            else if( probe.less( t->element_, x ) )
+            {
+                probe.follow( );
+                if( t->right_ == nullptr )
+                    break;
+                if( probe.less( t->right_->element_, x ) )
+                {
+                    rotateWithRightChild( t );
+                    probe.rotate( false );
+                    probe.follow( );
+                    if( t->right_ == nullptr )
+                        break;
+                }
+                // Link t into the left tree
+                *leftTreeMax = t;
+                leftTreeMax = &t->right_;
+                t = t->right_;
+            }
+            else
+                break;
+            ++levels;
+        }
+
+        *leftTreeMax = t->left_;
+        *rightTreeMin = t->right_;
+        t->left_ = leftTree;
+        t->right_ = rightTree;
+        probe.rebalance( levels );
+    }
+
+    /**
+     * Rotate binary tree node with left child.
+     */
+    void rotateWithLeftChild( BinaryNode * & k2 )
+    {
+        BinaryNode *k1 = k2->left_;
+        k2->left_ = k1->right_;
+        k1->right_ = k2;
+        k2 = k1;
+    }
+
+    /**
+     * Rotate binary tree node with right child.
+     */
+    void rotateWithRightChild( BinaryNode * & k1 )
+    {
+        BinaryNode *k2 = k1->right_;
+        k1->right_ = k2->left_;
+        k2->left_ = k1;
+        k1 = k2;
+    }
+
+    /**
+     * Internal method to build a perfectly balanced subtree from the
+     * sorted items[ lo, hi ), moving each item into its node.
+     * The recursion is only log2( hi - lo ) deep.
+     */
+    BinaryNode * buildBalanced( vector<Comparable> & items, size_t lo, size_t hi )
+    {
+        if( lo == hi )
+            return nullptr;
+        size_t mid = lo + ( hi - lo ) / 2;
+        BinaryNode *lt = buildBalanced( items, lo, mid );
+        BinaryNode *rt = buildBalanced( items, mid + 1, hi );
+        return pool_.allocate( std::move( items[ mid ] ), lt, rt );
+    }
+
+    /**
+     * Internal method to make subtree empty.
+     * Rotating each left child up flattens the tree into a right
+     * spine that is then destroyed front to back, without a stack.
+     */
+    void makeEmpty( BinaryNode * & t )
+    {
+        while( t != nullptr )
+        {
+            if( t->left_ != nullptr )
+            {
+                BinaryNode *lt = t->left_;
+                t->left_ = lt->right_;
+                lt->right_ = t;
+                t = lt;
+            }
+            else
+            {
+                BinaryNode *rt = t->right_;
+                pool_.destroy( t );
+                t = rt;
+            }
+        }
+    }
+
+    /**
+     * Internal method to visit the items of subtree t in sorted order.
+     * The explicit stack grows with the height, which is unbounded here.
+     */
+    template <typename Visitor>
+    void inOrder( BinaryNode *t, Visitor visit ) const
+    {
+        vector<BinaryNode *> pending;
+        while( t != nullptr || !pending.empty( ) )
+        {
+            while( t != nullptr )
+            {
+                pending.push_back( t );
+                t = t->left_;
+            }
+            t = pending.back( );
+            pending.pop_back( );
+            visit( t->element_ );
+            t = t->right_;
+        }
+    }
+
+    /**
+     * Internal method to clone subtree.
+     */
+    BinaryNode * clone( BinaryNode *t )
+    {
+        BinaryNode *copy = nullptr;
+        vector<pair<BinaryNode *, BinaryNode **> > pending( 1, make_pair( t, &copy ) );
+        while( !pending.empty( ) )
+        {
+            BinaryNode *from = pending.back( ).first;
+            BinaryNode **link = pending.back( ).second;
+            pending.pop_back( );
+            if( from == nullptr )
+                continue;
+            *link = pool_.allocate( from->element_, nullptr, nullptr );
+            pending.push_back( make_pair( from->left_, &( *link )->left_ ) );
+            pending.push_back( make_pair( from->right_, &( *link )->right_ ) );
+        }
+        return copy;
+    }
+};
+
+#endif
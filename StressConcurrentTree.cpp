@@ -0,0 +1,123 @@
+#include "ConcurrentAvlTree.h"
+#include "SequenceMap.cpp"
+
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+#include <thread>
+#include <cstdlib>
+using namespace std;
+
+// Stress test for ConcurrentAvlTree. Every thread runs a random mix of
+// insert, remove and find on keys of its own, which interleave in key
+// order with every other thread's keys so that rotations keep crossing
+// between threads. Since a key has one writer, each thread can check
+// every result against its own model as it goes. All threads also
+// merge into a small set of shared keys, which checks that no merge is
+// lost. Once the threads are done, the tree must match the models
+// exactly and pass isValid.
+
+struct ThreadReport {
+    map<string, vector<string> > model;     // Private keys and their acronyms
+    long shared_inserts = 0;
+    long errors = 0;
+};
+
+string PrivateKey(int key, int thread) {
+    return "K" + to_string(key) + "." + to_string(thread);
+}
+
+string SharedKey(int key) {
+    return "SHARED" + to_string(key);
+}
+
+void RunThread(ConcurrentAvlTree<SequenceMap> &tree, int thread, int operations, int keys,
+               int shared_keys, unsigned seed, ThreadReport &report) {
+    mt19937 random(seed + thread);
+    for (int i = 0; i < operations; i++) {
+        int op = random() % 100;
+        if (op < 10) {
+            string acronym = "S" + to_string(thread) + "." + to_string(i);
+            tree.insert(SequenceMap(SharedKey(random() % shared_keys), acronym));
+            report.shared_inserts++;
+            continue;
+        }
+        string key = PrivateKey(random() % keys, thread);
+        if (op < 40) {
+            string acronym = "P" + to_string(i);
+            tree.insert(SequenceMap(key, acronym));
+            report.model[key].push_back(acronym);
+        } else if (op < 70) {
+            bool expected = report.model.erase(key) == 1;
+            if (tree.remove(SequenceMap(key, "")) != expected) report.errors++;
+        } else {
+            map<string, vector<string> >::const_iterator expected = report.model.find(key);
+            bool matches = true;
+            bool found = tree.find(SequenceMap(key, ""), [&](const SequenceMap &item) {
+                matches = expected != report.model.end() &&
+                          item.getEnzymeAcronyms() == expected->second;
+            });
+            if (found != (expected != report.model.end()) || !matches) report.errors++;
+        }
+    }
+}
+
+int
+main(int argc, char **argv) {
+    if (argc > 4) {
+        cout << "Usage: " << argv[0] << " [threads] [operations per thread] [seed]" << endl;
+        return 0;
+    }
+    int threads = argc >= 2 ? atoi(argv[1]) : 4;
+    int operations = argc >= 3 ? atoi(argv[2]) : 200000;
+    unsigned seed = argc == 4 ? atoi(argv[3]) : 1;
+    const int keys = 2000, shared_keys = 50;
+    if (threads < 1 || operations < 0) {
+        cout << "Need at least one thread" << endl;
+        return 1;
+    }
+    cout << threads << " threads, " << operations << " operations each, seed " << seed << endl;
+
+    ConcurrentAvlTree<SequenceMap> tree;
+    vector<ThreadReport> reports(threads);
+    vector<thread> workers;
+    for (int t = 0; t < threads; t++)
+        workers.push_back(thread(RunThread, ref(tree), t, operations, keys, shared_keys, seed,
+                                 ref(reports[t])));
+    for (int t = 0; t < threads; t++) workers[t].join();
+
+    long errors = 0, shared_inserts = 0;
+    size_t expected_size = 0;
+    for (int t = 0; t < threads; t++) {
+        errors += reports[t].errors;
+        shared_inserts += reports[t].shared_inserts;
+        expected_size += reports[t].model.size();
+        for (map<string, vector<string> >::const_iterator it = reports[t].model.begin();
+             it != reports[t].model.end(); ++it) {
+            bool matches = false;
+            tree.find(SequenceMap(it->first, ""), [&](const SequenceMap &item) {
+                matches = item.getEnzymeAcronyms() == it->second;
+            });
+            if (!matches) errors++;
+        }
+    }
+    cout << "Results that disagreed with the model: " << errors << endl;
+
+    long merged = 0;
+    for (int k = 0; k < shared_keys; k++)
+        if (tree.find(SequenceMap(SharedKey(k), ""), [&](const SequenceMap &item) {
+                merged += item.getEnzymeCount();
+            }))
+            expected_size++;
+    cout << "Shared merges: " << merged << " of " << shared_inserts << endl;
+
+    bool valid = tree.isValid();
+    cout << "Size: " << tree.size() << " (expected " << expected_size << "), tree is "
+         << (valid ? "valid" : "NOT valid") << endl;
+
+    bool passed = errors == 0 && merged == shared_inserts && tree.size() == expected_size && valid;
+    cout << (passed ? "PASS" : "FAIL") << endl;
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,64 @@
+#ifndef STRING_SEQUENCE_H
+#define STRING_SEQUENCE_H
+
+#include <cstddef>
+#include <functional>
+#include <string>
+using namespace std;
+
+// StringSequence class
+//
+// CONSTRUCTION: with a string, or a pointer and a length
+//
+// A recognition sequence kept as a plain string, with the interface of
+// PackedSequence. SequenceMap uses it in place of the packed key when
+// built with SEQUENCE_MAP_STRING_KEY defined, to compare the two.
+//
+// ******************PUBLIC OPERATIONS*********************
+// bool operator<( rhs )  --> Compare as the strings compare
+// string str( )          --> Return the sequence as a string
+// size_t length( )       --> Return number of symbols
+// size_t hash( )         --> Return a hash of the sequence
+
+class StringSequence
+{
+  public:
+    StringSequence( )
+    {
+    }
+
+    explicit StringSequence( const string & s )
+      : sequence_{ s }
+    {
+    }
+
+    StringSequence( const char *s, size_t length )
+      : sequence_( s, length )
+    {
+    }
+
+    size_t length( ) const
+    {
+        return sequence_.size( );
+    }
+
+    bool operator<( const StringSequence & rhs ) const
+    {
+        return sequence_ < rhs.sequence_;
+    }
+
+    size_t hash( ) const
+    {
+        return std::hash<string>( )( sequence_ );
+    }
+
+    string str( ) const
+    {
+        return sequence_;
+    }
+
+  private:
+    string sequence_;
+};
+
+#endif
@@ -0,0 +1,147 @@
+#include "AvlTree.h"
+#include "DurableTree.h"
+#include "SequenceMap.cpp"
+#include "RebaseParser.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <sys/stat.h>
+using namespace std;
+
+// Restart and logging benchmark for DurableTree. Compares rebuilding a
+// tree by reparsing the REBASE file against restoring it from a
+// snapshot plus write-ahead log, and measures the cost of a logged
+// insert for the given group-commit and fsync settings.
+
+double ElapsedMs(chrono::steady_clock::time_point start) {
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+// The mutation workload: every tenth sequence is removed, every other
+// sequence gains one more enzyme acronym
+template <typename TreeType>
+void ApplyUpdates(TreeType &a_tree, const vector<SequenceMap> &sequence_maps) {
+    for (size_t i = 0; i < sequence_maps.size(); i++) {
+        string sequence = sequence_maps[i].getRecognitionSequence();
+        if (i % 10 == 0)
+            a_tree.remove(SequenceMap(sequence, ""));
+        else
+            a_tree.insert(SequenceMap(sequence, "Upd" + to_string(i)));
+    }
+}
+
+// True if restored holds exactly the items of expected, enzymes included
+bool SameContents(const AvlTree<SequenceMap> &expected, DurableTree &restored) {
+    bool same = restored.size() == expected.size();
+    expected.forEach([&restored, &same](const SequenceMap &x) {
+        SequenceMap *found = restored.find(x);
+        if (found == nullptr || found->getEnzymeAcronyms() != x.getEnzymeAcronyms())
+            same = false;
+    });
+    return same;
+}
+
+// Start from an empty state directory
+void ClearState(const string &directory) {
+    mkdir(directory.c_str(), 0755);
+    remove((directory + "/snapshot.bin").c_str());
+    remove((directory + "/wal.bin").c_str());
+}
+
+int
+main(int argc, char **argv) {
+    if (argc < 3 || argc > 5) {
+        cout << "Usage: " << argv[0] << " <databasefilename> <directory> [group-commit] [sync-every]" << endl;
+        return 0;
+    }
+    string db_filename(argv[1]);
+    string directory(argv[2]);
+    DurabilityOptions options;
+    if (argc >= 4) options.groupCommitRecords = strtoul(argv[3], nullptr, 10);
+    if (argc == 5) options.syncEveryCommits = strtoul(argv[4], nullptr, 10);
+    options.checkpointEveryRecords = 0;
+    cout << "Group commit " << options.groupCommitRecords << " records, fdatasync every "
+         << options.syncEveryCommits << " writes" << endl;
+
+    // Baseline: reparse the file, bulk load, and reapply the updates
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    vector<SequenceMap> sequence_maps;
+    if (!ReadRebaseFile(db_filename, sequence_maps)) {
+        cout << "Cannot read " << db_filename << endl;
+        return 1;
+    }
+    AvlTree<SequenceMap> rebuilt;
+    rebuilt.bulkLoad(sequence_maps);
+    ApplyUpdates(rebuilt, sequence_maps);
+    double rebuild_ms = ElapsedMs(start);
+
+    ClearState(directory);
+    size_t expected_size = 0;
+    {
+        DurableTree durable(directory, options);
+        if (!durable.open()) {
+            cout << "Cannot open state in " << directory << endl;
+            return 1;
+        }
+        start = chrono::steady_clock::now();
+        durable.bulkLoad(sequence_maps);
+        cout << "Checkpoint Time: " << ElapsedMs(start) << " ms" << endl;
+
+        start = chrono::steady_clock::now();
+        ApplyUpdates(durable, sequence_maps);
+        durable.sync();
+        double update_ms = ElapsedMs(start);
+        cout << "Logged Updates: " << sequence_maps.size() << " in " << update_ms << " ms, "
+             << update_ms * 1000 / sequence_maps.size() << " us each" << endl;
+        expected_size = durable.size();
+    }
+
+    // Restart: snapshot plus log replay
+    DurableTree restored(directory, options);
+    start = chrono::steady_clock::now();
+    if (!restored.open()) {
+        cout << "Cannot restore state from " << directory << endl;
+        return 1;
+    }
+    double restore_ms = ElapsedMs(start);
+
+    cout << "Rebuild Time: " << rebuild_ms << " ms" << endl;
+    cout << "Restore Time: " << restore_ms << " ms (" << restored.replayedRecords()
+         << " log records replayed)" << endl;
+    bool same = rebuilt.size() == expected_size && SameContents(rebuilt, restored);
+    cout << "Restored Size: " << restored.size() << (same ? " (matches)" : " (MISMATCH)") << endl;
+
+    // Restart again after a checkpoint: snapshot only
+    restored.checkpoint();
+    DurableTree from_snapshot(directory, options);
+    start = chrono::steady_clock::now();
+    from_snapshot.open();
+    cout << "Snapshot Restore Time: " << ElapsedMs(start) << " ms" << endl;
+    same = same && from_snapshot.size() == expected_size;
+
+    // Restart again after automatic checkpoints in the middle of the
+    // updates, so that some land between a checkpoint and the log tail
+    ClearState(directory);
+    DurabilityOptions checkpointed = options;
+    checkpointed.checkpointEveryRecords = 97;
+    {
+        DurableTree durable(directory, checkpointed);
+        if (!durable.open()) {
+            cout << "Cannot open state in " << directory << endl;
+            return 1;
+        }
+        durable.bulkLoad(sequence_maps);
+        ApplyUpdates(durable, sequence_maps);
+        durable.sync();
+    }
+    DurableTree after_checkpoints(directory, checkpointed);
+    bool same_checkpointed = after_checkpoints.open() && SameContents(rebuilt, after_checkpoints);
+    cout << "Checkpointed Restore Size: " << after_checkpoints.size() << " ("
+         << after_checkpoints.replayedRecords() << " log records replayed)"
+         << (same_checkpointed ? " (matches)" : " (MISMATCH)") << endl;
+    return same && same_checkpointed ? 0 : 1;
+}
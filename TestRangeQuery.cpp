@@ -1,51 +1,24 @@
 #include "AvlTree.h"
+#include "BPlusTree.h"
 #include "SequenceMap.cpp"
+#include "RebaseParser.h"
 
 #include <iostream>
 #include <fstream>
 #include <string>
+#include <vector>
+#include <cstdlib>
 using namespace std;
 
-// Get enzyme acronym
-string GetEnzymeAcronym(string &db_line) {
-    size_t loc = db_line.find("/");
-    string ret = db_line.substr(0, loc);
-    //remove acronym
-    db_line = db_line.substr(loc + 1);
-    return ret;
-}
-
-// Get recognition sequence
-bool GetNextRecognitionSequence(string &db_line, string &a_reco_seq) {
-    size_t loc = db_line.find("/");
-    if (loc == string::npos || loc == db_line.size() - 1) {
-        return false;
-    }
-
-    a_reco_seq = db_line.substr(0, loc);
-    //remove sequence
-    db_line = db_line.substr(loc + 1);
-
-    return true;
-}
-
 template<typename TreeType>
 void PopulateRangeTree(TreeType &a_tree, string &db_filename) {
-    string db_line;
-    fstream fin(db_filename.c_str());
-    for (int i = 0; i < 10; i++)
-        getline(fin, db_line);
-    // read file line by line
-    while (getline(fin, db_line)) {
-        string an_enz_acro = GetEnzymeAcronym(db_line);
-
-        string a_reco_seq;
-        while (GetNextRecognitionSequence(db_line, a_reco_seq)) {
-            SequenceMap new_sequence_map(a_reco_seq, an_enz_acro);
-            a_tree.insert(new_sequence_map);
-        }
+    vector<SequenceMap> sequence_maps;
+    if (!ReadRebaseFile(db_filename, sequence_maps)) {
+        cout << "Cannot read " << db_filename << endl;
+        exit(1);
     }
-    fin.close();
+    // build the whole tree at once
+    a_tree.bulkLoad(std::move(sequence_maps));
 }
 
 template <typename TreeType>
@@ -56,23 +29,42 @@ void TestRangeTree(TreeType &a_tree, const string &str1, const string &str2) {
     a_tree.range(s1, s2);
 }
 
+// Counts without visiting the sequences, from the subtree sizes
+void CountRangeTree(const AvlTree<SequenceMap> &a_tree, const string &str1, const string &str2) {
+    SequenceMap s1(str1, "");
+    SequenceMap s2(str2, "");
+
+    cout << "Number of sequences in range: " << a_tree.count_range(s1, s2) << endl;
+}
+
 // Sample main for program testTrees
 int
 main(int argc, char **argv) {
-    if (argc != 4) {
-        cout << "Usage: " << argv[0] << " <databasefilename> <string> <string2>" << endl;
+    if (argc != 4 && argc != 5) {
+        cout << "Usage: " << argv[0] << " <databasefilename> <string> <string2> [tree-type]" << endl;
         return 0;
     }
+    // Ranges can be large; let cout buffer instead of syncing with stdio
+    ios_base::sync_with_stdio(false);
     string db_filename(argv[1]);
     string str1(argv[2]);
     string str2(argv[3]);
+    string param_tree(argc == 5 ? argv[4] : "AVL");
     cout << "Input file is " << db_filename << " ";
     cout << "String 1 is " << str1 << "   and string 2 is " << str2 << endl;
 
-    AvlTree<SequenceMap> a_tree;
-    PopulateRangeTree(a_tree, db_filename);
-
-    TestRangeTree(a_tree, str1, str2);
+    if (param_tree == "AVL") {
+        AvlTree<SequenceMap> a_tree;
+        PopulateRangeTree(a_tree, db_filename);
+        TestRangeTree(a_tree, str1, str2);
+        CountRangeTree(a_tree, str1, str2);
+    } else if (param_tree == "BTREE") {
+        BPlusTree<SequenceMap> a_tree;
+        PopulateRangeTree(a_tree, db_filename);
+        TestRangeTree(a_tree, str1, str2);
+    } else {
+        cout << "Unknown tree type " << param_tree << " (User should provide AVL, or BTREE)" << endl;
+    }
 
     return 0;
 }
@@ -1,6 +1,13 @@
 #include "BinarySearchTree.h"
 #include "AvlTree.h"
+#include "BPlusTree.h"
+#include "SequenceHashMap.h"
+#include "SplayTree.h"
 #include "SequenceMap.cpp"
+#include "RebaseParser.h"
+#include "ThreadPool.h"
+#include "PerfCounters.h"
+#include "TreeStats.h"
 
 #include <iostream>
 #include <fstream>
@@ -8,54 +15,90 @@
 #include <vector>
 #include <utility>
 #include <cmath>
+#include <chrono>
+#include <cstdlib>
+#include <algorithm>
 using namespace std;
 
-// Get enzyme acronym
-string GetEnzymeAcronym(string &db_line) {
-    size_t loc = db_line.find("/");
-    string ret = db_line.substr(0, loc);
-    //remove acronym
-    db_line = db_line.substr(loc + 1);
-    return ret;
+template<typename TreeType>
+void PopulateTestTree(TreeType &a_tree, string &db_filename) {
+    vector<SequenceMap> sequence_maps;
+    if (!ReadRebaseFile(db_filename, sequence_maps)) {
+        cout << "Cannot read " << db_filename << endl;
+        exit(1);
+    }
+    // build the whole tree at once
+    a_tree.bulkLoad(std::move(sequence_maps));
 }
 
-// Get recognition sequence
-bool GetNextRecognitionSequence(string &db_line, string &a_reco_seq) {
-    size_t loc = db_line.find("/");
-    if (loc == string::npos || loc == db_line.size() - 1) {
-        return false;
-    }
+// Milliseconds elapsed since start
+double ElapsedMs(const chrono::steady_clock::time_point &start) {
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
 
-    a_reco_seq = db_line.substr(0, loc);
-    //remove sequence
-    db_line = db_line.substr(loc + 1);
+// Hardware counters for each phase, or nullptr unless --perf was given
+PerfCounters *phase_counters = nullptr;
 
-    return true;
+void StartCounters() {
+    if (phase_counters != nullptr) phase_counters->start();
 }
 
+// Print the counts since StartCounters, divided over ops operations
+void ReportCounters(const string &phase, size_t ops) {
+    if (phase_counters == nullptr) return;
+    phase_counters->stop();
+    phase_counters->report(cout, phase, ops);
+}
+
+// The counting policy of a tree built with OperationStats, else nullptr
 template<typename TreeType>
-void PopulateTestTree(TreeType &a_tree, string &db_filename) {
-    string db_line;
-    fstream fin(db_filename.c_str());
-    for (int i = 0; i < 10; i++)
-        getline(fin, db_line);
-    // read file line by line
-    while (getline(fin, db_line)) {
-        string an_enz_acro = GetEnzymeAcronym(db_line);
-
-        string a_reco_seq;
-        while (GetNextRecognitionSequence(db_line, a_reco_seq)) {
-            SequenceMap new_sequence_map(a_reco_seq, an_enz_acro);
-            a_tree.insert(new_sequence_map);
-        }
-    }
-    fin.close();
+OperationStats *StatsOf(TreeType &) {
+    return nullptr;
+}
+
+template<typename Comparable>
+OperationStats *StatsOf(AvlTree<Comparable, OperationStats> &a_tree) {
+    return &a_tree.stats();
+}
+
+template<typename Comparable>
+OperationStats *StatsOf(BinarySearchTree<Comparable, OperationStats> &a_tree) {
+    return &a_tree.stats();
+}
+
+template<typename Comparable>
+OperationStats *StatsOf(SplayTree<Comparable, OperationStats> &a_tree) {
+    return &a_tree.stats();
+}
+
+// Set by --stats: print the tree's operation statistics for each phase
+bool show_stats = false;
+
+template<typename TreeType>
+void StartStats(TreeType &a_tree) {
+    if (show_stats && StatsOf(a_tree) != nullptr) StatsOf(a_tree)->reset();
+}
+
+template<typename TreeType>
+void ReportStats(TreeType &a_tree) {
+    if (show_stats && StatsOf(a_tree) != nullptr) StatsOf(a_tree)->report(cout);
+}
+
+template<typename TreeType>
+void TimedPopulateTestTree(TreeType &a_tree, string &db_filename) {
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    StartCounters();
+    PopulateTestTree(a_tree, db_filename);
+    double populate_ms = ElapsedMs(start);
+    ReportCounters("Populate", a_tree.size());
+    cout << "Populate Time: " << populate_ms << " ms" << endl;
+    cout << endl;
 }
 
 template<typename TreeType>
 void displayLogistics(TreeType &a_tree) {
-    int size = a_tree.size();
-    int depth = a_tree.depth();
+    size_t size = a_tree.size();
+    double depth = a_tree.depth();
     double average_depth = (double) depth / size;
     cout << "Size: " << size << endl;
     cout << "Average Depth: " << average_depth << endl;
@@ -74,30 +117,94 @@ void readSequences(vector<SequenceMap> &sequences, const string &sequence_file)
 }
 
 template <typename TreeType>
-void TestTestTree(TreeType &a_tree, const string &sequence_file) {
-    vector<SequenceMap> sequences;
-    readSequences(sequences, sequence_file);
-
-    displayLogistics(a_tree);
-
-    // (Successes, Queries)
+void TestTreeQueries(TreeType &a_tree, const vector<SequenceMap> &sequences) {
     int successful_query = 0;
     int total_query = 0;
-    int successful_removal = 0;
-    int total_removal = 0;
 
+    StartStats(a_tree);
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    StartCounters();
     for (size_t i = 0; i < sequences.size(); i++) {
-        pair<SequenceMap*, int> result = a_tree.find_count(sequences[i]);
+        auto result = a_tree.find_count(sequences[i]);
         if (result.first != nullptr) {
             successful_query++;
         }
         total_query += result.second;
     }
+    double query_ms = ElapsedMs(start);
+    ReportCounters("Query", sequences.size());
     cout << "Total Successful Queries: " << successful_query << endl;
     cout << "Total Recursive Calls: " << total_query << endl;
     cout << "Average Number of Recursion Calls: " << (double) total_query / sequences.size() << endl;
+    cout << "Query Time: " << query_ms << " ms" << endl;
+    ReportStats(a_tree);
     cout << endl;
+}
+
+// Per-worker query tallies, one cache line each so that two workers
+// never write to the same line
+struct alignas(64) QueryTally {
+    long successful;
+    long calls;
+};
+
+// Run the queries on 1, 2, 4, ... up to max_threads workers sharing the
+// read-only tree, merge the per-worker counts, and report the speedup.
+// Lookups on a const tree count links in their own probe and leave the
+// tree's statistics alone, so the workers share nothing they write
+template <typename TreeType>
+void TestParallelQueries(const TreeType &a_tree, const vector<SequenceMap> &sequences, size_t max_threads) {
+    if (sequences.empty()) return;
+    // Repeat the query list so that each run is long enough to time
+    size_t rounds = (500000 + sequences.size() - 1) / sequences.size();
+    size_t total = rounds * sequences.size();
+    cout << "Parallel Queries: " << total << " lookups per run" << endl;
+
+    double single_ms = 0;
+    for (size_t threads = 1; ; threads = min(threads * 2, max_threads)) {
+        ThreadPool pool(threads);
+        vector<QueryTally> tallies(threads, QueryTally());
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        pool.parallelFor(total, 1024, [&](size_t begin, size_t end, size_t worker) {
+            long successful = 0, calls = 0;
+            for (size_t i = begin; i < end; i++) {
+                auto result = a_tree.find_count(sequences[i % sequences.size()]);
+                if (result.first != nullptr) successful++;
+                calls += result.second;
+            }
+            tallies[worker].successful += successful;
+            tallies[worker].calls += calls;
+        });
+        double ms = ElapsedMs(start);
+        if (threads == 1) single_ms = ms;
+
+        long successful = 0, calls = 0;
+        for (size_t i = 0; i < tallies.size(); i++) {
+            successful += tallies[i].successful;
+            calls += tallies[i].calls;
+        }
+        cout << "Threads: " << threads << "  Time: " << ms << " ms  Queries/sec: " << total / ms * 1000
+             << "  Speedup: " << single_ms / ms << "  Successful: " << successful
+             << "  Calls: " << calls << endl;
+        if (threads == max_threads) break;
+    }
+    cout << endl;
+}
+
+// A splay tree restructures itself on every lookup, so threads cannot share one
+template <typename Comparable, typename Stats>
+void TestParallelQueries(const SplayTree<Comparable, Stats> &, const vector<SequenceMap> &, size_t) {
+    cout << "Parallel Queries: skipped, splay tree lookups modify the tree" << endl;
+    cout << endl;
+}
+
+template <typename TreeType>
+void TestTreeRemovals(TreeType &a_tree, const vector<SequenceMap> &sequences) {
+    int successful_removal = 0;
+    int total_removal = 0;
 
+    StartStats(a_tree);
+    StartCounters();
     for (size_t i = 1; i < sequences.size(); i += 2) {
         bool result = a_tree.remove_count(sequences[i]);
         if (result) {
@@ -105,22 +212,63 @@ void TestTestTree(TreeType &a_tree, const string &sequence_file) {
         }
         total_removal += a_tree.get_remove_calls();
     }
+    ReportCounters("Remove", sequences.size() / 2);
 
     cout << "Total Successful Removes: " << successful_removal << endl;
     cout << "Total Recursive Calls: " << total_removal << endl;
     cout << "Average Number of Recursion Calls: " << (double) total_removal / sequences.size() << endl;
+    ReportStats(a_tree);
     cout << endl;
+}
 
+template <typename TreeType>
+void TestTestTree(TreeType &a_tree, const string &sequence_file, size_t threads) {
+    vector<SequenceMap> sequences;
+    readSequences(sequences, sequence_file);
+
+    displayLogistics(a_tree);
+    TestTreeQueries(a_tree, sequences);
+    if (threads > 0) TestParallelQueries(a_tree, sequences, threads);
+    TestTreeRemovals(a_tree, sequences);
     displayLogistics(a_tree);
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    a_tree.makeEmpty();
+    cout << "Teardown Time: " << ElapsedMs(start) << " ms" << endl;
+}
+
+// Frozen trees are read-only, so only the query phase runs
+template <typename TreeType>
+void TestFrozenTree(TreeType &a_tree, const string &sequence_file, size_t threads) {
+    vector<SequenceMap> sequences;
+    readSequences(sequences, sequence_file);
+
+    displayLogistics(a_tree);
+    TestTreeQueries(a_tree, sequences);
+    if (threads > 0) TestParallelQueries(a_tree, sequences, threads);
 }
 
 // Sample main for program testTrees
 int
 main(int argc, char **argv) {
-    if (argc != 4) {
-        cout << "Usage: " << argv[0] << " <databasefilename> <queryfilename> <tree-type>" << endl;
+    size_t threads = 0;
+    bool perf = false, usage = argc < 4;
+    for (int i = 4; i < argc && !usage; i++) {
+        if (string(argv[i]) == "--threads" && i + 1 < argc) threads = strtoul(argv[++i], nullptr, 10);
+        else if (string(argv[i]) == "--perf") perf = true;
+        else if (string(argv[i]) == "--stats") show_stats = true;
+        else usage = true;
+    }
+    if (usage) {
+        cout << "Usage: " << argv[0] << " <databasefilename> <queryfilename> <tree-type> [--threads N] [--perf] [--stats]" << endl;
         return 0;
     }
+    if (perf) {
+        static PerfCounters counters;
+        phase_counters = &counters;
+        if (!counters.unavailable().empty())
+            cout << "Unavailable counters: " << counters.unavailable() << " (" << counters.why() << ")" << endl;
+    }
     string db_filename(argv[1]);
     string query_filename(argv[2]);
     string param_tree(argv[3]);
@@ -128,17 +276,41 @@ main(int argc, char **argv) {
     if (param_tree == "BST") {
         cout << "I will run the BST code " << endl;
         // Insert code for testing a BST tree.
-        BinarySearchTree<SequenceMap> a_tree;
-        PopulateTestTree(a_tree, db_filename);
-        TestTestTree(a_tree, query_filename);
+        BinarySearchTree<SequenceMap, OperationStats> a_tree;
+        TimedPopulateTestTree(a_tree, db_filename);
+        TestTestTree(a_tree, query_filename, threads);
     } else if (param_tree == "AVL") {
         cout << "I will run the AVL code " << endl;
         // Insert code for testing an AVL tree.
+        AvlTree<SequenceMap, OperationStats> a_tree;
+        TimedPopulateTestTree(a_tree, db_filename);
+        TestTestTree(a_tree, query_filename, threads);
+    } else if (param_tree == "BTREE") {
+        cout << "I will run the BTREE code " << endl;
+        BPlusTree<SequenceMap> a_tree;
+        TimedPopulateTestTree(a_tree, db_filename);
+        TestTestTree(a_tree, query_filename, threads);
+    } else if (param_tree == "FROZEN") {
+        cout << "I will run the FROZEN code " << endl;
         AvlTree<SequenceMap> a_tree;
-        PopulateTestTree(a_tree, db_filename);
-        TestTestTree(a_tree, query_filename);
+        TimedPopulateTestTree(a_tree, db_filename);
+        FrozenTree<SequenceMap> frozen_tree = a_tree.freeze();
+        a_tree.makeEmpty();
+        TestFrozenTree(frozen_tree, query_filename, threads);
+    } else if (param_tree == "HASH") {
+        cout << "I will run the HASH code " << endl;
+        SequenceHashMap<SequenceMap> a_map;
+        TimedPopulateTestTree(a_map, db_filename);
+        TestTestTree(a_map, query_filename, threads);
+    } else if (param_tree == "SPLAY" || param_tree == "SEMISPLAY") {
+        cout << "I will run the " << param_tree << " code " << endl;
+        typedef SplayTree<SequenceMap, OperationStats> SplayType;
+        SplayType a_tree(param_tree == "SPLAY" ? SplayType::FULL_SPLAY : SplayType::SEMI_SPLAY);
+        TimedPopulateTestTree(a_tree, db_filename);
+        TestTestTree(a_tree, query_filename, threads);
     } else {
-        cout << "Unknown tree type " << param_tree << " (User should provide BST, or AVL)" << endl;
+        cout << "Unknown tree type " << param_tree
+             << " (User should provide BST, AVL, BTREE, FROZEN, HASH, SPLAY, or SEMISPLAY)" << endl;
     }
     return 0;
 }
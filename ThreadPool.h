@@ -0,0 +1,179 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+using namespace std;
+
+// ThreadPool class
+//
+// CONSTRUCTION: with the number of worker threads (at least one)
+//
+// A fixed set of worker threads that run parallelFor jobs. The index
+// range of a job is cut into chunks of grain indices, and each worker
+// starts with a contiguous block of chunks in its own queue. A worker
+// takes chunks from the front of its own queue; once that is empty it
+// steals from the back of another worker's queue, so a worker that
+// drew slow chunks is helped by the others instead of holding up the
+// whole job.
+//
+// ******************PUBLIC OPERATIONS*********************
+// size_t size( )                     --> Return number of workers
+// void parallelFor( n, grain, task ) --> Run task over [ 0, n ) and wait
+//
+// task( begin, end, worker ) handles indices [ begin, end ); worker is
+// the index, below size( ), of the thread running it, so tasks can keep
+// per-worker results without locking.
+
+class ThreadPool
+{
+  public:
+    explicit ThreadPool( size_t threads )
+      : generation_{ 0 }, running_{ 0 }, stopping_{ false }
+    {
+        if( threads == 0 )
+            threads = 1;
+        for( size_t i = 0; i < threads; ++i )
+            queues_.push_back( unique_ptr<ChunkQueue>( new ChunkQueue ) );
+        for( size_t i = 0; i < threads; ++i )
+            workers_.push_back( thread( &ThreadPool::work, this, i ) );
+    }
+
+    ThreadPool( const ThreadPool & rhs ) = delete;
+    ThreadPool & operator=( const ThreadPool & rhs ) = delete;
+
+    ~ThreadPool( )
+    {
+        {
+            lock_guard<mutex> guard( lock_ );
+            stopping_ = true;
+        }
+        wake_.notify_all( );
+        for( size_t i = 0; i < workers_.size( ); ++i )
+            workers_[ i ].join( );
+    }
+
+    size_t size( ) const
+    {
+        return workers_.size( );
+    }
+
+    /**
+     * Run task over the indices [ 0, count ) in chunks of grain,
+     * returning once every chunk has finished.
+     */
+    template <typename Task>
+    void parallelFor( size_t count, size_t grain, Task task )
+    {
+        if( count == 0 )
+            return;
+        if( grain == 0 )
+            grain = 1;
+        size_t chunks = ( count + grain - 1 ) / grain;
+        size_t perWorker = ( chunks + size( ) - 1 ) / size( );
+        for( size_t c = 0; c < chunks; ++c )
+        {
+            Chunk chunk = { c * grain, c * grain + grain < count ? c * grain + grain : count };
+            queues_[ c / perWorker ]->chunks.push_back( chunk );
+        }
+
+        unique_lock<mutex> guard( lock_ );
+        job_ = task;
+        running_ = size( );
+        ++generation_;
+        wake_.notify_all( );
+        done_.wait( guard, [this] { return running_ == 0; } );
+        job_ = nullptr;
+    }
+
+  private:
+    struct Chunk
+    {
+        size_t begin;
+        size_t end;
+    };
+
+    struct ChunkQueue
+    {
+        mutex lock;
+        deque<Chunk> chunks;
+    };
+
+    vector<thread> workers_;
+    vector<unique_ptr<ChunkQueue> > queues_;
+    function<void( size_t, size_t, size_t )> job_;
+
+    mutex lock_;                    // Guards the fields below
+    condition_variable wake_;       // Signals a new job or shutdown
+    condition_variable done_;       // Signals the last worker finishing
+    size_t generation_;             // Number of jobs started
+    size_t running_;                // Workers still on the current job
+    bool stopping_;
+
+    /**
+     * Worker loop: wait for a job, run chunks until none are left
+     * anywhere, report, and wait again.
+     */
+    void work( size_t worker )
+    {
+        size_t seen = 0;
+        while( true )
+        {
+            {
+                unique_lock<mutex> guard( lock_ );
+                wake_.wait( guard, [this, seen] { return stopping_ || generation_ != seen; } );
+                if( stopping_ )
+                    return;
+                seen = generation_;
+            }
+
+            Chunk chunk;
+            while( takeOwn( worker, chunk ) || steal( worker, chunk ) )
+                job_( chunk.begin, chunk.end, worker );
+
+            lock_guard<mutex> guard( lock_ );
+            if( --running_ == 0 )
+                done_.notify_all( );
+        }
+    }
+
+    bool takeOwn( size_t worker, Chunk & chunk )
+    {
+        ChunkQueue & queue = *queues_[ worker ];
+        lock_guard<mutex> guard( queue.lock );
+        if( queue.chunks.empty( ) )
+            return false;
+        chunk = queue.chunks.front( );
+        queue.chunks.pop_front( );
+        return true;
+    }
+
+    /**
+     * Take the last chunk of the next worker that has any.
+     * No chunks are added while a job runs, so once every queue has
+     * been seen empty the job has no work left to hand out.
+     */
+    bool steal( size_t thief, Chunk & chunk )
+    {
+        for( size_t i = 1; i < queues_.size( ); ++i )
+        {
+            ChunkQueue & queue = *queues_[ ( thief + i ) % queues_.size( ) ];
+            lock_guard<mutex> guard( queue.lock );
+            if( !queue.chunks.empty( ) )
+            {
+                chunk = queue.chunks.back( );
+                queue.chunks.pop_back( );
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+#endif
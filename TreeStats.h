@@ -0,0 +1,274 @@
+#ifndef TREE_STATS_H
+#define TREE_STATS_H
+
+#include <iostream>
+#include <string>
+using namespace std;
+
+// Statistics policies for AvlTree and BinarySearchTree
+//
+// CONSTRUCTION: zero parameter
+//
+// A tree takes its policy as a template parameter and opens a Probe
+// on the stack for every find, insert and remove. The operation calls
+// the probe's hooks as it compares, follows links, allocates and
+// rotates, and the probe hands its counts to the policy when the
+// operation ends.
+//
+// NoStats, the default, has an empty Probe with inline hooks, so the
+// compiler drops them and the tree is the same code as without a
+// policy. OperationStats keeps totals per operation type. Its hooks
+// count into the probe's locals, and the probe adds them to the totals
+// once, when it ends.
+//
+// find_count and remove_count open a LinkProbe instead, which counts
+// the links followed under any policy. Under OperationStats it is the
+// Probe; under NoStats it counts links and nothing else, and only
+// those two calls pay for it.
+//
+// A probe opened on a const policy counts but never publishes. The
+// trees open their const lookups that way, so any number of threads
+// may run them at once on a shared tree without touching the policy;
+// only lookups on a non-const tree reach the totals and lastLinks.
+//
+// ******************PUBLIC OPERATIONS*********************
+// Probe( stats, op )     --> Start counting one operation
+// Probe( const stats, op ) --> Count one operation without publishing
+// LinkProbe( stats, op ) --> Probe that counts links under any policy
+// bool less( a, b )      --> Return a < b, counting one comparison
+// void follow( )         --> Count one link followed
+// void allocate( )       --> Count one node allocated
+// void rotate( isDouble )--> Count one single or double rotation
+// void rebalance( n )    --> Record that n levels were rebalanced
+// int links( )           --> Return the links this probe has followed
+// int lastLinks( op )    --> Return links followed by the last op
+// unsigned long count( op, c ) --> Return total c over operations op
+// void reset( )          --> Zero every total
+// void report( out )     --> Print each operation's averages
+//
+// Links followed are the steps from a node to a child, so a find
+// that matches counts the nodes visited before the match, and a
+// find that misses counts every node visited.
+
+struct TreeStats
+{
+    enum Operation { FIND, INSERT, REMOVE, OPERATION_COUNT };
+
+    static const char * name( Operation op )
+    {
+        static const char *names[ OPERATION_COUNT ] = { "Find", "Insert", "Remove" };
+        return names[ op ];
+    }
+};
+
+class NoStats : public TreeStats
+{
+  public:
+    class Probe
+    {
+      public:
+        Probe( const NoStats &, Operation )
+          { }
+
+        template <typename T>
+        bool less( const T & a, const T & b ) const
+          { return a < b; }
+
+        void follow( )
+          { }
+        void allocate( )
+          { }
+        void rotate( bool )
+          { }
+        void rebalance( int )
+          { }
+    };
+
+    class LinkProbe
+    {
+      public:
+        LinkProbe( NoStats & stats, Operation op ) : stats_{ &stats }, op_{ op }, links_{ 0 }
+          { }
+        LinkProbe( const NoStats &, Operation op ) : stats_{ nullptr }, op_{ op }, links_{ 0 }
+          { }
+
+        LinkProbe( const LinkProbe & rhs ) = delete;
+        LinkProbe & operator=( const LinkProbe & rhs ) = delete;
+
+        ~LinkProbe( )
+        {
+            if( stats_ != nullptr )
+                stats_->last_links_[ op_ ] = links_;
+        }
+
+        template <typename T>
+        bool less( const T & a, const T & b ) const
+          { return a < b; }
+
+        void follow( )
+          { ++links_; }
+        void allocate( )
+          { }
+        void rotate( bool )
+          { }
+        void rebalance( int )
+          { }
+        int links( ) const
+          { return links_; }
+
+      private:
+        NoStats *stats_;
+        Operation op_;
+        int links_;
+    };
+
+    NoStats( ) : last_links_{ }
+      { }
+
+    int lastLinks( Operation op ) const
+      { return last_links_[ op ]; }
+
+  private:
+    int last_links_[ OPERATION_COUNT ];
+};
+
+class OperationStats : public TreeStats
+{
+  public:
+    enum Counter { OPERATIONS, COMPARISONS, LINKS, ALLOCATIONS, SINGLE_ROTATIONS,
+                   DOUBLE_ROTATIONS, REBALANCE_LEVELS, MAX_REBALANCE, COUNTER_COUNT };
+
+    class Probe
+    {
+      public:
+        Probe( OperationStats & stats, Operation op ) : stats_{ &stats }, op_{ op }
+        {
+            for( int c = 0; c < COUNTER_COUNT; ++c )
+                counts_[ c ] = 0;
+            counts_[ OPERATIONS ] = 1;
+        }
+
+        Probe( const OperationStats &, Operation op ) : stats_{ nullptr }, op_{ op }
+        {
+            for( int c = 0; c < COUNTER_COUNT; ++c )
+                counts_[ c ] = 0;
+            counts_[ OPERATIONS ] = 1;
+        }
+
+        Probe( const Probe & rhs ) = delete;
+        Probe & operator=( const Probe & rhs ) = delete;
+
+        ~Probe( )
+        {
+            if( stats_ != nullptr )
+                stats_->add( op_, counts_ );
+        }
+
+        template <typename T>
+        bool less( const T & a, const T & b )
+        {
+            ++counts_[ COMPARISONS ];
+            return a < b;
+        }
+
+        void follow( )
+          { ++counts_[ LINKS ]; }
+        void allocate( )
+          { ++counts_[ ALLOCATIONS ]; }
+        void rotate( bool isDouble )
+          { ++counts_[ isDouble ? DOUBLE_ROTATIONS : SINGLE_ROTATIONS ]; }
+
+        void rebalance( int levels )
+        {
+            counts_[ REBALANCE_LEVELS ] += levels;
+            counts_[ MAX_REBALANCE ] = levels;
+        }
+
+        int links( ) const
+          { return static_cast<int>( counts_[ LINKS ] ); }
+
+      private:
+        OperationStats *stats_;
+        Operation op_;
+        unsigned long counts_[ COUNTER_COUNT ];
+    };
+
+    typedef Probe LinkProbe;
+
+    OperationStats( )
+    {
+        reset( );
+    }
+
+    OperationStats( const OperationStats & rhs ) = delete;
+    OperationStats & operator=( const OperationStats & rhs ) = delete;
+
+    static const char * name( Counter c )
+    {
+        static const char *names[ COUNTER_COUNT ] = {
+            "operations", "comparisons", "links", "allocations", "single rotations",
+            "double rotations", "rebalance levels", "max rebalance" };
+        return names[ c ];
+    }
+    using TreeStats::name;
+
+    int lastLinks( Operation op ) const
+    {
+        return last_links_[ op ];
+    }
+
+    /**
+     * Return the total of counter c over all operations of type op;
+     * for MAX_REBALANCE, the largest value any one operation reached.
+     */
+    unsigned long count( Operation op, Counter c ) const
+    {
+        return totals_[ op ][ c ];
+    }
+
+    void reset( )
+    {
+        for( int op = 0; op < OPERATION_COUNT; ++op )
+        {
+            for( int c = 0; c < COUNTER_COUNT; ++c )
+                totals_[ op ][ c ] = 0;
+            last_links_[ op ] = 0;
+        }
+    }
+
+    /**
+     * Print one line per operation type that ran: the number of
+     * operations, each counter per operation, and the largest
+     * rebalance.
+     */
+    void report( ostream & out ) const
+    {
+        for( int op = 0; op < OPERATION_COUNT; ++op )
+        {
+            unsigned long ops = count( static_cast<Operation>( op ), OPERATIONS );
+            if( ops == 0 )
+                continue;
+            out << name( static_cast<Operation>( op ) ) << " Stats: " << ops << " operations";
+            for( int c = COMPARISONS; c < MAX_REBALANCE; ++c )
+                out << ", " << name( static_cast<Counter>( c ) ) << " "
+                    << double( count( static_cast<Operation>( op ), static_cast<Counter>( c ) ) ) / ops;
+            out << ", " << name( MAX_REBALANCE ) << " "
+                << count( static_cast<Operation>( op ), MAX_REBALANCE ) << endl;
+        }
+    }
+
+  private:
+    unsigned long totals_[ OPERATION_COUNT ][ COUNTER_COUNT ];
+    int last_links_[ OPERATION_COUNT ];
+
+    void add( Operation op, const unsigned long *counts )
+    {
+        for( int c = 0; c < MAX_REBALANCE; ++c )
+            totals_[ op ][ c ] += counts[ c ];
+        if( counts[ MAX_REBALANCE ] > totals_[ op ][ MAX_REBALANCE ] )
+            totals_[ op ][ MAX_REBALANCE ] = counts[ MAX_REBALANCE ];
+        last_links_[ op ] = static_cast<int>( counts[ LINKS ] );
+    }
+};
+
+#endif